@@ -0,0 +1,220 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "AdaptiveBaseline.h"
+#include "DetectorContext.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static_assert(ADAPTIVE_LINES_PER_FRAME <= MIN_IMAGE_HEIGHT, "A frame can have fewer lines than are folded.");
+static_assert((uint64_t) ADAPTIVE_UPDATE_FRAMES * ADAPTIVE_LINES_PER_FRAME * 255 * 255 <= UINT32_MAX,
+              "Too many readings between updates to sum the squares in 32 bits.");
+
+uint32_t adaptiveBaselineFramesFromEnvironment(){
+    const char * value = getenv(ADAPTIVE_BASELINE_ENV);
+    if(value == NULL) return 0;
+    return (uint32_t) strtoul(value, NULL, 10);
+}
+
+// Set used to 1 for the columns that can be folded into the model and 0 for the ones in or next to a shadow.
+static void usedColumns(const uint32_t * count, uint8_t * used, const SensorGeometry & geometry){
+    const int width = geometry.pixelsPerLine;
+    const uint32_t shadowCount = ADAPTIVE_SHADOW_COUNT(geometry.imageHeight);
+    uint32_t mostBelow = 0;
+    for(int i = 0; i < width; i++) mostBelow = std::max(mostBelow, count[i]);
+    memset(used, 1, geometry.pixelsPerLine);
+    if(mostBelow < shadowCount) return;
+
+    for(int i = 0; i < width; i++){
+        if(count[i] < shadowCount) continue;
+        int first = std::max(i - ADAPTIVE_GUARD_COLUMNS, 0);
+        int last = std::min(i + ADAPTIVE_GUARD_COLUMNS, width - 1);
+        memset(used + first, 0, last - first + 1);
+    }
+}
+
+// Sums, sums of squares, minimums and maximums of the used columns in ADAPTIVE_LINES_PER_FRAME lines, stride pixels
+// apart, of a strip up to PIXELS_PER_LINE pixels wide.
+// The lines are summed into local arrays that can't alias the model, the same as foldFrame in BaselineAccumulator.cpp,
+// so the compiler vectorizes the loops across a line.
+__attribute__((target_clones("arch=x86-64-v4", "avx2", "default")))
+static void foldLines(const uint8_t * lines, uint32_t width, size_t stride, const uint8_t * used, uint32_t * __restrict sumLine,
+                      uint32_t * __restrict sumSquaresLine, uint32_t * __restrict readingsLine,
+                      uint8_t * __restrict minLine, uint8_t * __restrict maxLine){
+    alignas(64) uint16_t frameSum[PIXELS_PER_LINE] = {};
+    alignas(64) uint32_t frameSumSquares[PIXELS_PER_LINE] = {};
+    alignas(64) uint8_t  frameMin[PIXELS_PER_LINE];
+    alignas(64) uint8_t  frameMax[PIXELS_PER_LINE] = {};
+    alignas(64) uint8_t  usedMask[PIXELS_PER_LINE];
+    for(uint32_t i = 0; i < width; i++){
+        usedMask[i] = used[i] ? UINT8_MAX : 0;
+        frameMin[i] = UINT8_MAX;
+    }
+
+    for(int line = 0; line < ADAPTIVE_LINES_PER_FRAME; line++){
+        const uint8_t * pixels = lines + line*stride;
+        for(uint32_t i = 0; i < width; i++){
+            uint8_t pixel = pixels[i] & usedMask[i];
+            frameSum[i] += pixel;
+            frameSumSquares[i] += (uint32_t) (uint16_t) (pixel * pixel);
+            uint8_t low = pixels[i] | (uint8_t) ~usedMask[i];
+            frameMin[i] = low < frameMin[i] ? low : frameMin[i];
+            frameMax[i] = pixel > frameMax[i] ? pixel : frameMax[i];
+        }
+    }
+
+    for(uint32_t i = 0; i < width; i++){
+        sumLine[i] += frameSum[i];
+        sumSquaresLine[i] += frameSumSquares[i];
+        readingsLine[i] += used[i] * ADAPTIVE_LINES_PER_FRAME;
+        minLine[i] = frameMin[i] < minLine[i] ? frameMin[i] : minLine[i];
+        maxLine[i] = frameMax[i] > maxLine[i] ? frameMax[i] : maxLine[i];
+    }
+}
+
+AdaptiveBaseline::AdaptiveBaseline(){
+    setGeometry(geometry);
+}
+
+void AdaptiveBaseline::setTimeConstant(uint32_t frames){
+    timeConstantFrames = frames;
+    published.reset();
+}
+
+void AdaptiveBaseline::setGeometry(const SensorGeometry & frameGeometry){
+    geometry = frameGeometry;
+    nextLine = 0;
+    published.reset();
+    meanLine.assign(geometry.pixelsPerLine, 0);
+    varianceLine.assign(geometry.pixelsPerLine, 0);
+    minLine.assign(geometry.pixelsPerLine, UINT8_MAX);
+    maxLine.assign(geometry.pixelsPerLine, 0);
+    sumLine.assign(geometry.pixelsPerLine, 0);
+    sumSquaresLine.assign(geometry.pixelsPerLine, 0);
+    readingsLine.assign(geometry.pixelsPerLine, 0);
+    usedLine.assign(geometry.pixelsPerLine, 0);
+}
+
+void AdaptiveBaseline::seed(const std::shared_ptr<const DetectionThreshold> & threshold){
+    published = threshold;
+    const BaselineData & baseline = threshold->baseline;
+    for(uint32_t i = 0; i < geometry.pixelsPerLine; i++){
+        // Baseline averages are truncated, so the expected average is half a level higher.
+        meanLine[i] = baseline.avgLine[i] + 0.5;
+        varianceLine[i] = (double) baseline.stdDevLine[i] * baseline.stdDevLine[i];
+        minLine[i] = std::min(baseline.minLine[i], (uint32_t) UINT8_MAX);
+        maxLine[i] = std::min(baseline.maxLine[i], (uint32_t) UINT8_MAX);
+    }
+    std::fill(sumLine.begin(), sumLine.end(), 0);
+    std::fill(sumSquaresLine.begin(), sumSquaresLine.end(), 0);
+    std::fill(readingsLine.begin(), readingsLine.end(), 0);
+    framesSummed = 0;
+    updates = 0;
+}
+
+void AdaptiveBaseline::update(){
+    // Each reading moves the average this much of the way towards it.
+    const double weightPerReading = 1.0 / ((double) timeConstantFrames * ADAPTIVE_LINES_PER_FRAME);
+
+    for(uint32_t i = 0; i < geometry.pixelsPerLine; i++){
+        uint64_t n = readingsLine[i];
+        if(n < 2) continue;
+
+        // Average and variance of the summed readings. The numerator is exact, the same as BaselineAccumulator::finish.
+        double sumMean = (double) sumLine[i] / n;
+        double sumVariance = (double) (n * sumSquaresLine[i] - (uint64_t) sumLine[i] * sumLine[i]) / ((double) n * n);
+
+        // The moving average is a mix of the old distribution and the new readings.
+        // Its variance includes how far the average moved.
+        double weight = std::min(1.0, n * weightPerReading);
+        double difference = sumMean - meanLine[i];
+        meanLine[i] += weight * difference;
+        varianceLine[i] = (1 - weight) * (varianceLine[i] + weight * difference * difference) + weight * sumVariance;
+    }
+
+    std::fill(sumLine.begin(), sumLine.end(), 0);
+    std::fill(sumSquaresLine.begin(), sumSquaresLine.end(), 0);
+    std::fill(readingsLine.begin(), readingsLine.end(), 0);
+    framesSummed = 0;
+}
+
+void AdaptiveBaseline::publish(CameraContext & camera){
+    // Calculate the new baseline the same as BaselineAccumulator::finish.
+    std::unique_ptr<BaselineData> baseline(new BaselineData(published->baseline));
+    bool changed = false;
+    for(uint32_t i = 0; i < geometry.pixelsPerLine; i++){
+        baseline->minLine[i] = minLine[i];
+        baseline->maxLine[i] = maxLine[i];
+        baseline->avgLine[i] = (uint32_t) meanLine[i];
+        baseline->stdDevLine[i] = sqrt(varianceLine[i]);
+        if(baseline->avgLine[i] > 5*baseline->stdDevLine[i]) {
+            baseline->thresholdLine[i] = baseline->avgLine[i] - 5 * baseline->stdDevLine[i];
+        }
+        else {
+            baseline->thresholdLine[i] = 0;
+        }
+        changed |= baseline->thresholdLine[i] != published->baseline.thresholdLine[i]
+                || baseline->avgLine[i] != published->baseline.avgLine[i];
+    }
+    if(!changed) return;
+
+    // A version published since this one was taken, like a reload, wins. The next frame restarts the model from it.
+    std::shared_ptr<const DetectionThreshold> threshold = makeDetectionThreshold(baseline.get(), published->timeCreated);
+    if(replaceDetectionThreshold(camera, published, threshold)) published = threshold;
+}
+
+void AdaptiveBaseline::addFrame(CameraContext & camera, const uint8_t * frame, const uint32_t * count,
+                                const std::shared_ptr<const DetectionThreshold> & threshold){
+    if(!enabled()) return;
+    if(threshold != published) seed(threshold);
+
+    const uint32_t width = geometry.pixelsPerLine;
+    usedColumns(count, usedLine.data(), geometry);
+    const uint8_t * lines = frame + (size_t) nextLine*width;
+    for(uint32_t first = 0; first < width; first += PIXELS_PER_LINE){
+        foldLines(lines + first, std::min<uint32_t>(PIXELS_PER_LINE, width - first), width, usedLine.data() + first,
+                  sumLine.data() + first, sumSquaresLine.data() + first, readingsLine.data() + first,
+                  minLine.data() + first, maxLine.data() + first);
+    }
+    // Start again from the top when the next lines would run past the bottom of the frame.
+    nextLine += ADAPTIVE_LINES_PER_FRAME;
+    if(nextLine + ADAPTIVE_LINES_PER_FRAME > geometry.imageHeight) nextLine = 0;
+
+    if(++framesSummed < ADAPTIVE_UPDATE_FRAMES) return;
+    update();
+    if(++updates % ADAPTIVE_PUBLISH_UPDATES == 0) publish(camera);
+}
+
+void checkpointBaselines(DetectorContext & context, const char * filename){
+    for(uint32_t i = 0; i < context.cameraCount(); i++){
+        std::shared_ptr<const DetectionThreshold> threshold = currentDetectionThreshold(context.camera(i));
+        if(!threshold) continue;
+        BaselineData * baseline = new BaselineData(threshold->baseline);
+        writeBaselineToDB(baseline, filename, context.camera(i).name.c_str());
+        delete baseline;
+    }
+}
+
+void checkpointBaselines(const char * filename){
+    checkpointBaselines(detectorContext(), filename);
+}
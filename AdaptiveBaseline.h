@@ -0,0 +1,122 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_ADAPTIVEBASELINE_H
+#define UNTITLED_ADAPTIVEBASELINE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "BaselineData.h"
+#include "CameraConfiguration.h"
+#include "DetectionThreshold.h"
+#include "camerasettings.h"
+
+// Environment variable read by adaptiveBaselineFramesFromEnvironment.
+// The time constant of the adaptive baseline in frames. 0 or unset keeps the baseline loaded at startup.
+#define ADAPTIVE_BASELINE_ENV "LSAD_ADAPTIVE_BASELINE_FRAMES"
+
+// Lines of each frame folded into the model. The lines used move down the frame each time.
+#define ADAPTIVE_LINES_PER_FRAME 8
+
+// Frames summed before the average and variance are updated.
+#define ADAPTIVE_UPDATE_FRAMES 64
+
+// Updates between recalculating the threshold. A new version is only published when the threshold changed.
+#define ADAPTIVE_PUBLISH_UPDATES 4
+
+// A column with a sixteenth of its pixels below the threshold is in a shadow and isn't used.
+// A few pixels of noise below the threshold are still used, so a column drifting towards its threshold catches up.
+#define ADAPTIVE_SHADOW_COUNT(imageHeight) ((imageHeight)/16)
+
+// Columns on each side of a shadow that aren't used, so the edge of the shadow doesn't pull the average down.
+#define ADAPTIVE_GUARD_COLUMNS 4
+
+// Time constant from ADAPTIVE_BASELINE_ENV, or 0 when it isn't set.
+uint32_t adaptiveBaselineFramesFromEnvironment();
+
+// Follows slow changes in the light reaching a camera, like a projector warming up or the room getting darker,
+// so the baseline doesn't need collecting again over an evening.
+// Columns outside shadows feed an exponential moving average of each pixel's average and variance, starting from
+// the published baseline. The threshold is recalculated from them the same way as BaselineAccumulator::finish and
+// published as a new DetectionThreshold version. A version published by anything else, like a reload, restarts the
+// model from it.
+// Only ADAPTIVE_LINES_PER_FRAME lines of a frame are summed and the averages are updated every ADAPTIVE_UPDATE_FRAMES
+// frames, so it costs a small part of measuring the frame. Each camera needs its own, used only by its grab thread.
+class AdaptiveBaseline {
+private:
+    uint32_t timeConstantFrames = 0;
+    SensorGeometry geometry;
+
+    // The version the model was started from or last published.
+    std::shared_ptr<const DetectionThreshold> published;
+
+    // Moving average and variance of each pixel, and the smallest and largest readings seen.
+    // Each line has a value for every pixel of geometry and is sized by setGeometry.
+    std::vector<double> meanLine;
+    std::vector<double> varianceLine;
+    std::vector<uint8_t> minLine;
+    std::vector<uint8_t> maxLine;
+
+    // Readings summed since the last update.
+    std::vector<uint32_t> sumLine;
+    std::vector<uint32_t> sumSquaresLine;
+    std::vector<uint32_t> readingsLine;
+
+    // 1 for the columns of the frame being added that are folded into the model.
+    std::vector<uint8_t> usedLine;
+    uint32_t framesSummed = 0;
+    uint32_t updates = 0;
+    uint32_t nextLine = 0;
+
+    // Start the model from threshold's baseline.
+    void seed(const std::shared_ptr<const DetectionThreshold> & threshold);
+
+    // Fold the summed readings into the moving averages.
+    void update();
+
+    // Recalculate the threshold and publish it for camera if it changed.
+    void publish(CameraContext & camera);
+public:
+    AdaptiveBaseline();
+
+    // Frames for the moving average's time constant. 0 turns the model off.
+    void setTimeConstant(uint32_t frames);
+
+    // Size of the frames added from now on. The lines are resized for it and the model restarts from the published version.
+    void setGeometry(const SensorGeometry & frameGeometry);
+
+    bool enabled() const { return timeConstantFrames > 0; }
+
+    // Fold the columns of frame outside shadows into the model. Columns of a wider baseline past the frame's width
+    // are left as they are. threshold is the version frame was measured against and count has the pixels below it
+    // in each column.
+    void addFrame(CameraContext & camera, const uint8_t * frame, const uint32_t * count,
+                  const std::shared_ptr<const DetectionThreshold> & threshold);
+};
+
+class DetectorContext;
+
+// Write the baseline each camera in context, or detectorContext(), is measured against, adapted or not, to the database.
+void checkpointBaselines(DetectorContext & context, const char * filename);
+void checkpointBaselines(const char * filename);
+
+#endif //UNTITLED_ADAPTIVEBASELINE_H
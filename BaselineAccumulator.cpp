@@ -0,0 +1,129 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "BaselineAccumulator.h"
+#include <algorithm>
+#include <cmath>
+
+// Lines are summed into 16 bit lanes before being added to the 64 bit sums, this many at a time.
+#define MAX_LINES_PER_SUM (UINT16_MAX / 255)
+
+// The sums of squares of a block of lines fit in 32 bits.
+static_assert((uint64_t) MAX_LINES_PER_SUM * 255 * 255 <= UINT32_MAX, "Too many lines summed to hold the squares in 32 bits.");
+
+// Sums, sums of squares, minimums and maximums for up to MAX_LINES_PER_SUM lines, stride pixels apart, of a strip
+// up to PIXELS_PER_LINE pixels wide.
+// Every loop runs across a line so the compiler vectorizes them. target_clones builds
+// AVX-512, AVX2 and SSE2 copies and picks one when the program starts.
+__attribute__((target_clones("arch=x86-64-v4", "avx2", "default")))
+static void foldLines(const uint8_t * lines, uint32_t width, size_t stride, uint32_t lineCount, uint64_t * sumLine,
+                      uint64_t * sumSquaresLine, uint8_t * minLine, uint8_t * maxLine){
+    alignas(64) uint16_t frameSum[PIXELS_PER_LINE] = {};
+    alignas(64) uint32_t frameSumSquares[PIXELS_PER_LINE] = {};
+
+    for(uint32_t line = 0; line < lineCount; line++){
+        const uint8_t * pixels = lines + line*stride;
+        for(uint32_t i = 0; i < width; i++){
+            uint16_t pixel = pixels[i];
+            frameSum[i] += pixel;
+            frameSumSquares[i] += (uint32_t) (uint16_t) (pixel * pixel);
+            minLine[i] = pixels[i] < minLine[i] ? pixels[i] : minLine[i];
+            maxLine[i] = pixels[i] > maxLine[i] ? pixels[i] : maxLine[i];
+        }
+    }
+
+    for(uint32_t i = 0; i < width; i++){
+        sumLine[i] += frameSum[i];
+        sumSquaresLine[i] += frameSumSquares[i];
+    }
+}
+
+BaselineAccumulator::BaselineAccumulator(const SensorGeometry & frameGeometry) : geometry(frameGeometry){
+    reset();
+}
+
+void BaselineAccumulator::reset(){
+    frameCount = 0;
+    sumLine.assign(geometry.pixelsPerLine, 0);
+    sumSquaresLine.assign(geometry.pixelsPerLine, 0);
+    minLine.assign(geometry.pixelsPerLine, UINT8_MAX);
+    maxLine.assign(geometry.pixelsPerLine, 0);
+}
+
+void BaselineAccumulator::addFrame(const uint8_t * frame){
+    // Lines wider than PIXELS_PER_LINE are folded a strip at a time, so the local sums stay on the stack.
+    const uint32_t width = geometry.pixelsPerLine;
+    for(uint32_t line = 0; line < geometry.imageHeight; line += MAX_LINES_PER_SUM){
+        uint32_t lineCount = std::min(geometry.imageHeight - line, (uint32_t) MAX_LINES_PER_SUM);
+        for(uint32_t first = 0; first < width; first += PIXELS_PER_LINE){
+            foldLines(frame + (size_t) line*width + first, std::min<uint32_t>(width - first, PIXELS_PER_LINE), width,
+                      lineCount, sumLine.data() + first, sumSquaresLine.data() + first, minLine.data() + first,
+                      maxLine.data() + first);
+        }
+    }
+    frameCount++;
+}
+
+void BaselineAccumulator::merge(const BaselineAccumulator & other){
+    for(uint32_t i = 0; i < geometry.pixelsPerLine; i++){
+        sumLine[i] += other.sumLine[i];
+        sumSquaresLine[i] += other.sumSquaresLine[i];
+        if(other.minLine[i] < minLine[i]) minLine[i] = other.minLine[i];
+        if(other.maxLine[i] > maxLine[i]) maxLine[i] = other.maxLine[i];
+    }
+    frameCount += other.frameCount;
+}
+
+uint64_t BaselineAccumulator::frames() const{
+    return frameCount;
+}
+
+void BaselineAccumulator::finish(struct BaselineData * data) const{
+    // Number of readings for each pixel.
+    const uint64_t n = frameCount * geometry.imageHeight;
+
+    data->resize(geometry.pixelsPerLine);
+    for(uint32_t i = 0; i < geometry.pixelsPerLine; i++){
+        data->minLine[i] = minLine[i];
+        data->maxLine[i] = maxLine[i];
+
+        // The average is truncated the same as lineAvgCalc.
+        data->avgLine[i] = n > 0 ? sumLine[i] / n : 0;
+
+        // Sample variance = (n * sum of squares - sum^2) / (n * (n - 1)).
+        // The numerator is calculated exactly in 128 bits, so there's no cancellation when the variance is small.
+        if(n > 1) {
+            unsigned __int128 numerator = (unsigned __int128) n * sumSquaresLine[i]
+                                        - (unsigned __int128) sumLine[i] * sumLine[i];
+            data->stdDevLine[i] = sqrt((double) numerator / ((double) n * (double) (n - 1)));
+        }
+        else {
+            data->stdDevLine[i] = 0;
+        }
+
+        // Subtract 5 times the standard deviation to get the threshold for detecting objects.
+        if(data->avgLine[i] > 5*data->stdDevLine[i]) {
+            data->thresholdLine[i] = data->avgLine[i] - 5 * data->stdDevLine[i];
+        }
+        else {
+            data->thresholdLine[i] = 0;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef UNTITLED_BASELINEACCUMULATOR_H
+#define UNTITLED_BASELINEACCUMULATOR_H
+
+#include <cstdint>
+#include <vector>
+#include "BaselineData.h"
+#include "CameraConfiguration.h"
+
+// Calculates a baseline on the CPU one frame at a time.
+// Each frame is folded into per pixel sums, sums of squares, minimums and maximums in a single pass,
+// so frames don't need to be kept after they're added and the number of frames isn't limited by memory.
+// The 64 bit sums hold over 10^10 frames before overflowing.
+class BaselineAccumulator {
+private:
+    SensorGeometry geometry;
+    uint64_t frameCount;
+    // One value for each pixel of a line of geometry.
+    std::vector<uint64_t> sumLine;
+    std::vector<uint64_t> sumSquaresLine;
+    std::vector<uint8_t>  minLine;
+    std::vector<uint8_t>  maxLine;
+public:
+    // Frames added are of frameGeometry.
+    explicit BaselineAccumulator(const SensorGeometry & frameGeometry = SensorGeometry());
+
+    // Clear all frames added.
+    void reset();
+
+    // Fold a frame into the accumulators.
+    void addFrame(const uint8_t * frame);
+
+    // Add the frames from another accumulator of the same geometry. Used to combine accumulators filled by different threads.
+    void merge(const BaselineAccumulator & other);
+
+    // Number of frames added.
+    uint64_t frames() const;
+
+    // Calculate the average, minimum, maximum, standard deviation and threshold for each pixel.
+    // data's lines are resized to the geometry's width. gain and exposure_time in data are left as they are.
+    void finish(struct BaselineData * data) const;
+};
+
+#endif //UNTITLED_BASELINEACCUMULATOR_H
@@ -19,102 +19,186 @@
 // along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "BaselineData.h"
+#include "BaselineAccumulator.h"
+#include "DatabaseService.h"
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+
+void BaselineData::resize(uint32_t pixels){
+    minLine.resize(pixels, UINT8_MAX);
+    maxLine.resize(pixels, 0);
+    avgLine.resize(pixels, 0);
+    stdDevLine.resize(pixels, 0);
+    thresholdLine.resize(pixels, 0);
+}
 
-void initBaselineData_h(struct BaselineData *& data, uint32_t gain, uint32_t exposure_time){
-    data = (struct BaselineData *) malloc(sizeof(struct BaselineData));
-    if(data == NULL) {
-        std::cerr << "Could not allocate memory for a Baseline struct. Aborting.\n";
-        std::abort();
-    }
+void initBaselineData_h(struct BaselineData *& data, uint32_t gain, uint32_t exposure_time, uint32_t pixels){
+    data = new BaselineData();
     data->gain = gain;
     data->exposure_time = exposure_time;
-    memset(data->minLine, 255, LINE_BYTES_UINT32);
-    memset(data->maxLine, 0, LINE_BYTES_UINT32);
+    data->resize(pixels);
 }
 
-void initBaselineData_d(struct BaselineData *& data){
-    HIP_CHECK(hipMalloc(&data,sizeof(struct BaselineData)));
+#ifdef LSAD_USE_HIP
+void initBaselineData_d(struct BaselineLines_d *& data){
+    HIP_CHECK(hipMalloc(&data,sizeof(struct BaselineLines_d)));
     HIP_CHECK(hipMemset(data->minLine,255,LINE_BYTES_UINT32));
     HIP_CHECK(hipMemset(data->maxLine,0,LINE_BYTES_UINT32));
 }
 
-void copyBaselineData_DeviceToHost(struct BaselineData *& GPU_h, struct BaselineData *& GPU_d){
-    uint32_t gainTemporary = GPU_h->gain;
-    uint32_t exposureTemporary = GPU_h->exposure_time;
-    HIP_CHECK(hipMemcpy(GPU_h, GPU_d, sizeof(struct BaselineData), hipMemcpyDeviceToHost));
-    GPU_h->gain = gainTemporary;
-    GPU_h->exposure_time = exposureTemporary;
+void copyBaselineData_DeviceToHost(struct BaselineData * GPU_h, const struct BaselineLines_d * GPU_d){
+    std::unique_ptr<BaselineLines_d> lines(new BaselineLines_d());
+    HIP_CHECK(hipMemcpy(lines.get(), GPU_d, sizeof(struct BaselineLines_d), hipMemcpyDeviceToHost));
+    GPU_h->minLine.assign(lines->minLine, lines->minLine + PIXELS_PER_LINE);
+    GPU_h->maxLine.assign(lines->maxLine, lines->maxLine + PIXELS_PER_LINE);
+    GPU_h->avgLine.assign(lines->avgLine, lines->avgLine + PIXELS_PER_LINE);
+    GPU_h->stdDevLine.assign(lines->stdDevLine, lines->stdDevLine + PIXELS_PER_LINE);
+    GPU_h->thresholdLine.assign(lines->thresholdLine, lines->thresholdLine + PIXELS_PER_LINE);
 }
 
-void copyBaselineData_HostToDevice(struct BaselineData *& GPU_h, struct BaselineData *& GPU_d){
-    HIP_CHECK(hipMemcpy(GPU_h, GPU_d, sizeof(struct BaselineData), hipMemcpyHostToDevice));
+void copyBaselineData_HostToDevice(const struct BaselineData * GPU_h, struct BaselineLines_d * GPU_d){
+    // Only baselines of the default width fit in the device struct.
+    if(GPU_h->pixelsPerLine() != PIXELS_PER_LINE) {
+        std::cerr << "Only baselines " << PIXELS_PER_LINE << " pixels wide can be copied to the GPU. Aborting.\n";
+        std::abort();
+    }
+    HIP_CHECK(hipMemcpy(GPU_d->minLine, GPU_h->minLine.data(), LINE_BYTES_UINT32, hipMemcpyHostToDevice));
+    HIP_CHECK(hipMemcpy(GPU_d->maxLine, GPU_h->maxLine.data(), LINE_BYTES_UINT32, hipMemcpyHostToDevice));
+    HIP_CHECK(hipMemcpy(GPU_d->avgLine, GPU_h->avgLine.data(), LINE_BYTES_UINT32, hipMemcpyHostToDevice));
+    HIP_CHECK(hipMemcpy(GPU_d->stdDevLine, GPU_h->stdDevLine.data(), PIXELS_PER_LINE*sizeof(float), hipMemcpyHostToDevice));
+    HIP_CHECK(hipMemcpy(GPU_d->thresholdLine, GPU_h->thresholdLine.data(), LINE_BYTES_UINT32, hipMemcpyHostToDevice));
+}
+#endif //LSAD_USE_HIP
+
+// Copy line into a little-endian blob.
+template<typename T>
+static DatabaseBlob lineBlob(const std::vector<T> & line) {
+    static_assert(sizeof(T) == sizeof(uint32_t), "Baseline lines are stored as 32 bit values.");
+    DatabaseBlob blob(line.size() * sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(blob.data(), line.data(), blob.size());
+#else
+    for(uint32_t i = 0; i < line.size(); i++) {
+        uint32_t value;
+        memcpy(&value, &line[i], sizeof(value));
+        for(uint32_t b = 0; b < sizeof(value); b++) blob[i*sizeof(value) + b] = (uint8_t) (value >> 8*b);
+    }
+#endif
+    return blob;
 }
 
-void writeBaselineToDB(struct BaselineData *& data, const char * filename, const char * cameraName){
-    // Open the SQLite3 file.
-    sqlite3 *db;
-    SQLite3_CHECK(sqlite3_open(filename, &db),db);
-
-    // Create the table for baseline data if it doesn't already exist.
-    sqlite3_stmt *stmt;
-    SQLite3_CHECK(sqlite3_prepare_v2(db,CREATE_TABLE_STATEMENT,-1,&stmt,NULL),db);
-    SQLite3_CHECK(sqlite3_step(stmt),db);
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
-
-    // Get the current datetime.
-    SQLite3_CHECK(sqlite3_prepare_v2(db,"SELECT datetime('now','localtime');",-1,&stmt,NULL),db);
-    SQLite3_CHECK(sqlite3_step(stmt),db);
-    std::string currentDatetime = reinterpret_cast<const char*>(sqlite3_column_text   (stmt,0));
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
-
-    // Doing multiple inserts inside of a transaction is faster.
-    // https://stackoverflow.com/questions/1711631/improve-insert-per-second-performance-of-sqlite
-    SQLite3_CHECK(sqlite3_prepare_v2(db,"BEGIN TRANSACTION",-1,&stmt,NULL),db);
-    SQLite3_CHECK(sqlite3_step(stmt),db);
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
-
-    // Insert a row for each pixel in the SQLite file using a prepared statement.
-    SQLite3_CHECK(sqlite3_prepare_v2(db,INSERT_TABLE_STATEMENT,-1,&stmt,NULL),db);
-    for(uint32_t i = 0; i < PIXELS_PER_LINE; i++) {
-        // Bind variables to prepared statement.
-        SQLite3_CHECK(sqlite3_bind_text  (stmt,1,cameraName,-1,NULL),db);
-        SQLite3_CHECK(sqlite3_bind_int   (stmt,2,i),db);
-        SQLite3_CHECK(sqlite3_bind_int   (stmt,3,data->gain),db);
-        SQLite3_CHECK(sqlite3_bind_int   (stmt,4,data->exposure_time),db);
-        SQLite3_CHECK(sqlite3_bind_int   (stmt,5,data->avgLine[i]),db);
-        SQLite3_CHECK(sqlite3_bind_int   (stmt,6,data->minLine[i]),db);
-        SQLite3_CHECK(sqlite3_bind_int   (stmt,7,data->maxLine[i]),db);
-        SQLite3_CHECK(sqlite3_bind_double(stmt,8,data->stdDevLine[i]),db);
-        SQLite3_CHECK(sqlite3_bind_int   (stmt,9,data->thresholdLine[i]),db);
-        SQLite3_CHECK(sqlite3_bind_text  (stmt,10,currentDatetime.c_str(),-1,NULL),db);
-        //std::cout << "Pixel: " << i << " Average: " << data->avgLine[i] << " Threshold: " << data->thresholdLine[i] << std::endl;
-        //std::cout << sqlite3_expanded_sql(stmt) << std::endl;
-        // Execute Statement.
-        SQLite3_CHECK(sqlite3_step(stmt),db);
-
-        // Reset Statement to use again.
-        SQLite3_CHECK(sqlite3_reset(stmt),db);
-        }
-    // Cleanup the statement.
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+// Copy a blob written by lineBlob from column of stmt into line, which is already as long as the baseline.
+// Returns false if the blob isn't the same length.
+template<typename T>
+static bool readLineBlob(sqlite3_stmt * stmt, int column, std::vector<T> & line) {
+    const uint8_t * blob = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, column));
+    if(blob == NULL || line.empty() || sqlite3_column_bytes(stmt, column) != (int) (line.size() * sizeof(T))) return false;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(line.data(), blob, line.size() * sizeof(T));
+#else
+    for(uint32_t i = 0; i < line.size(); i++) {
+        uint32_t value = 0;
+        for(uint32_t b = 0; b < sizeof(value); b++) value |= (uint32_t) blob[i*sizeof(value) + b] << 8*b;
+        memcpy(&line[i], &value, sizeof(value));
+    }
+#endif
+    return true;
+}
+
+// The row storing data as the baseline for cameraName created at timeCreated.
+static DatabaseRow baselineRow(const struct BaselineData * data, const std::string & cameraName,
+                               const std::string & timeCreated) {
+    return {INSERT_TABLE_STATEMENT, {cameraName, (int64_t) data->gain, (int64_t) data->exposure_time, timeCreated,
+                                     lineBlob(data->avgLine), lineBlob(data->minLine), lineBlob(data->maxLine),
+                                     lineBlob(data->stdDevLine), lineBlob(data->thresholdLine)}};
+}
 
-    // End the transaction.
-    SQLite3_CHECK(sqlite3_prepare_v2(db,"END TRANSACTION",-1,&stmt,NULL),db);
-    SQLite3_CHECK(sqlite3_step(stmt),db);
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+// Create the baseline table in filename if it doesn't exist, moving any baselines stored a row per pixel into it.
+// Only done the first time a program uses filename.
+static void prepareBaselineTable(const char * filename) {
+    static std::mutex preparedMutex;
+    static std::set<std::string> prepared;
+    std::lock_guard<std::mutex> lock(preparedMutex);
+    if(!prepared.insert(filename).second) return;
+
+    DatabaseService & database = DatabaseService::forFile(filename);
+    std::vector<DatabaseRow> rows = {{CREATE_TABLE_STATEMENT, {}}, {CREATE_INDEX_STATEMENT, {}}};
+    {
+        DatabaseSession session = database.session();
+        sqlite3 *db = session.db();
+        sqlite3_stmt *stmt = session.statement(LEGACY_TABLE_STATEMENT);
+        if(SQLite3_CHECK(sqlite3_step(stmt),db) == SQLITE_ROW) {
+            // Gather each baseline's pixels, which are returned together and in order.
+            // Baselines were always PIXELS_PER_LINE wide when they were stored this way.
+            std::unique_ptr<BaselineData> baseline(new BaselineData());
+            baseline->resize(PIXELS_PER_LINE);
+            std::string cameraName, timeCreated;
+            uint32_t pixels = 0;
+            uint32_t migrated = 0;
+            auto finishBaseline = [&]() {
+                if(pixels == 0) return;
+                if(pixels == PIXELS_PER_LINE) {
+                    rows.push_back(baselineRow(baseline.get(), cameraName, timeCreated));
+                    migrated++;
+                }
+                else {
+                    std::cerr << "Not moving the baseline for " << cameraName << " created at " << timeCreated
+                              << ". It has " << pixels << " rows instead of " << PIXELS_PER_LINE << "." << std::endl;
+                }
+                pixels = 0;
+            };
+
+            stmt = session.statement(LEGACY_SELECT_STATEMENT);
+            while(SQLite3_CHECK(sqlite3_step(stmt),db) != SQLITE_DONE) {
+                std::string rowCamera(reinterpret_cast<const char*>(sqlite3_column_text(stmt,0)));
+                uint32_t gain     = sqlite3_column_int(stmt,1);
+                uint32_t exposure = sqlite3_column_int(stmt,2);
+                std::string rowTime(reinterpret_cast<const char*>(sqlite3_column_text(stmt,3)));
+                if(pixels == 0 || rowCamera != cameraName || gain != baseline->gain ||
+                   exposure != baseline->exposure_time || rowTime != timeCreated) {
+                    finishBaseline();
+                    cameraName = rowCamera;
+                    timeCreated = rowTime;
+                    baseline->gain = gain;
+                    baseline->exposure_time = exposure;
+                }
+                uint32_t pixel = sqlite3_column_int(stmt,4);
+                if(pixel >= PIXELS_PER_LINE) continue;
+                baseline->avgLine      [pixel] = sqlite3_column_int   (stmt,5);
+                baseline->minLine      [pixel] = sqlite3_column_int   (stmt,6);
+                baseline->maxLine      [pixel] = sqlite3_column_int   (stmt,7);
+                baseline->stdDevLine   [pixel] = sqlite3_column_double(stmt,8);
+                baseline->thresholdLine[pixel] = sqlite3_column_int   (stmt,9);
+                pixels++;
+            }
+            finishBaseline();
+
+            // The old table is dropped in the same transaction the baselines are added in.
+            rows.push_back({LEGACY_DROP_STATEMENT, {}});
+            std::cout << "Moved " << migrated << " baselines in " << filename << " to one row each." << std::endl;
+        }
+    }
+    database.enqueue(std::move(rows));
+    database.flush();
+}
 
-    // Close the database file.
-    SQLite3_CHECK(sqlite3_close(db),db);
+void writeBaselineToDB(struct BaselineData *& data, const char * filename, const char * cameraName){
+    // The row is queued and committed by the database's writer thread.
+    prepareBaselineTable(filename);
+    DatabaseService::forFile(filename).enqueue({baselineRow(data, cameraName, localDatetime())});
 }
 
-void readBaselineFromDB(struct BaselineData *& data, const char * filename, const char * cameraName) {
-    // Open the SQLite3 file.
-    sqlite3 *db;
-    SQLite3_CHECK(sqlite3_open(filename, &db),db);
+// Times the baselines for cameraName with the current gain and exposure were created, newest first.
+// With latestOnly only the newest is returned.
+static std::vector<std::string> baselineTimes(const char * filename, const char * cameraName, bool latestOnly) {
+    prepareBaselineTable(filename);
+    DatabaseSession session = DatabaseService::forFile(filename).session();
+    sqlite3 *db = session.db();
 
-    // Generate an SQL statement to get the datetimes with matching gain and exposure times.
-    sqlite3_stmt *stmt;
-    SQLite3_CHECK(sqlite3_prepare_v2(db,DISTICT_BASELINE_STATEMENT,-1,&stmt,NULL),db);
+    // Get the datetimes with matching gain and exposure times. They're read from the index.
+    sqlite3_stmt *stmt = session.statement(latestOnly ? LATEST_BASELINE_STATEMENT : DISTICT_BASELINE_STATEMENT);
     SQLite3_CHECK(sqlite3_bind_text  (stmt,1,cameraName,-1,NULL),db);
     SQLite3_CHECK(sqlite3_bind_int   (stmt, 2, CAMERA_GAIN), db);
     SQLite3_CHECK(sqlite3_bind_int   (stmt,3,CAMERA_EXPOSURE_TIME),db);
@@ -125,8 +209,20 @@ void readBaselineFromDB(struct BaselineData *& data, const char * filename, cons
         collectionTimes.push_back(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt,0))));
     }
 
-    // Cleanup that statement.
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+    return collectionTimes;
+}
+
+std::string latestBaselineTime(const char * filename, const char * cameraName) {
+    std::vector<std::string> collectionTimes = baselineTimes(filename, cameraName, true);
+    return collectionTimes.empty() ? std::string() : collectionTimes[0];
+}
+
+std::string readBaselineFromDB(struct BaselineData *& data, const char * filename, const char * cameraName) {
+    std::vector<std::string> collectionTimes = baselineTimes(filename, cameraName, false);
+    if(collectionTimes.empty()) {
+        std::cerr << "There's no baseline for " << cameraName << " with the current gain and exposure. Aborting." << std::endl;
+        std::abort();
+    }
 
     // Display the list of all times collected.
     std::cout << "Choose a baseline to load from the SQLite3 file by datetime collected.\n";
@@ -143,46 +239,52 @@ void readBaselineFromDB(struct BaselineData *& data, const char * filename, cons
         std::cout << std::endl;
     }while(choice >= collectionTimes.size());
 
-    // Prepare the statement for loading the selected baseline.
-    SQLite3_CHECK(sqlite3_prepare_v2(db,SELECT_TABLE_STATEMENT,-1,&stmt,NULL),db);
+    readBaselineFromDB(data, filename, cameraName, collectionTimes[choice]);
+    return collectionTimes[choice];
+}
+
+void readBaselineFromDB(struct BaselineData *& data, const char * filename, const char * cameraName, const std::string & timeCreated) {
+    prepareBaselineTable(filename);
+    DatabaseSession session = DatabaseService::forFile(filename).session();
+    sqlite3 *db = session.db();
+
+    // The statement for loading the selected baseline, found with the index.
+    sqlite3_stmt *stmt = session.statement(SELECT_TABLE_STATEMENT);
     SQLite3_CHECK(sqlite3_bind_text(stmt,1,cameraName,-1,NULL),db);
-    SQLite3_CHECK(sqlite3_bind_text(stmt,2,collectionTimes[choice].c_str(),-1,NULL),db);
-    SQLite3_CHECK(sqlite3_bind_int(stmt, 3, CAMERA_GAIN), db);
-    SQLite3_CHECK(sqlite3_bind_int(stmt,4,CAMERA_EXPOSURE_TIME),db);
-
-    // Run the prepared statement loading the baseline information into a Baseline struct.
-    // There isn't a rigorous way to error check column statements, but if something is wrong
-    // it should show up somewhere else.
-    uint32_t pixel;
-    uint32_t loopCount = 0;
-    while(SQLite3_CHECK(sqlite3_step(stmt),db) != SQLITE_DONE)
-    {
-        pixel                      = sqlite3_column_int   (stmt,0);
-        data->avgLine      [pixel] = sqlite3_column_int   (stmt,1);
-        data->minLine      [pixel] = sqlite3_column_int   (stmt,2);
-        data->maxLine      [pixel] = sqlite3_column_int   (stmt,3);
-        data->stdDevLine   [pixel] = sqlite3_column_double(stmt,4);
-        data->thresholdLine[pixel] = sqlite3_column_int   (stmt,5);
-        loopCount++;
-    }
+    SQLite3_CHECK(sqlite3_bind_int(stmt, 2, CAMERA_GAIN), db);
+    SQLite3_CHECK(sqlite3_bind_int(stmt,3,CAMERA_EXPOSURE_TIME),db);
+    SQLite3_CHECK(sqlite3_bind_text(stmt,4,timeCreated.c_str(),-1,NULL),db);
 
-    // Extra check to see if this has been run PIXELS_PER_LINE times.
-    if(loopCount != PIXELS_PER_LINE) {
-        std::cerr << "Step executed: " << loopCount << " times. Baseline Data was not loaded for each pixel. Aborting."
+    if(SQLite3_CHECK(sqlite3_step(stmt),db) != SQLITE_ROW) {
+        std::cerr << "There's no baseline for " << cameraName << " created at " << timeCreated << ". Aborting."
                   << std::endl;
         std::abort();
     }
 
-    // Cleanup the statement.
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+    // Copy each line into the Baseline struct. The width comes from the average line and the others have to match it.
+    data->resize(sqlite3_column_bytes(stmt, 0) / sizeof(uint32_t));
+    if(!readLineBlob(stmt, 0, data->avgLine) || !readLineBlob(stmt, 1, data->minLine) ||
+       !readLineBlob(stmt, 2, data->maxLine) || !readLineBlob(stmt, 3, data->stdDevLine) ||
+       !readLineBlob(stmt, 4, data->thresholdLine)) {
+        std::cerr << "The baseline for " << cameraName << " created at " << timeCreated
+                  << " doesn't have a value for each pixel. Aborting." << std::endl;
+        std::abort();
+    }
+}
 
-    // Close the database file.
-    SQLite3_CHECK(sqlite3_close(db),db);
+void baselineCPUCalculation(struct BaselineData * data, const uint8_t *frames) {
+    // Performs the same calculations as baselineGPUCalculation on frames in host memory.
+    BaselineAccumulator accumulator;
+    for(uint32_t i = 0; i < NUM_SAMPLES; i++) {
+        accumulator.addFrame(frames + (size_t) i*PIXELS_PER_LINE*IMAGE_HEIGHT);
+    }
+    accumulator.finish(data);
 }
 
+#ifdef LSAD_USE_HIP
 void baselineGPUCalculation(struct BaselineData * GPU_h, uint8_t *frames_d) {
-    // Allocate the BaselineData struct on the device.
-    BaselineData * GPU_d;
+    // Allocate the lines on the device.
+    BaselineLines_d * GPU_d;
     initBaselineData_d(GPU_d);
 
     // Calculate the sum of all pixels grabbed and use the result to calculate the average.
@@ -213,14 +315,14 @@ void baselineGPUCalculation(struct BaselineData * GPU_h, uint8_t *frames_d) {
     hipLaunchKernelGGL(lineThresholdCalc, dim3(1), dim3(PIXELS_PER_LINE), 0, 0, GPU_d, PIXELS_PER_LINE);
     HIP_CHECK(hipGetLastError());
 
-    // Copy the BaselineData struct to the host.
+    // Copy the lines to the host.
     copyBaselineData_DeviceToHost(GPU_h, GPU_d);
 
     // GPU_d is deallocated here after being copied to the host.
     HIP_CHECK(hipFree(GPU_d));
 }
 
-__global__ void lineSumCalc(uint8_t* frames, struct BaselineData* GPU_d, uint32_t * sumLine, unsigned int N) {
+__global__ void lineSumCalc(uint8_t* frames, struct BaselineLines_d* GPU_d, uint32_t * sumLine, unsigned int N) {
     uint32_t idx = (hipBlockIdx_x * hipBlockDim_x + hipThreadIdx_x);
 
     if (idx < N) {
@@ -230,7 +332,7 @@ __global__ void lineSumCalc(uint8_t* frames, struct BaselineData* GPU_d, uint32_
     }
 }
 
-__global__ void lineAvgCalc(struct BaselineData* GPU_d, uint32_t * sumLine, unsigned int N) {
+__global__ void lineAvgCalc(struct BaselineLines_d* GPU_d, uint32_t * sumLine, unsigned int N) {
     uint32_t idx = (hipBlockIdx_x * hipBlockDim_x + hipThreadIdx_x);
 
     if (idx < N) {
@@ -238,7 +340,7 @@ __global__ void lineAvgCalc(struct BaselineData* GPU_d, uint32_t * sumLine, unsi
     }
 }
 
-__global__ void lineStdDevStep1Calc(uint8_t* frames, struct BaselineData* GPU_d, uint32_t * intermediateLine, unsigned int N) {
+__global__ void lineStdDevStep1Calc(uint8_t* frames, struct BaselineLines_d* GPU_d, uint32_t * intermediateLine, unsigned int N) {
     uint32_t idx = (hipBlockIdx_x * hipBlockDim_x + hipThreadIdx_x);
 
     if (idx < N) {
@@ -247,7 +349,7 @@ __global__ void lineStdDevStep1Calc(uint8_t* frames, struct BaselineData* GPU_d,
     }
 }
 
-__global__ void lineStdDevStep2Calc(struct BaselineData* GPU_d, uint32_t * intermediateLine, unsigned int N) {
+__global__ void lineStdDevStep2Calc(struct BaselineLines_d* GPU_d, uint32_t * intermediateLine, unsigned int N) {
     uint32_t idx = (hipBlockIdx_x * hipBlockDim_x + hipThreadIdx_x);
 
     if (idx < N) {
@@ -255,7 +357,7 @@ __global__ void lineStdDevStep2Calc(struct BaselineData* GPU_d, uint32_t * inter
     }
 }
 
-__global__ void lineThresholdCalc(struct BaselineData* GPU_d, unsigned int N) {
+__global__ void lineThresholdCalc(struct BaselineLines_d* GPU_d, unsigned int N) {
     uint32_t idx = (hipBlockIdx_x * hipBlockDim_x + hipThreadIdx_x);
 
     if (idx < N) {
@@ -267,3 +369,4 @@ __global__ void lineThresholdCalc(struct BaselineData* GPU_d, unsigned int N) {
         }
     }
 }
+#endif //LSAD_USE_HIP
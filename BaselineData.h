@@ -24,7 +24,9 @@
 #include <sqlite3.h>
 #include <vector>
 #include <string>
+#ifdef LSAD_USE_HIP
 #include "hip/hip_runtime.h"
+#endif
 #include "camerasettings.h"
 #include "errorCheckingMacros.h"
 
@@ -34,19 +36,68 @@
 #define LINE_BYTES_DOUBLE PIXELS_PER_LINE   * sizeof(double)
 
 // SQL Statements:
-#define CREATE_TABLE_STATEMENT     "CREATE TABLE IF NOT EXISTS 'Baseline Data' ('cameraName' TEXT,'pixel' INTEGER, 'gain' INTEGER, 'exposure' INTEGER, 'avg' INTEGER, 'min' INTEGER, 'max' INTEGER, 'stdDev' REAL, 'fiveSigma' INTEGER, 'timeCreated' TEXT);"
+// Each baseline is one row. The lines are little-endian arrays of one uint32_t (float for stdDev) per pixel,
+// laid out the same as in BaselineData. The blobs are as long as the sensor the baseline was collected with.
+#define CREATE_TABLE_STATEMENT     "CREATE TABLE IF NOT EXISTS 'Baselines' ('cameraName' TEXT, 'gain' INTEGER, 'exposure' INTEGER, 'timeCreated' TEXT, 'avg' BLOB, 'min' BLOB, 'max' BLOB, 'stdDev' BLOB, 'fiveSigma' BLOB);"
 
-#define INSERT_TABLE_STATEMENT     "INSERT INTO 'Baseline Data' VALUES(?,?,?,?,?,?,?,?,?,?);"
+#define CREATE_INDEX_STATEMENT     "CREATE UNIQUE INDEX IF NOT EXISTS 'Baselines Lookup' ON 'Baselines' ('cameraName', 'gain', 'exposure', 'timeCreated');"
 
-#define SELECT_TABLE_STATEMENT     "SELECT pixel, avg, min, max, stdDev, fiveSigma FROM 'Baseline Data' WHERE cameraName=? AND timeCreated=? AND gain=? AND exposure=?;"
+#define INSERT_TABLE_STATEMENT     "INSERT OR REPLACE INTO 'Baselines' VALUES(?,?,?,?,?,?,?,?,?);"
 
-#define DISTICT_BASELINE_STATEMENT "SELECT DISTINCT timeCreated FROM 'Baseline Data' WHERE cameraName=? AND gain=? AND exposure=? ORDER BY timeCreated DESC;"
+#define SELECT_TABLE_STATEMENT     "SELECT avg, min, max, stdDev, fiveSigma FROM 'Baselines' WHERE cameraName=? AND gain=? AND exposure=? AND timeCreated=?;"
 
-// BaselineData definition for GPU and host:
+#define DISTICT_BASELINE_STATEMENT "SELECT timeCreated FROM 'Baselines' WHERE cameraName=? AND gain=? AND exposure=? ORDER BY timeCreated DESC;"
+
+#define LATEST_BASELINE_STATEMENT  "SELECT timeCreated FROM 'Baselines' WHERE cameraName=? AND gain=? AND exposure=? ORDER BY timeCreated DESC LIMIT 1;"
+
+// The table baselines were stored in before, with a row for each pixel. It's moved to 'Baselines' the first time
+// a program uses the database.
+#define LEGACY_TABLE_STATEMENT     "SELECT 1 FROM sqlite_master WHERE type='table' AND name='Baseline Data';"
+
+#define LEGACY_SELECT_STATEMENT    "SELECT cameraName, gain, exposure, timeCreated, pixel, avg, min, max, stdDev, fiveSigma FROM 'Baseline Data' ORDER BY cameraName, gain, exposure, timeCreated, pixel;"
+
+#define LEGACY_DROP_STATEMENT      "DROP TABLE 'Baseline Data';"
+
+// Environment variable choosing how main_baseline calculates the baseline.
+// "gpu" copies every frame to the GPU and uses baselineGPUCalculation (only when built with LSAD_USE_HIP).
+// Otherwise frames are folded into a BaselineAccumulator as they're grabbed.
+#define BASELINE_BACKEND_ENV "LSAD_BASELINE_BACKEND"
+
+// BaselineData definition for the host. Each line has a value for every pixel of the sensor it was collected with.
 struct BaselineData
 {
     uint32_t  gain;
     uint32_t  exposure_time;
+    std::vector<uint32_t> minLine;
+    std::vector<uint32_t> maxLine;
+    std::vector<uint32_t> avgLine;
+    std::vector<float>    stdDevLine;
+    std::vector<uint32_t> thresholdLine;
+
+    // Pixels in each line.
+    uint32_t pixelsPerLine() const { return thresholdLine.size(); }
+
+    // Make each line pixels long. Pixels added have a min of 255 and a max of 0, and 0 for the rest.
+    void resize(uint32_t pixels);
+};
+
+// Host functions
+// Allocate data with lines of pixels. It's freed with delete.
+void initBaselineData_h(struct BaselineData *& data, uint32_t gain, uint32_t exposure_time,
+                        uint32_t pixels = PIXELS_PER_LINE);
+void baselineCPUCalculation(struct BaselineData * data, const uint8_t *frames);
+void writeBaselineToDB(struct BaselineData *& data, const char * filename, const char * cameraName);
+// Lists the baselines for cameraName and asks which one to load. Returns the time the chosen baseline was created.
+std::string readBaselineFromDB(struct BaselineData *& data, const char * filename, const char * cameraName);
+// Load the baseline for cameraName created at timeCreated without asking. data is resized to the stored width.
+void readBaselineFromDB(struct BaselineData *& data, const char * filename, const char * cameraName, const std::string & timeCreated);
+// Time the newest baseline for cameraName with the current gain and exposure was created, or an empty string if there isn't one.
+std::string latestBaselineTime(const char * filename, const char * cameraName);
+
+#ifdef LSAD_USE_HIP
+// The lines of a baseline in GPU memory. The GPU calculation only handles frames of the default geometry.
+struct BaselineLines_d
+{
     uint32_t  minLine[PIXELS_PER_LINE];
     uint32_t  maxLine[PIXELS_PER_LINE];
     uint32_t  avgLine[PIXELS_PER_LINE];
@@ -54,20 +105,18 @@ struct BaselineData
     uint32_t  thresholdLine[PIXELS_PER_LINE];
 };
 
-// Host functions
-void initBaselineData_h(struct BaselineData *& data, uint32_t gain, uint32_t exposure_time);
-void initBaselineData_d(struct BaselineData *& data);
-void copyBaselineData_DeviceToHost(struct BaselineData *& GPU_h, BaselineData *& GPU_d);
+// Host functions using the GPU
+void initBaselineData_d(struct BaselineLines_d *& data);
+void copyBaselineData_DeviceToHost(struct BaselineData * GPU_h, const struct BaselineLines_d * GPU_d);
 void baselineGPUCalculation(struct BaselineData * GPU_h, uint8_t *frames_d);
-void writeBaselineToDB(struct BaselineData *& data, const char * filename, const char * cameraName);
-void readBaselineFromDB(struct BaselineData *& data, const char * filename, const char * cameraName);
-void copyBaselineData_HostToDevice(struct BaselineData *& GPU_h, struct BaselineData *& GPU_d);
+void copyBaselineData_HostToDevice(const struct BaselineData * GPU_h, struct BaselineLines_d * GPU_d);
 
 // GPU functions called exclusively by baselineGPUCalculation
-__global__ void lineSumCalc(uint8_t* frames, struct BaselineData* GPU_d, uint32_t * sumLine, unsigned int N);
-__global__ void lineAvgCalc(struct BaselineData* GPU_d, uint32_t * sumLine, unsigned int N);
-__global__ void lineStdDevStep1Calc(uint8_t* frames, struct BaselineData* GPU_d, uint32_t * intermediateLine, unsigned int N);
-__global__ void lineStdDevStep2Calc(struct BaselineData* GPU_d, uint32_t * intermediateLine, unsigned int N);
-__global__ void lineThresholdCalc(struct BaselineData* GPU_d, unsigned int N);
+__global__ void lineSumCalc(uint8_t* frames, struct BaselineLines_d* GPU_d, uint32_t * sumLine, unsigned int N);
+__global__ void lineAvgCalc(struct BaselineLines_d* GPU_d, uint32_t * sumLine, unsigned int N);
+__global__ void lineStdDevStep1Calc(uint8_t* frames, struct BaselineLines_d* GPU_d, uint32_t * intermediateLine, unsigned int N);
+__global__ void lineStdDevStep2Calc(struct BaselineLines_d* GPU_d, uint32_t * intermediateLine, unsigned int N);
+__global__ void lineThresholdCalc(struct BaselineLines_d* GPU_d, unsigned int N);
+#endif //LSAD_USE_HIP
 
 #endif //UNTITLED_BASELINEDATA_H
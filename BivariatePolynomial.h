@@ -0,0 +1,104 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_BIVARIATEPOLYNOMIAL_H
+#define UNTITLED_BIVARIATEPOLYNOMIAL_H
+
+#include <cstddef>
+
+// Points evaluated together by evaluateBatch. The loops over a block are written so the compiler vectorizes them.
+#define POLYNOMIAL_BATCH_LANES 8
+
+// A polynomial in two variables with every term up to Degree.
+// Coefficients are given in graded order, the same order as the coefficients table:
+// 1, a, b, a^2, ab, b^2, a^3, a^2b, ab^2, b^3, ...
+// The term a^i b^j is at index (i+j)(i+j+1)/2 + j.
+template<int Degree>
+class BivariatePolynomial {
+public:
+    static_assert(Degree >= 0, "The degree of a polynomial can't be negative.");
+    static constexpr int NUM_TERMS = (Degree + 1) * (Degree + 2) / 2;
+
+private:
+    // Coefficients in the order evaluate uses them. Rows of b coefficients for a^Degree down to a^0,
+    // each from the highest power of b down.
+    double horner[NUM_TERMS] = {};
+
+public:
+    BivariatePolynomial() = default;
+
+    explicit BivariatePolynomial(const double * coefficients){
+        setCoefficients(coefficients);
+    }
+
+    // Set the NUM_TERMS coefficients in graded order.
+    void setCoefficients(const double * coefficients){
+        int k = 0;
+        for(int i = Degree; i >= 0; i--){
+            for(int j = Degree - i; j >= 0; j--){
+                horner[k++] = coefficients[(i + j) * (i + j + 1) / 2 + j];
+            }
+        }
+    }
+
+    // Horner's method in b for each power of a, nested in Horner's method in a.
+    // Uses NUM_TERMS multiplies and adds instead of building every power of a and b.
+    double evaluate(double a, double b) const {
+        const double * c = horner;
+        double result = 0;
+        for(int i = Degree; i >= 0; i--){
+            double row = *c++;
+            for(int j = Degree - i; j > 0; j--) row = row * b + *c++;
+            result = result * a + row;
+        }
+        return result;
+    }
+
+    // out[n] = evaluate(a[n], b[n]) for count points.
+    // The arrays needn't be aligned and out can't overlap a or b.
+    void evaluateBatch(const double * a, const double * b, double * out, size_t count) const {
+        size_t n = 0;
+        for(; n + POLYNOMIAL_BATCH_LANES <= count; n += POLYNOMIAL_BATCH_LANES){
+            evaluateBlock(a + n, b + n, out + n);
+        }
+        for(; n < count; n++) out[n] = evaluate(a[n], b[n]);
+    }
+
+    // evaluate for POLYNOMIAL_BATCH_LANES points. Each step of Horner's method is applied to every lane.
+    // Always inlined so a caller compiled for a wider instruction set vectorizes it with that instruction set.
+    __attribute__((always_inline)) inline void evaluateBlock(const double * a, const double * b, double * out) const {
+        double result[POLYNOMIAL_BATCH_LANES] = {};
+        const double * c = horner;
+        for(int i = Degree; i >= 0; i--){
+            double row[POLYNOMIAL_BATCH_LANES];
+            for(int lane = 0; lane < POLYNOMIAL_BATCH_LANES; lane++) row[lane] = c[0];
+            c++;
+            for(int j = Degree - i; j > 0; j--){
+                for(int lane = 0; lane < POLYNOMIAL_BATCH_LANES; lane++) row[lane] = row[lane] * b[lane] + c[0];
+                c++;
+            }
+            for(int lane = 0; lane < POLYNOMIAL_BATCH_LANES; lane++) result[lane] = result[lane] * a[lane] + row[lane];
+        }
+        for(int lane = 0; lane < POLYNOMIAL_BATCH_LANES; lane++) out[lane] = result[lane];
+    }
+};
+
+#endif //UNTITLED_BIVARIATEPOLYNOMIAL_H
@@ -0,0 +1,80 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "CameraConfiguration.h"
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+// Split value at each comma, and semicolon when lanes are listed, skipping empty names.
+static std::vector<std::string> splitNames(const char * value){
+    std::vector<std::string> names;
+    std::string name;
+    for(const char * c = value; ; c++){
+        if(*c == ',' || *c == ';' || *c == '\0'){
+            if(!name.empty()) names.push_back(name);
+            name.clear();
+            if(*c == '\0') break;
+        }
+        else{
+            name += *c;
+        }
+    }
+    return names;
+}
+
+const std::vector<std::string> & cameraNames(){
+    static const std::vector<std::string> names = []{
+        const char * value = getenv(CAMERA_NAMES_ENV);
+        if(value == NULL) value = getenv(LANES_ENV);
+        std::vector<std::string> names = splitNames(value != NULL ? value : "");
+        return names.empty() ? splitNames(DEFAULT_CAMERA_NAMES) : names;
+    }();
+    return names;
+}
+
+int cameraNumber(const char * cameraName){
+    const std::vector<std::string> & names = cameraNames();
+    for(size_t i = 0; i < names.size(); i++){
+        if(names[i] == cameraName) return (int) i;
+    }
+    return -1;
+}
+
+bool parseSensorGeometry(const char * value, SensorGeometry & geometry){
+    unsigned width, height;
+    char end;
+    if(value == NULL || sscanf(value, "%ux%u%c", &width, &height, &end) != 2) return false;
+    geometry.pixelsPerLine = width;
+    geometry.imageHeight = height;
+    return true;
+}
+
+void checkSensorGeometry(const char * cameraName, const SensorGeometry & geometry){
+    if(geometry.pixelsPerLine == 0 || geometry.pixelsPerLine % 64 != 0){
+        throw std::runtime_error(std::string(cameraName) + " sends lines of " + std::to_string(geometry.pixelsPerLine)
+                                 + " pixels. Lines must be a multiple of 64 pixels.");
+    }
+    if(geometry.imageHeight < MIN_IMAGE_HEIGHT){
+        throw std::runtime_error(std::string(cameraName) + " sends frames of " + std::to_string(geometry.imageHeight)
+                                 + " lines. Frames must have at least " + std::to_string(MIN_IMAGE_HEIGHT) + " lines.");
+    }
+}
@@ -0,0 +1,71 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_CAMERACONFIGURATION_H
+#define UNTITLED_CAMERACONFIGURATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "camerasettings.h"
+
+// Environment variable listing the user defined camera names separated by commas, e.g. "L45,L90,L135".
+// A camera's number is its position in the list. Defaults to DEFAULT_CAMERA_NAMES.
+#define CAMERA_NAMES_ENV "LSAD_CAMERA_NAMES"
+
+// Environment variable listing the cameras of each lane, with lanes separated by semicolons, e.g. "L45,L90;R45,R90".
+// Used by the lanes program. When CAMERA_NAMES_ENV isn't set the cameras are numbered in the order they're listed here.
+#define LANES_ENV "LSAD_LANES"
+
+// The adaptive baseline folds 8 lines of a frame at a time, so a frame needs at least that many.
+#define MIN_IMAGE_HEIGHT 8
+
+// Width and height of the frames a camera sends. Lines are packed one after another with no padding.
+// Read from each camera when it's opened, so a camera cropped narrower or sending a different number of lines
+// doesn't need a rebuild. The detection buffers of each camera are sized from it, so frames can also be wider than
+// PIXELS_PER_LINE, which only picks the width detection has its fastest build for.
+struct SensorGeometry
+{
+    uint32_t pixelsPerLine = PIXELS_PER_LINE;
+    uint32_t imageHeight = IMAGE_HEIGHT;
+
+    size_t frameBytes() const { return (size_t) pixelsPerLine * imageHeight; }
+    bool operator==(const SensorGeometry & other) const {
+        return pixelsPerLine == other.pixelsPerLine && imageHeight == other.imageHeight;
+    }
+    bool operator!=(const SensorGeometry & other) const { return !(*this == other); }
+};
+
+// Camera names from CAMERA_NAMES_ENV, or every lane's cameras from LANES_ENV, read the first time it's called.
+const std::vector<std::string> & cameraNames();
+
+// Camera number for a user defined camera name, or -1 if it isn't in cameraNames.
+int cameraNumber(const char * cameraName);
+
+// Read a geometry written as WIDTHxHEIGHT, e.g. "1024x256". Returns false when value isn't in that form.
+bool parseSensorGeometry(const char * value, SensorGeometry & geometry);
+
+// Throws when frames of geometry from cameraName can't be measured. The width has to be a multiple of 64
+// for the SIMD backends and the column mask, and there have to be at least MIN_IMAGE_HEIGHT lines.
+void checkSensorGeometry(const char * cameraName, const SensorGeometry & geometry);
+
+#endif //UNTITLED_CAMERACONFIGURATION_H
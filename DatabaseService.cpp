@@ -0,0 +1,174 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "DatabaseService.h"
+#include "filenames.h"
+#include <ctime>
+#include <memory>
+
+std::string localDatetime(){
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    return text;
+}
+
+DatabaseSession::DatabaseSession(DatabaseService & service) : service(service), lock(service.connectionMutex) {}
+
+DatabaseSession::~DatabaseSession(){
+    for(sqlite3_stmt * stmt : used){
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+}
+
+sqlite3 * DatabaseSession::db() const {
+    return service.db;
+}
+
+sqlite3_stmt * DatabaseSession::statement(const char * sql){
+    sqlite3_stmt * stmt = service.cachedStatement(sql);
+    used.push_back(stmt);
+    return stmt;
+}
+
+DatabaseService::DatabaseService(const char * filename){
+    SQLite3_CHECK(sqlite3_open(filename, &db),db);
+    SQLite3_CHECK(sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS),db);
+
+    // WAL lets other programs read while this one writes. It's stored in the file, so it only changes once.
+    // With WAL, synchronous NORMAL only syncs at checkpoints instead of on every commit.
+    SQLite3_CHECK(sqlite3_exec(db,"PRAGMA journal_mode=WAL;",NULL,NULL,NULL),db);
+    SQLite3_CHECK(sqlite3_exec(db,"PRAGMA synchronous=NORMAL;",NULL,NULL,NULL),db);
+
+    writer = std::thread(&DatabaseService::writeRows, this);
+}
+
+DatabaseService::~DatabaseService(){
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queued.notify_one();
+    writer.join();
+
+    for(auto & entry : statements){
+        SQLite3_CHECK(sqlite3_finalize(entry.second),db);
+    }
+    SQLite3_CHECK(sqlite3_close(db),db);
+}
+
+// Every service opened, by filename. Destroyed when the program exits, committing what's left in each queue.
+static std::mutex servicesMutex;
+static std::map<std::string, std::unique_ptr<DatabaseService>> services;
+
+DatabaseService & DatabaseService::forFile(const char * filename){
+    std::lock_guard<std::mutex> lock(servicesMutex);
+    std::unique_ptr<DatabaseService> & service = services[filename];
+    if(!service) service.reset(new DatabaseService(filename));
+    return *service;
+}
+
+void DatabaseService::close(const char * filename){
+    std::lock_guard<std::mutex> lock(servicesMutex);
+    services.erase(filename);
+}
+
+sqlite3_stmt * DatabaseService::cachedStatement(const char * sql){
+    sqlite3_stmt *& stmt = statements[sql];
+    if(stmt == NULL){
+        SQLite3_CHECK(sqlite3_prepare_v3(db,sql,-1,SQLITE_PREPARE_PERSISTENT,&stmt,NULL),db);
+    }
+    return stmt;
+}
+
+DatabaseSession DatabaseService::session(){
+    flush();
+    return DatabaseSession(*this);
+}
+
+void DatabaseService::enqueue(std::vector<DatabaseRow> rows){
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        rowsQueued += rows.size();
+        if(queue.empty()) queue = std::move(rows);
+        else queue.insert(queue.end(), std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+    }
+    queued.notify_one();
+}
+
+void DatabaseService::flush(){
+    std::unique_lock<std::mutex> lock(queueMutex);
+    uint64_t target = rowsQueued;
+    written.wait(lock, [&]{ return rowsWritten >= target; });
+}
+
+// Bind value to parameter index of stmt. Text and blobs are only used while the row is being written.
+static void bindValue(sqlite3 * db, sqlite3_stmt * stmt, int index, const DatabaseValue & value){
+    if(const int64_t * integer = std::get_if<int64_t>(&value)){
+        SQLite3_CHECK(sqlite3_bind_int64(stmt,index,*integer),db);
+    }
+    else if(const double * real = std::get_if<double>(&value)){
+        SQLite3_CHECK(sqlite3_bind_double(stmt,index,*real),db);
+    }
+    else if(const std::string * text = std::get_if<std::string>(&value)){
+        SQLite3_CHECK(sqlite3_bind_text(stmt,index,text->c_str(),(int) text->size(),SQLITE_STATIC),db);
+    }
+    else{
+        const DatabaseBlob & blob = std::get<DatabaseBlob>(value);
+        SQLite3_CHECK(sqlite3_bind_blob(stmt,index,blob.data(),(int) blob.size(),SQLITE_STATIC),db);
+    }
+}
+
+void DatabaseService::writeRows(){
+    std::vector<DatabaseRow> rows;
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while(true){
+        queued.wait(lock, [this]{ return stopping || !queue.empty(); });
+        if(queue.empty()) break;
+
+        // Take everything queued. Rows queued while these are written go in the next transaction.
+        rows.swap(queue);
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> connection(connectionMutex);
+            SQLite3_CHECK(sqlite3_exec(db,"BEGIN TRANSACTION;",NULL,NULL,NULL),db);
+            for(const DatabaseRow & row : rows){
+                sqlite3_stmt * stmt = cachedStatement(row.sql);
+                for(size_t i = 0; i < row.values.size(); i++){
+                    bindValue(db, stmt, (int) i + 1, row.values[i]);
+                }
+                SQLite3_CHECK(sqlite3_step(stmt),db);
+                SQLite3_CHECK(sqlite3_reset(stmt),db);
+                SQLite3_CHECK(sqlite3_clear_bindings(stmt),db);
+            }
+            SQLite3_CHECK(sqlite3_exec(db,"COMMIT;",NULL,NULL,NULL),db);
+        }
+        size_t count = rows.size();
+        rows.clear();
+
+        lock.lock();
+        rowsWritten += count;
+        written.notify_all();
+    }
+}
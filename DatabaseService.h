@@ -0,0 +1,129 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_DATABASESERVICE_H
+#define UNTITLED_DATABASESERVICE_H
+
+#include <sqlite3.h>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+#include "errorCheckingMacros.h"
+
+// Bytes bound as a BLOB.
+typedef std::vector<uint8_t> DatabaseBlob;
+
+// A value bound to a queued statement.
+typedef std::variant<int64_t, double, std::string, DatabaseBlob> DatabaseValue;
+
+// A statement to run on the writer thread with the values bound to its parameters in order.
+// sql is one of the statement macros, so it's never freed.
+struct DatabaseRow
+{
+    const char * sql;
+    std::vector<DatabaseValue> values;
+};
+
+// The current local time formatted the same as SQLite's datetime('now','localtime').
+std::string localDatetime();
+
+class DatabaseService;
+
+// Locked use of a DatabaseService's connection on the calling thread.
+// Statements handed out are reset when the session ends, so no read is left open.
+// Don't start another session or queue rows for the same file while holding one.
+class DatabaseSession {
+private:
+    DatabaseService & service;
+    std::unique_lock<std::mutex> lock;
+    std::vector<sqlite3_stmt *> used;
+public:
+    explicit DatabaseSession(DatabaseService & service);
+    ~DatabaseSession();
+
+    DatabaseSession(const DatabaseSession &) = delete;
+    DatabaseSession & operator=(const DatabaseSession &) = delete;
+
+    // The connection, for SQLite3_CHECK.
+    sqlite3 * db() const;
+
+    // The prepared statement for sql, prepared the first time it's used and kept for the life of the connection.
+    sqlite3_stmt * statement(const char * sql);
+};
+
+// One connection to a database file kept open for the whole program, in WAL mode so readers in other programs
+// don't wait for writes. Prepared statements are cached by their SQL.
+// Writes are queued and a writer thread commits everything queued in one transaction, so queuing never waits
+// for SQLite or the disk. The rows queued together are always committed together.
+class DatabaseService {
+private:
+    friend class DatabaseSession;
+
+    sqlite3 * db;
+
+    // Held by a session or the writer thread while it uses db or statements.
+    std::mutex connectionMutex;
+    std::map<std::string, sqlite3_stmt *> statements;
+
+    std::mutex queueMutex;
+    std::condition_variable queued;
+    std::condition_variable written;
+    std::vector<DatabaseRow> queue;
+    uint64_t rowsQueued = 0;
+    uint64_t rowsWritten = 0;
+    bool stopping = false;
+    std::thread writer;
+
+    // The cached statement for sql. connectionMutex must be held.
+    sqlite3_stmt * cachedStatement(const char * sql);
+
+    // Commit queued rows until the service is stopped.
+    void writeRows();
+public:
+    explicit DatabaseService(const char * filename);
+    // Commits the rows still queued before closing the connection.
+    ~DatabaseService();
+
+    DatabaseService(const DatabaseService &) = delete;
+    DatabaseService & operator=(const DatabaseService &) = delete;
+
+    // The service for filename, opened the first time it's asked for and closed when the program exits.
+    static DatabaseService & forFile(const char * filename);
+
+    // Commit what's queued for filename and close its connection. Used before removing the file.
+    static void close(const char * filename);
+
+    // Lock the connection for reading. Waits for the rows already queued, so reads see them.
+    DatabaseSession session();
+
+    // Queue rows to be committed in the same transaction. Returns without waiting for them.
+    void enqueue(std::vector<DatabaseRow> rows);
+
+    // Wait until every row queued so far is committed.
+    void flush();
+};
+
+#endif //UNTITLED_DATABASESERVICE_H
@@ -0,0 +1,77 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "DetectionPipeline.h"
+#include "DetectorContext.h"
+#include "StereoCorrelator.h"
+#include <chrono>
+#include <thread>
+
+// Polls before the consumer starts sleeping. A frame usually finishes within a few microseconds of the other camera's.
+#define DETECTION_SPIN_POLLS 1000
+
+// How long the consumer sleeps between polls after spinning.
+#define DETECTION_POLL_SLEEP_US 50
+
+bool pollStereoEvent(DetectorContext & context, StereoCorrelator & correlator, StereoEvent & event){
+    // The correlator pairs the first two cameras.
+    DetectionResult result;
+    for(uint32_t i = 0; i < 2 && i < context.cameraCount(); i++){
+        DetectionRing & ring = context.camera(i).results;
+        while(ring.tryPop(result)) correlator.add(result);
+    }
+    return correlator.poll(event);
+}
+
+bool pollStereoEvent(StereoCorrelator & correlator, StereoEvent & event){
+    return pollStereoEvent(detectorContext(), correlator, event);
+}
+
+bool waitForStereoEvent(DetectorContext & context, StereoCorrelator & correlator, StereoEvent & event, uint32_t timeoutMs){
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for(uint32_t polls = 0; !pollStereoEvent(context, correlator, event); polls++){
+        if(polls < DETECTION_SPIN_POLLS){
+            std::this_thread::yield();
+            continue;
+        }
+        if(std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(DETECTION_POLL_SLEEP_US));
+    }
+    return true;
+}
+
+bool waitForStereoEvent(StereoCorrelator & correlator, StereoEvent & event, uint32_t timeoutMs){
+    return waitForStereoEvent(detectorContext(), correlator, event, timeoutMs);
+}
+
+bool waitForDetectionResult(DetectorContext & context, uint32_t cameraNo, DetectionResult & result, uint32_t timeoutMs){
+    DetectionRing & ring = context.camera(cameraNo).results;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for(uint32_t polls = 0; !ring.tryPop(result); polls++){
+        if(polls < DETECTION_SPIN_POLLS){
+            std::this_thread::yield();
+            continue;
+        }
+        if(std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(DETECTION_POLL_SLEEP_US));
+    }
+    return true;
+}
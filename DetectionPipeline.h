@@ -0,0 +1,69 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_DETECTIONPIPELINE_H
+#define UNTITLED_DETECTIONPIPELINE_H
+
+#include <cstdint>
+#include "SpscRing.h"
+#include "columnSegmentation.h"
+
+// Results waiting in each camera's ring. The rings only need to hold the results the main loop hasn't taken yet.
+#define DETECTION_RING_SIZE 64
+
+// What detectObject found in one frame.
+struct DetectionResult
+{
+    uint32_t cameraNo;
+    // Chunk timestamp and frame number of the frame.
+    uint64_t timestamp;
+    uint64_t frameNumber;
+    // False when the frame failed its CRC check. Nothing else is set.
+    bool valid;
+    // True when any column was blocked.
+    bool detected;
+    // Runs of blocked columns from left to right. Each object in front of the screen blocks its own run.
+    uint32_t runCount;
+    ColumnRun runs[MAX_COLUMN_RUNS];
+};
+
+// A ring of results for one camera. The camera's grab thread is the producer and the main loop is the consumer.
+typedef SpscRing<DetectionResult, DETECTION_RING_SIZE> DetectionRing;
+
+class DetectorContext;
+class StereoCorrelator;
+struct StereoEvent;
+
+// Move the results waiting in the rings of the first two cameras in context into correlator and take its next event.
+// Doesn't wait. The one without a context uses detectorContext().
+bool pollStereoEvent(DetectorContext & context, StereoCorrelator & correlator, StereoEvent & event);
+bool pollStereoEvent(StereoCorrelator & correlator, StereoEvent & event);
+
+// Wait up to timeoutMs for the next event from correlator. Returns false on timeout.
+// Spins briefly and then sleeps in short steps, so no lock is shared with the grab threads.
+bool waitForStereoEvent(DetectorContext & context, StereoCorrelator & correlator, StereoEvent & event, uint32_t timeoutMs);
+bool waitForStereoEvent(StereoCorrelator & correlator, StereoEvent & event, uint32_t timeoutMs);
+
+// Wait up to timeoutMs for the next result in the ring of camera cameraNo of context, for cameras after the first
+// two, which the correlator doesn't pair. Returns false on timeout.
+bool waitForDetectionResult(DetectorContext & context, uint32_t cameraNo, DetectionResult & result, uint32_t timeoutMs);
+
+#endif //UNTITLED_DETECTIONPIPELINE_H
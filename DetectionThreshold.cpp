@@ -0,0 +1,66 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "DetectionThreshold.h"
+#include "DetectorContext.h"
+#include "cpuDetection.h"
+#include <atomic>
+
+DetectionThreshold::~DetectionThreshold(){
+#ifdef LSAD_USE_HIP
+    if(thresholdLine_d != nullptr) HIP_CHECK(hipFree(thresholdLine_d));
+#endif
+}
+
+std::shared_ptr<const DetectionThreshold> makeDetectionThreshold(const BaselineData * baseline, const std::string & timeCreated){
+    std::shared_ptr<DetectionThreshold> threshold = std::make_shared<DetectionThreshold>();
+    threshold->timeCreated = timeCreated;
+    threshold->baseline = *baseline;
+#ifdef LSAD_USE_HIP
+    if(currentDetectionBackend() == DetectionBackend::GPU) {
+        size_t lineBytes = threshold->baseline.thresholdLine.size() * sizeof(uint32_t);
+        HIP_CHECK(hipMalloc(&threshold->thresholdLine_d, lineBytes));
+        HIP_CHECK(hipMemcpy(threshold->thresholdLine_d, threshold->baseline.thresholdLine.data(), lineBytes, hipMemcpyHostToDevice));
+    }
+#endif
+    return threshold;
+}
+
+std::shared_ptr<const DetectionThreshold> currentDetectionThreshold(CameraContext & camera){
+    return std::atomic_load(&camera.threshold);
+}
+
+std::shared_ptr<const DetectionThreshold> currentDetectionThreshold(uint32_t cameraNo){
+    return currentDetectionThreshold(detectorContext().camera(cameraNo));
+}
+
+void publishDetectionThreshold(CameraContext & camera, std::shared_ptr<const DetectionThreshold> threshold){
+    std::atomic_store(&camera.threshold, std::move(threshold));
+}
+
+void publishDetectionThreshold(uint32_t cameraNo, std::shared_ptr<const DetectionThreshold> threshold){
+    publishDetectionThreshold(detectorContext().camera(cameraNo), std::move(threshold));
+}
+
+bool replaceDetectionThreshold(CameraContext & camera, std::shared_ptr<const DetectionThreshold> expected,
+                               std::shared_ptr<const DetectionThreshold> threshold){
+    return std::atomic_compare_exchange_strong(&camera.threshold, &expected, std::move(threshold));
+}
@@ -0,0 +1,69 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_DETECTIONTHRESHOLD_H
+#define UNTITLED_DETECTIONTHRESHOLD_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "BaselineData.h"
+#include "camerasettings.h"
+
+// One version of a camera's baseline as detection uses it.
+// Loading or adapting a baseline publishes a whole new version instead of changing this one. A frame holds the version
+// it started with, so a version is only freed after the last frame measured against it is finished.
+struct DetectionThreshold
+{
+    // When the baseline this version was loaded or adapted from was collected.
+    std::string timeCreated;
+    // Frames are compared to baseline.thresholdLine. The rest seeds the adaptive baseline and is written by checkpoints.
+    BaselineData baseline;
+    // Copy of baseline.thresholdLine in GPU memory for the GPU detection backend, otherwise NULL.
+    uint32_t * thresholdLine_d = nullptr;
+
+    DetectionThreshold() = default;
+    DetectionThreshold(const DetectionThreshold &) = delete;
+    DetectionThreshold & operator=(const DetectionThreshold &) = delete;
+    ~DetectionThreshold();
+};
+
+// A new version holding a copy of baseline. The threshold line is copied to the GPU when the GPU detection backend is used.
+std::shared_ptr<const DetectionThreshold> makeDetectionThreshold(const BaselineData * baseline, const std::string & timeCreated);
+
+struct CameraContext;
+
+// The version frames from camera are measured against. Safe to call from any thread.
+// The cameraNo versions are for camera cameraNo of detectorContext().
+std::shared_ptr<const DetectionThreshold> currentDetectionThreshold(CameraContext & camera);
+std::shared_ptr<const DetectionThreshold> currentDetectionThreshold(uint32_t cameraNo);
+
+// Make threshold the version the next frame from camera is measured against.
+// Frames already being measured finish with the old version. Pass nullptr to release it.
+void publishDetectionThreshold(CameraContext & camera, std::shared_ptr<const DetectionThreshold> threshold);
+void publishDetectionThreshold(uint32_t cameraNo, std::shared_ptr<const DetectionThreshold> threshold);
+
+// Publish threshold only if expected is still the current version for camera. Returns false, publishing nothing,
+// when another version was published since expected was taken.
+bool replaceDetectionThreshold(CameraContext & camera, std::shared_ptr<const DetectionThreshold> expected,
+                               std::shared_ptr<const DetectionThreshold> threshold);
+
+#endif //UNTITLED_DETECTIONTHRESHOLD_H
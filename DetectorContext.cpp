@@ -0,0 +1,77 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "DetectorContext.h"
+#include <algorithm>
+#include <stdexcept>
+
+DetectorContext::DetectorContext(){
+    configure(SIZE_MAX);
+}
+
+DetectorContext::DetectorContext(const std::vector<std::string> & names){
+    configure(names);
+}
+
+void DetectorContext::configure(size_t maxCameras){
+    const std::vector<std::string> & names = cameraNames();
+    configure(std::vector<std::string>(names.begin(), names.begin() + std::min(maxCameras, names.size())));
+}
+
+void DetectorContext::configure(const std::vector<std::string> & names){
+    cameras.clear();
+    for(size_t i = 0; i < names.size(); i++){
+        std::unique_ptr<CameraContext> camera(new CameraContext());
+        camera->name = names[i];
+        camera->cameraNo = i;
+        camera->setGeometry(SensorGeometry());
+        cameras.push_back(std::move(camera));
+    }
+}
+
+void CameraContext::setGeometry(const SensorGeometry & newGeometry){
+    geometry = newGeometry;
+    aboveThresholdCount_h.assign(geometry.pixelsPerLine, 0);
+    columnMask.assign(columnMaskWords(geometry), 0);
+    for(std::vector<uint64_t> & mask : impactState.recentMasks) mask.assign(columnMaskWords(geometry), 0);
+    impactState.recent.assign(columnMaskWords(geometry), 0);
+    impactState.next = 0;
+    adaptiveBaseline.setGeometry(geometry);
+}
+
+CameraContext & DetectorContext::camera(uint32_t cameraNo){
+    if(cameraNo >= cameras.size()){
+        throw std::runtime_error("No Matching Camera Name.");
+    }
+    return *cameras[cameraNo];
+}
+
+CameraContext * DetectorContext::findCamera(const char * cameraName){
+    for(std::unique_ptr<CameraContext> & camera : cameras){
+        if(camera->name == cameraName) return camera.get();
+    }
+    return nullptr;
+}
+
+DetectorContext & detectorContext(){
+    static DetectorContext context;
+    return context;
+}
@@ -0,0 +1,130 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_DETECTORCONTEXT_H
+#define UNTITLED_DETECTORCONTEXT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AdaptiveBaseline.h"
+#include "BaselineData.h"
+#include "CameraConfiguration.h"
+#include "DetectionPipeline.h"
+#include "DetectionThreshold.h"
+#include "SpscRing.h"
+#include "columnSegmentation.h"
+
+// Frames a column must be clear before a run of blocked columns over it is reported as a new impact.
+// Stops an arrow that only blocks part of a frame from being reported twice.
+#define IMPACT_CLEAR_FRAMES 2
+
+// Columns blocked in a camera's last IMPACT_CLEAR_FRAMES frames. Each mask has columnMaskWords words.
+struct ImpactState
+{
+    std::vector<uint64_t> recentMasks[IMPACT_CLEAR_FRAMES];
+    // Columns blocked in any of the masks, worked out again for each frame.
+    std::vector<uint64_t> recent;
+    uint32_t next = 0;
+};
+
+// Everything detection keeps for one camera.
+// Apart from threshold and results, which are shared with the main loop, it's only used by the camera's grab thread
+// while grabbing. Each camera starts on its own cache line, so grab threads never write to a line another one uses.
+// The buffers sized by the camera's width are allocated separately by setGeometry.
+struct alignas(CACHE_LINE_BYTES) CameraContext
+{
+    // User defined name of the camera and its position in cameraNames.
+    std::string name;
+    uint32_t cameraNo;
+
+    // Size of the frames the camera sends. Set from the camera by useCameraGeometry before grabbing starts.
+    // Only change it with setGeometry.
+    SensorGeometry geometry;
+
+    // The baseline loaded at startup. Frames are measured against threshold, not this.
+    BaselineData * baseline_h = nullptr;
+
+    // The version of the baseline frames are measured against.
+    // Only accessed with std::atomic_load and std::atomic_store, so the grab thread never waits for a reload and
+    // a reload never waits for a frame. Use currentDetectionThreshold and publishDetectionThreshold.
+    std::shared_ptr<const DetectionThreshold> threshold;
+
+    // Counts the number of pixels below the threshold in each column of the frame being measured.
+    // (_d = GPU memory) (_h = host memory)
+    std::vector<uint32_t> aboveThresholdCount_h;
+    uint32_t * aboveThresholdCount_d = nullptr;
+
+    // Columns blocked in the frame being measured.
+    std::vector<uint64_t> columnMask;
+
+    // The frame being measured, copied to GPU memory for the aboveThresholdCalc kernel.
+    uint8_t * grabResult_d = nullptr;
+
+    // Follows slow changes in the light when LSAD_ADAPTIVE_BASELINE_FRAMES is set.
+    AdaptiveBaseline adaptiveBaseline;
+
+    // Columns blocked in recent frames, used by detectImpact.
+    ImpactState impactState;
+
+    // The measureFrame results waiting for the main loop, which pairs them by timestamp with a StereoCorrelator.
+    // The grab thread is the producer and the main loop is the consumer, so neither takes a lock.
+    DetectionRing results;
+
+    // Use frames of newGeometry, sizing the host buffers and the adaptive baseline for them and clearing
+    // the impact state. The GPU buffers are left to the caller. Must not be called while the camera is grabbing.
+    void setGeometry(const SensorGeometry & newGeometry);
+};
+
+// The cameras frames are measured for. The context the frame handlers use numbers its cameras in the order of
+// cameraNames, the same as the cameraNo the frame sources put in each frame. A lane's context numbers its own
+// cameras from 0 in the order they're named for the lane.
+class DetectorContext {
+private:
+    std::vector<std::unique_ptr<CameraContext>> cameras;
+public:
+    // Holds every camera in cameraNames.
+    DetectorContext();
+
+    // Holds the cameras in names. The cameras are allocated on the calling thread.
+    explicit DetectorContext(const std::vector<std::string> & names);
+
+    // Replace the cameras with the first maxCameras in cameraNames at the default geometry.
+    // Must be called before any frames are measured.
+    void configure(size_t maxCameras);
+
+    // Replace the cameras with the ones in names at the default geometry.
+    void configure(const std::vector<std::string> & names);
+
+    size_t cameraCount() const { return cameras.size(); }
+
+    // The camera numbered cameraNo. Throws if there's no such camera.
+    CameraContext & camera(uint32_t cameraNo);
+
+    // The camera named cameraName, or null when it isn't in this context.
+    CameraContext * findCamera(const char * cameraName);
+};
+
+// The context the frame handlers use.
+DetectorContext & detectorContext();
+
+#endif //UNTITLED_DETECTORCONTEXT_H
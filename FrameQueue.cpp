@@ -0,0 +1,71 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "FrameQueue.h"
+#include <cstring>
+
+FrameQueue::FrameQueue(size_t frameBytes, size_t capacity)
+    : frameBytes(frameBytes), capacity(capacity), slots(frameBytes * capacity){
+}
+
+void FrameQueue::push(const uint8_t * frame){
+    push(NULL, 0, frame);
+}
+
+void FrameQueue::push(const uint8_t * header, size_t headerBytes, const uint8_t * frame){
+    std::unique_lock<std::mutex> lk(m);
+    notFull.wait(lk, [this]{return count < capacity;});
+
+    // Only the producer writes to the slot after the head, so the copy can be done without the lock.
+    size_t slot = (head + count) % capacity;
+    lk.unlock();
+    uint8_t * slotData = slots.data() + slot*frameBytes;
+    if(headerBytes > 0) memcpy(slotData, header, headerBytes);
+    memcpy(slotData + headerBytes, frame, frameBytes - headerBytes);
+
+    lk.lock();
+    count++;
+    lk.unlock();
+    notEmpty.notify_one();
+}
+
+const uint8_t * FrameQueue::front(){
+    std::unique_lock<std::mutex> lk(m);
+    notEmpty.wait(lk, [this]{return count > 0 || closed;});
+    if(count == 0) return NULL;
+    return slots.data() + head*frameBytes;
+}
+
+void FrameQueue::pop(){
+    {
+        std::scoped_lock lk(m);
+        head = (head + 1) % capacity;
+        count--;
+    }
+    notFull.notify_one();
+}
+
+void FrameQueue::close(){
+    {
+        std::scoped_lock lk(m);
+        closed = true;
+    }
+    notEmpty.notify_all();
+}
@@ -0,0 +1,65 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef UNTITLED_FRAMEQUEUE_H
+#define UNTITLED_FRAMEQUEUE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Bounded queue of frames between one producer and one consumer thread.
+// Frames are copied into preallocated slots so the producer can release its buffer as soon as push returns.
+// Memory used is fixed at capacity frames no matter how many frames pass through the queue.
+class FrameQueue {
+private:
+    size_t frameBytes;
+    size_t capacity;
+    std::vector<uint8_t> slots;
+    size_t head = 0;
+    size_t count = 0;
+    bool closed = false;
+    std::mutex m;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+public:
+    FrameQueue(size_t frameBytes, size_t capacity);
+
+    // Copy a frame into the queue. Blocks while the queue is full.
+    void push(const uint8_t * frame);
+
+    // Copy headerBytes of header followed by the rest of a slot from frame into the queue.
+    // Used to queue a record without first building it in another buffer. Blocks while the queue is full.
+    void push(const uint8_t * header, size_t headerBytes, const uint8_t * frame);
+
+    // The oldest frame in the queue. Blocks until there is one.
+    // Returns NULL once the queue is closed and empty.
+    // The frame stays valid until pop is called.
+    const uint8_t * front();
+
+    // Remove the oldest frame from the queue.
+    void pop();
+
+    // No more frames will be pushed. Wakes the consumer once the remaining frames are taken.
+    void close();
+};
+
+#endif //UNTITLED_FRAMEQUEUE_H
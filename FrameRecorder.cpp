@@ -0,0 +1,161 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "FrameRecorder.h"
+#include "camerasettings.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// Bytes written to the file at a time by the stdio buffer.
+#define RECORDER_WRITE_BUFFER_BYTES (4 << 20)
+
+#define RECORD_FRAME_BYTES (PIXELS_PER_LINE*IMAGE_HEIGHT)
+#define RECORD_BYTES (sizeof(RecordingFrameHeader) + RECORD_FRAME_BYTES)
+
+FrameRecorder::FrameRecorder(const char * path)
+    : path(path), queue(RECORD_BYTES, RECORDER_QUEUE_FRAMES){
+    file = fopen(path, "wb");
+    if(file == NULL){
+        throw std::runtime_error(std::string("Couldn't create the recording file ") + path + ": " + strerror(errno));
+    }
+    setvbuf(file, NULL, _IOFBF, RECORDER_WRITE_BUFFER_BYTES);
+
+    RecordingFileHeader header = {};
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    header.version = RECORDING_VERSION;
+    header.pixelsPerLine = PIXELS_PER_LINE;
+    header.imageHeight = IMAGE_HEIGHT;
+    header.headerBytes = sizeof(RecordingFileHeader);
+    header.recordBytes = RECORD_BYTES;
+    if(fwrite(&header, sizeof(header), 1, file) != 1){
+        fclose(file);
+        throw std::runtime_error(std::string("Couldn't write to the recording file ") + path + ".");
+    }
+
+    writeThread = std::thread(&FrameRecorder::writeLoop, this);
+}
+
+FrameRecorder::~FrameRecorder(){
+    queue.close();
+    writeThread.join();
+    fclose(file);
+}
+
+void FrameRecorder::writeLoop(){
+    bool failed = false;
+    const uint8_t * record;
+    while((record = queue.front()) != NULL){
+        // Keep taking records after a failed write so the grab threads don't block on a full queue.
+        if(!failed && fwrite(record, RECORD_BYTES, 1, file) != 1){
+            std::cerr << "Couldn't write to the recording file " << path << ". No more frames will be recorded.\n";
+            failed = true;
+        }
+        queue.pop();
+    }
+    fflush(file);
+}
+
+void FrameRecorder::record(const Frame & frame){
+    RecordingFrameHeader header = {};
+    header.cameraNo = frame.cameraNo;
+    header.flags = (frame.hasCRC ? RECORDING_FLAG_HAS_CRC : 0) | (frame.crcPassed ? RECORDING_FLAG_CRC_PASSED : 0);
+    header.timestamp = frame.timestamp;
+    header.frameNumber = frame.frameNumber;
+    strncpy(header.cameraName, frame.cameraName, sizeof(header.cameraName) - 1);
+
+    std::scoped_lock lk(producerMutex);
+    queue.push((const uint8_t *) &header, sizeof(header), frame.buffer);
+    recordsQueued++;
+}
+
+uint64_t FrameRecorder::frames(){
+    std::scoped_lock lk(producerMutex);
+    return recordsQueued;
+}
+
+RecordingFrameSource::RecordingFrameSource(std::unique_ptr<FrameSource> source, std::shared_ptr<FrameRecorder> recorder)
+    : source(std::move(source)), recorder(std::move(recorder)){
+}
+
+RecordingFrameSource::~RecordingFrameSource(){
+    source->stopGrabbing();
+}
+
+const char * RecordingFrameSource::name(){
+    return source->name();
+}
+
+uint32_t RecordingFrameSource::cameraNo(){
+    return source->cameraNo();
+}
+
+SensorGeometry RecordingFrameSource::geometry(){
+    return source->geometry();
+}
+
+void RecordingFrameSource::setFrameHandler(FrameHandler handler){
+    // Record each frame before handing it on.
+    FrameRecorder * frameRecorder = recorder.get();
+    source->setFrameHandler([frameRecorder, handler](const Frame & frame){
+        frameRecorder->record(frame);
+        handler(frame);
+    });
+}
+
+void RecordingFrameSource::startGrabbing(uint64_t count){
+    source->startGrabbing(count);
+}
+
+void RecordingFrameSource::stopGrabbing(){
+    source->stopGrabbing();
+}
+
+bool RecordingFrameSource::isGrabbing(){
+    return source->isGrabbing();
+}
+
+bool RecordingFrameSource::retrieveFrame(Frame & frame, uint32_t timeoutMs){
+    if(!source->retrieveFrame(frame, timeoutMs)) return false;
+    recorder->record(frame);
+    return true;
+}
+
+void RecordingFrameSource::releaseFrame(){
+    source->releaseFrame();
+}
+
+bool RecordingFrameSource::waitForFrameTriggerReady(uint32_t timeoutMs){
+    return source->waitForFrameTriggerReady(timeoutMs);
+}
+
+void RecordingFrameSource::executeSoftwareTrigger(){
+    source->executeSoftwareTrigger();
+}
+
+bool RecordingFrameSource::readClock(uint64_t & ticks){
+    return source->readClock(ticks);
+}
+
+double RecordingFrameSource::frameRate(){
+    return source->frameRate();
+}
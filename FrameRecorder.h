@@ -0,0 +1,129 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_FRAMERECORDER_H
+#define UNTITLED_FRAMERECORDER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "FrameQueue.h"
+#include "FrameSource.h"
+
+// Environment variable naming a file to record every frame grabbed to.
+// Used by openFrameSources to wrap each source in a RecordingFrameSource.
+#define RECORD_FILE_ENV "LSAD_RECORD_FILE"
+
+// Recording file format.
+// A RecordingFileHeader followed by fixed size records, each a RecordingFrameHeader followed by the raw frame.
+// Both headers are 64 bytes so every frame in the file starts on a 64 byte boundary and can be used in place once mapped.
+// Records are only appended, so a recording cut short keeps every complete record.
+#define RECORDING_MAGIC "LSADREC"
+#define RECORDING_VERSION 1
+#define RECORDING_FLAG_HAS_CRC    1
+#define RECORDING_FLAG_CRC_PASSED 2
+
+struct RecordingFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pixelsPerLine;
+    uint32_t imageHeight;
+    uint32_t headerBytes;
+    // Size of a RecordingFrameHeader plus a frame.
+    uint64_t recordBytes;
+    uint8_t reserved[32];
+};
+
+struct RecordingFrameHeader
+{
+    uint32_t cameraNo;
+    uint32_t flags;
+    uint64_t timestamp;
+    uint64_t frameNumber;
+    char cameraName[32];
+    uint8_t reserved[8];
+};
+
+static_assert(sizeof(RecordingFileHeader) == 64, "RecordingFileHeader must be 64 bytes.");
+static_assert(sizeof(RecordingFrameHeader) == 64, "RecordingFrameHeader must be 64 bytes.");
+
+// Frames queued between the grab threads and the thread writing the file.
+#define RECORDER_QUEUE_FRAMES 64
+
+// Appends frames from any number of sources to a recording file.
+// record copies the frame into a queue and returns, a background thread writes the queue to the file,
+// so a grab thread only waits on the disk when the queue is full.
+class FrameRecorder {
+private:
+    FILE * file;
+    std::string path;
+    FrameQueue queue;
+    // FrameQueue takes one producer at a time.
+    std::mutex producerMutex;
+    std::thread writeThread;
+    uint64_t recordsQueued = 0;
+
+    // Body of writeThread.
+    void writeLoop();
+public:
+    // Create or truncate the file at path and write the file header. Throws if the file can't be created.
+    explicit FrameRecorder(const char * path);
+
+    // Writes the queued frames and closes the file.
+    ~FrameRecorder();
+
+    // Queue a frame to be appended to the file. Safe to call from several grab threads.
+    void record(const Frame & frame);
+
+    // Number of frames recorded.
+    uint64_t frames();
+};
+
+// Passes frames through from another source after recording them.
+class RecordingFrameSource : public FrameSource {
+private:
+    std::unique_ptr<FrameSource> source;
+    std::shared_ptr<FrameRecorder> recorder;
+public:
+    RecordingFrameSource(std::unique_ptr<FrameSource> source, std::shared_ptr<FrameRecorder> recorder);
+    // Stops the wrapped source's grab thread before the recorder it hands frames to can be closed.
+    ~RecordingFrameSource() override;
+
+    const char * name() override;
+    uint32_t cameraNo() override;
+    SensorGeometry geometry() override;
+    void setFrameHandler(FrameHandler handler) override;
+    void startGrabbing(uint64_t count = 0) override;
+    void stopGrabbing() override;
+    bool isGrabbing() override;
+    bool retrieveFrame(Frame & frame, uint32_t timeoutMs) override;
+    void releaseFrame() override;
+    bool waitForFrameTriggerReady(uint32_t timeoutMs) override;
+    void executeSoftwareTrigger() override;
+    bool readClock(uint64_t & ticks) override;
+    double frameRate() override;
+};
+
+#endif //UNTITLED_FRAMERECORDER_H
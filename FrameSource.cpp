@@ -0,0 +1,107 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "FrameSource.h"
+#include "FrameRecorder.h"
+#include "ReplayFrameSource.h"
+#include "SyntheticFrameSource.h"
+#include "camerasettings.h"
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#ifdef LSAD_USE_PYLON
+#include "PylonFrameSource.h"
+#endif
+
+void frameSourcesInitialize(){
+#ifdef LSAD_USE_PYLON
+    // Before using any pylon methods, the pylon runtime must be initialized.
+    Pylon::PylonInitialize();
+#endif
+}
+
+void frameSourcesTerminate(){
+#ifdef LSAD_USE_PYLON
+    // Releases all pylon resources.
+    Pylon::PylonTerminate();
+#endif
+}
+
+std::future<std::vector<std::unique_ptr<FrameSource>>> openFrameSourcesAsync(AcquisitionMode mode, size_t maxSources){
+    return std::async(std::launch::async, [mode, maxSources]{
+        frameSourcesInitialize();
+        return openFrameSources(mode, maxSources);
+    });
+}
+
+std::vector<std::unique_ptr<FrameSource>> openFrameSources(AcquisitionMode mode, size_t maxSources){
+#ifdef LSAD_USE_PYLON
+    const char * sourceType = "pylon";
+#else
+    const char * sourceType = "synthetic";
+#endif
+    const char * requested = getenv(FRAME_SOURCE_ENV);
+    if(requested != NULL && requested[0] != '\0') sourceType = requested;
+
+    std::vector<std::unique_ptr<FrameSource>> sources;
+    if(strcmp(sourceType, "synthetic") == 0){
+        // One synthetic camera for each camera name.
+        SyntheticSettings settings = syntheticSettingsFromEnvironment();
+        const std::vector<std::string> & names = cameraNames();
+        for(uint32_t i = 0; i < names.size() && i < maxSources; i++){
+            SyntheticFrameSource * source = new SyntheticFrameSource(names[i].c_str(), i, mode, settings);
+            double arrow = syntheticArrowFromEnvironment(i);
+            if(arrow >= 0) source->setArrow(arrow, 6);
+            sources.emplace_back(source);
+        }
+    }
+    else if(strcmp(sourceType, "replay") == 0){
+        sources = openReplayFrameSources(mode, maxSources);
+    }
+#ifdef LSAD_USE_PYLON
+    else if(strcmp(sourceType, "pylon") == 0){
+        sources = openPylonFrameSources(mode, maxSources);
+    }
+#endif
+    else{
+        throw std::runtime_error(std::string("Unknown frame source in " FRAME_SOURCE_ENV ": ") + sourceType);
+    }
+
+    if(sources.empty()){
+        throw std::runtime_error("No camera present.");
+    }
+    std::cout << "Opened " << sources.size() << " " << sourceType << " frame source(s).\n";
+
+    // Record the raw frames from every source to one file.
+    const char * recordFile = getenv(RECORD_FILE_ENV);
+    if(recordFile != NULL && recordFile[0] != '\0'){
+        std::shared_ptr<FrameRecorder> recorder = std::make_shared<FrameRecorder>(recordFile);
+        for(std::unique_ptr<FrameSource> & source : sources){
+            if(source->geometry() != SensorGeometry()){
+                throw std::runtime_error(std::string("Only frames of PIXELS_PER_LINE x IMAGE_HEIGHT can be recorded. ")
+                                         + source->name() + " sends other frames.");
+            }
+            source.reset(new RecordingFrameSource(std::move(source), recorder));
+        }
+        std::cout << "Recording frames to " << recordFile << ".\n";
+    }
+    return sources;
+}
@@ -0,0 +1,130 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_FRAMESOURCE_H
+#define UNTITLED_FRAMESOURCE_H
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CameraConfiguration.h"
+
+// Environment variable choosing where frames come from.
+// "pylon" uses the attached Basler cameras, "synthetic" uses a SyntheticFrameSource for each camera
+// and "replay" plays back a recording made with LSAD_RECORD_FILE.
+// Defaults to pylon when built with Pylon and synthetic otherwise.
+#define FRAME_SOURCE_ENV "LSAD_FRAME_SOURCE"
+
+// A frame of the source's geometry() and the chunk data grabbed with it.
+// buffer belongs to the FrameSource and is only valid while the frame handler runs,
+// or until the next retrieveFrame or releaseFrame call.
+struct Frame
+{
+    const uint8_t * buffer;
+    // The camera's position in cameraNames, or a number past them for other names.
+    uint32_t cameraNo;
+    const char * cameraName;
+    // Chunk timestamp in camera ticks (TIMESTAMP_TICKS_PER_SECOND).
+    uint64_t timestamp;
+    // Number of frames grabbed since grabbing started, starting from 1.
+    uint64_t frameNumber;
+    bool hasCRC;
+    bool crcPassed;
+};
+
+// Called on the source's grab thread for every frame grabbed.
+typedef std::function<void(const Frame &)> FrameHandler;
+
+// How a source acquires frames.
+// SoftwareTrigger grabs one frame per executeSoftwareTrigger call. Used for training and testing a calibration.
+// Continuous grabs frames at the source's frame rate. Used for collecting the baseline.
+enum class AcquisitionMode
+{
+    SoftwareTrigger,
+    Continuous
+};
+
+// A camera, or anything else producing frames like a camera.
+// Frames are either delivered to a FrameHandler on the source's own thread,
+// or pulled with retrieveFrame when no handler is set.
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    // User defined name of the camera.
+    virtual const char * name() = 0;
+
+    // Camera number put in each frame.
+    virtual uint32_t cameraNo() = 0;
+
+    // Size of the frames grabbed.
+    virtual SensorGeometry geometry(){ return SensorGeometry(); }
+
+    // Deliver frames to handler on the source's thread. Must be called before startGrabbing.
+    virtual void setFrameHandler(FrameHandler handler) = 0;
+
+    // Start grabbing. Grabbing stops after count frames, or continues until stopGrabbing when count is 0.
+    virtual void startGrabbing(uint64_t count = 0) = 0;
+
+    // Stop grabbing and release any frame being held.
+    virtual void stopGrabbing() = 0;
+
+    // True until count frames are grabbed or stopGrabbing is called.
+    virtual bool isGrabbing() = 0;
+
+    // Wait for the next frame when no handler is set. Throws if none arrives within timeoutMs.
+    // Returns false when grabbing has finished.
+    virtual bool retrieveFrame(Frame & frame, uint32_t timeoutMs) = 0;
+
+    // Let the source reuse the buffer of the last frame retrieved.
+    virtual void releaseFrame() = 0;
+
+    // Wait up to timeoutMs for the source to accept a software trigger. Throws on timeout.
+    virtual bool waitForFrameTriggerReady(uint32_t timeoutMs) = 0;
+
+    // Grab one frame in SoftwareTrigger mode.
+    virtual void executeSoftwareTrigger() = 0;
+
+    // Read the clock used for chunk timestamps, in TIMESTAMP_TICKS_PER_SECOND ticks.
+    // Returns false when the source has no clock to read. Used to line up the timestamps of different cameras.
+    virtual bool readClock(uint64_t & ticks){ return false; }
+
+    // Frames per second grabbed in Continuous mode, or 0 when it isn't known.
+    virtual double frameRate(){ return 0; }
+};
+
+// Must be called before openFrameSources and after the sources are destroyed.
+// Initializes and releases the pylon runtime when built with Pylon.
+void frameSourcesInitialize();
+void frameSourcesTerminate();
+
+// Open up to maxSources sources using FRAME_SOURCE_ENV, set up for mode.
+// Sources named in cameraNames are put first in that order. Throws if there are none.
+std::vector<std::unique_ptr<FrameSource>> openFrameSources(AcquisitionMode mode, size_t maxSources);
+
+// Call frameSourcesInitialize and openFrameSources on another thread, so finding and opening the cameras overlaps
+// the rest of startup. get() on the result throws anything they throw. frameSourcesTerminate is still called at exit.
+std::future<std::vector<std::unique_ptr<FrameSource>>> openFrameSourcesAsync(AcquisitionMode mode, size_t maxSources);
+
+#endif //UNTITLED_FRAMESOURCE_H
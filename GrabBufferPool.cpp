@@ -0,0 +1,88 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "GrabBufferPool.h"
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#ifdef LSAD_USE_HIP
+#include "hip/hip_runtime.h"
+#endif
+
+GrabBufferPool::GrabBufferPool(size_t bufferBytes, size_t count) : count(count){
+    stride = (bufferBytes + GRAB_BUFFER_ALIGNMENT - 1) / GRAB_BUFFER_ALIGNMENT * GRAB_BUFFER_ALIGNMENT;
+    memoryBytes = (stride * count + GRAB_HUGE_PAGE_BYTES - 1) / GRAB_HUGE_PAGE_BYTES * GRAB_HUGE_PAGE_BYTES;
+
+    // Reserved huge pages only exist when they're set aside in /proc/sys/vm/nr_hugepages.
+    void * mapping = mmap(NULL, memoryBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    reservedHugePages = mapping != MAP_FAILED;
+    if(!reservedHugePages){
+        // Map an extra huge page and trim it, so the pool starts on a huge page boundary the kernel can back with one.
+        mapping = mmap(NULL, memoryBytes + GRAB_HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mapping == MAP_FAILED){
+            throw std::runtime_error(std::string("Couldn't allocate grab buffers: ") + strerror(errno));
+        }
+        uintptr_t start = (uintptr_t) mapping;
+        uintptr_t aligned = (start + GRAB_HUGE_PAGE_BYTES - 1) / GRAB_HUGE_PAGE_BYTES * GRAB_HUGE_PAGE_BYTES;
+        if(aligned > start) munmap(mapping, aligned - start);
+        munmap((void *) (aligned + memoryBytes), start + GRAB_HUGE_PAGE_BYTES - aligned);
+        mapping = (void *) aligned;
+        madvise(mapping, memoryBytes, MADV_HUGEPAGE);
+    }
+    memory = (uint8_t *) mapping;
+
+    // Fault every page in now instead of on the first frames.
+    memset(memory, 0, memoryBytes);
+
+#ifdef LSAD_USE_HIP
+    // Without a GPU the buffers still work for the CPU backends, and copies go through a staging buffer.
+    registered = hipHostRegister(memory, memoryBytes, hipHostRegisterDefault) == hipSuccess;
+    if(!registered){
+        (void) hipGetLastError();
+        std::cerr << "Couldn't register the grab buffers with the GPU. Frames will be copied through a staging buffer." << std::endl;
+    }
+#endif
+
+    // Handed out from the start of the pool first.
+    for(size_t i = count; i > 0; i--) freeBuffers.push_back(memory + (i - 1) * stride);
+}
+
+GrabBufferPool::~GrabBufferPool(){
+#ifdef LSAD_USE_HIP
+    if(registered) hipHostUnregister(memory);
+#endif
+    munmap(memory, memoryBytes);
+}
+
+uint8_t * GrabBufferPool::acquire(){
+    std::lock_guard<std::mutex> lock(mutex);
+    if(freeBuffers.empty()) return nullptr;
+    uint8_t * buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    return buffer;
+}
+
+void GrabBufferPool::release(uint8_t * buffer){
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBuffers.push_back(buffer);
+}
@@ -0,0 +1,79 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+#ifndef UNTITLED_GRABBUFFERPOOL_H
+#define UNTITLED_GRABBUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Every grab buffer starts on a cache line, so the SIMD backends' loads never split one.
+#define GRAB_BUFFER_ALIGNMENT 64
+
+// Pools are allocated in whole huge pages.
+#define GRAB_HUGE_PAGE_BYTES (2 << 20)
+
+// A fixed set of grab buffers allocated once from huge pages, so frames are written where they're measured and
+// reading a frame doesn't walk through a TLB entry per 4 KB page. Explicitly reserved huge pages are used when there
+// are enough of them, and transparent huge pages otherwise. Every page is touched when the pool is created, so the
+// memory is local to the creating thread's NUMA node and grabbing never faults.
+// On GPU builds the pool is registered with the HIP runtime, so copying a frame to the GPU is one DMA transfer
+// instead of going through a staging buffer.
+class GrabBufferPool {
+private:
+    uint8_t * memory = nullptr;
+    size_t memoryBytes = 0;
+    size_t stride;
+    size_t count;
+    bool reservedHugePages = false;
+    bool registered = false;
+
+    std::mutex mutex;
+    std::vector<uint8_t *> freeBuffers;
+public:
+    // count buffers of at least bufferBytes each. Throws if the memory can't be allocated.
+    GrabBufferPool(size_t bufferBytes, size_t count);
+    ~GrabBufferPool();
+
+    GrabBufferPool(const GrabBufferPool &) = delete;
+    GrabBufferPool & operator=(const GrabBufferPool &) = delete;
+
+    // Take a free buffer, or null when every buffer is in use. Safe to call from any thread.
+    uint8_t * acquire();
+
+    // Give back a buffer taken with acquire.
+    void release(uint8_t * buffer);
+
+    // Usable bytes in each buffer, bufferBytes rounded up to GRAB_BUFFER_ALIGNMENT.
+    size_t bufferBytes() const { return stride; }
+    size_t bufferCount() const { return count; }
+
+    // True when the pool is in reserved huge pages rather than transparent ones.
+    bool hugePages() const { return reservedHugePages; }
+
+    // True when the pool is registered with the HIP runtime for DMA.
+    bool hostRegistered() const { return registered; }
+};
+
+#endif //UNTITLED_GRABBUFFERPOOL_H
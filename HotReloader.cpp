@@ -0,0 +1,177 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "HotReloader.h"
+#include "BaselineData.h"
+#include "CameraConfiguration.h"
+#include "DetectionThreshold.h"
+#include "DetectorContext.h"
+#include "camerasettings.h"
+#include "filenames.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+using std::cout, std::endl, std::cerr;
+
+uint32_t reloadIntervalFromEnvironment(){
+    const char * value = getenv(RELOAD_INTERVAL_ENV);
+    if(value == NULL) return RELOAD_INTERVAL_DEFAULT_MS;
+    return (uint32_t) strtoul(value, NULL, 10);
+}
+
+// Changes whenever another connection commits to the database, whichever table was written.
+static int dataVersion(sqlite3 * db){
+    sqlite3_stmt *stmt;
+    SQLite3_CHECK(sqlite3_prepare_v2(db,"PRAGMA data_version;",-1,&stmt,NULL),db);
+    SQLite3_CHECK(sqlite3_step(stmt),db);
+    int version = sqlite3_column_int(stmt,0);
+    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+    return version;
+}
+
+HotReloader::HotReloader(DetectorContext & context, const char * filename,
+                         std::shared_ptr<ScreenPositionEstimator> estimator,
+                         std::shared_ptr<const SensorFusionEstimator> fusion, uint32_t lookupStride, uint32_t intervalMs)
+        : context(context), filename(filename), lookupStride(lookupStride), intervalMs(intervalMs),
+          currentEstimator(std::move(estimator)), currentFusion(std::move(fusion)) {
+    // The baselines in use may have been chosen from older ones. Only a baseline written from now on replaces them.
+    for(uint32_t i = 0; i < context.cameraCount(); i++){
+        baselineTimes.push_back(latestBaselineTime(filename, context.camera(i).name.c_str()));
+    }
+    if(currentEstimator) coefficientsTime = currentEstimator->coefficientsTime();
+    if(currentFusion) sensorLinesTime = currentFusion->linesTime();
+    thread = std::thread(&HotReloader::run, this);
+}
+
+HotReloader::~HotReloader(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+std::shared_ptr<ScreenPositionEstimator> HotReloader::estimator() const {
+    return std::atomic_load(&currentEstimator);
+}
+
+std::shared_ptr<const SensorFusionEstimator> HotReloader::fusionEstimator() const {
+    return std::atomic_load(&currentFusion);
+}
+
+void HotReloader::requestReload(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reloadRequested = true;
+    }
+    wake.notify_one();
+}
+
+void HotReloader::run(){
+    // A separate connection from the DatabaseService, kept open so data_version can be compared between checks.
+    // data_version only counts commits from other connections, including the service's.
+    sqlite3 *db;
+    SQLite3_CHECK(sqlite3_open(filename.c_str(), &db),db);
+    SQLite3_CHECK(sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS),db);
+    int lastVersion = dataVersion(db);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+        auto woken = [this]{ return stopping || reloadRequested; };
+        if(intervalMs > 0) wake.wait_for(lock, std::chrono::milliseconds(intervalMs), woken);
+        else wake.wait(lock, woken);
+        if(stopping) break;
+        bool forced = reloadRequested;
+        reloadRequested = false;
+
+        // Detection keeps running on the old versions while the new ones are loaded.
+        lock.unlock();
+        int version = dataVersion(db);
+        if(forced || version != lastVersion){
+            lastVersion = version;
+            reload(forced);
+        }
+        lock.lock();
+    }
+
+    SQLite3_CHECK(sqlite3_close(db),db);
+}
+
+void HotReloader::reload(bool forced){
+    for(uint32_t i = 0; i < baselineTimes.size(); i++){
+        CameraContext & camera = context.camera(i);
+        const char * cameraName = camera.name.c_str();
+        std::string newest = latestBaselineTime(filename.c_str(), cameraName);
+        if(newest.empty() || (!forced && newest == baselineTimes[i])) continue;
+
+        BaselineData * baseline;
+        initBaselineData_h(baseline, CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
+        readBaselineFromDB(baseline, filename.c_str(), cameraName, newest);
+        baselineTimes[i] = newest;
+        // The grab thread measures every column of the camera's frames against the threshold.
+        if(baseline->pixelsPerLine() < camera.geometry.pixelsPerLine){
+            cerr << cameraName << ": The baseline collected " << newest << " is " << baseline->pixelsPerLine()
+                 << " pixels wide, but the camera sends " << camera.geometry.pixelsPerLine << ". Not using it." << endl;
+            delete baseline;
+            continue;
+        }
+        publishDetectionThreshold(camera, makeDetectionThreshold(baseline, newest));
+        delete baseline;
+        cout << cameraName << ": Reloaded the baseline collected " << newest << "." << endl;
+    }
+
+    // Only the sensor lines being used are followed.
+    if(std::atomic_load(&currentFusion)){
+        std::string newest = latestSensorLinesTime(filename.c_str());
+        if(!newest.empty() && (forced || newest != sensorLinesTime)){
+            // Lines for other cameras keep the ones in use.
+            std::shared_ptr<SensorFusionEstimator> fusion = std::make_shared<SensorFusionEstimator>();
+            sensorLinesTime = newest;
+            std::vector<std::string> names;
+            for(uint32_t i = 0; i < context.cameraCount(); i++) names.push_back(context.camera(i).name);
+            try{
+                fusion->loadSensorLines(filename.c_str(), names);
+                std::atomic_store(&currentFusion, std::shared_ptr<const SensorFusionEstimator>(fusion));
+                cout << "Reloaded the sensor lines created " << sensorLinesTime << "." << endl;
+            }
+            catch(const std::runtime_error & e){
+                cerr << e.what() << endl;
+            }
+        }
+    }
+
+    // Only the coefficients being used are followed.
+    if(!std::atomic_load(&currentEstimator)) return;
+    std::string newest = latestCoefficientsTime(filename.c_str());
+    if(newest.empty() || (!forced && newest == coefficientsTime)) return;
+
+    // The lookup table is built here rather than on the main loop.
+    std::shared_ptr<ScreenPositionEstimator> estimator = std::make_shared<ScreenPositionEstimator>();
+    estimator->useLookupTable(lookupStride);
+    estimator->loadCoefficients(filename.c_str());
+    coefficientsTime = estimator->coefficientsTime();
+    std::atomic_store(&currentEstimator, estimator);
+    cout << "Reloaded the coefficients created " << coefficientsTime << "." << endl;
+}
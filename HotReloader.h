@@ -0,0 +1,104 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_HOTRELOADER_H
+#define UNTITLED_HOTRELOADER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ScreenPositionEstimator.h"
+#include "SensorFusion.h"
+
+class DetectorContext;
+
+// Environment variable. Milliseconds between checks of the database for a new baseline or coefficients.
+// 0 only reloads when asked to with HotReloader::requestReload.
+#define RELOAD_INTERVAL_ENV "LSAD_RELOAD_INTERVAL_MS"
+#define RELOAD_INTERVAL_DEFAULT_MS 1000
+
+// Interval from RELOAD_INTERVAL_ENV, or RELOAD_INTERVAL_DEFAULT_MS when it isn't set.
+uint32_t reloadIntervalFromEnvironment();
+
+// Picks up baselines and coefficients written to the database while detection is running, so a new baseline or
+// calibration doesn't need the program restarted and the cameras opened again.
+// New versions are loaded on the reloader's own thread, including building the position lookup table, and then
+// swapped in. Nothing waits for a reload: a frame or event already being processed finishes with the old version
+// and the next one uses the new version.
+class HotReloader {
+private:
+    DetectorContext & context;
+    std::string filename;
+    uint32_t lookupStride;
+    uint32_t intervalMs;
+
+    // Newest versions seen in the database, with a baseline time for each camera in context.
+    // A version is only loaded when a newer one is written.
+    std::vector<std::string> baselineTimes;
+    std::string coefficientsTime;
+    std::string sensorLinesTime;
+
+    // Only accessed with std::atomic_load and std::atomic_store.
+    // Null when positions aren't estimated from the coefficients.
+    std::shared_ptr<ScreenPositionEstimator> currentEstimator;
+    // Null when positions aren't estimated from the sensor lines.
+    std::shared_ptr<const SensorFusionEstimator> currentFusion;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool reloadRequested = false;
+    std::thread thread;
+
+    // Wait for the database to change or a request and reload.
+    void run();
+
+    // Load the versions newer than the ones in use, or the newest of each when forced.
+    void reload(bool forced);
+public:
+    // Follows the baselines of the cameras in context, which must outlive the reloader.
+    // estimator is the one in use, loaded from filename after useLookupTable(lookupStride), or null when the
+    // coefficients aren't used. fusion is the sensor lines in use, loaded from filename for the cameras in context,
+    // or null when they aren't used. The thresholds in use are the ones published by loadBaseline.
+    // Start it after useCameraGeometry. Reloaded baselines are checked against the cameras' widths, which aren't
+    // changed again while it runs.
+    HotReloader(DetectorContext & context, const char * filename, std::shared_ptr<ScreenPositionEstimator> estimator,
+                std::shared_ptr<const SensorFusionEstimator> fusion, uint32_t lookupStride, uint32_t intervalMs);
+    ~HotReloader();
+
+    HotReloader(const HotReloader &) = delete;
+    HotReloader & operator=(const HotReloader &) = delete;
+
+    // The estimator to use for the next event, or null when it isn't used. Keep the pointer until the event is finished.
+    std::shared_ptr<ScreenPositionEstimator> estimator() const;
+
+    // The sensor lines to use for the next event, or null when they aren't used. Keep the pointer until the event is finished.
+    std::shared_ptr<const SensorFusionEstimator> fusionEstimator() const;
+
+    // Load the newest baseline, coefficients and sensor lines even if they're already in use. Doesn't wait for the reload.
+    void requestReload();
+};
+
+#endif //UNTITLED_HOTRELOADER_H
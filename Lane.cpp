@@ -0,0 +1,206 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "Lane.h"
+#include "cameraEvent.h"
+#include "filenames.h"
+#include "setupCleanupFunctions.h"
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+using std::cerr, std::endl;
+
+// Split value at each separator, keeping empty parts so lanes line up with their CPUs.
+static std::vector<std::string> split(const std::string & value, char separator){
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while(true){
+        size_t end = value.find(separator, start);
+        parts.push_back(value.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if(end == std::string::npos) return parts;
+        start = end + 1;
+    }
+}
+
+// Read CPUs written as numbers and ranges separated by commas, e.g. "2,3" or "4-7".
+static std::vector<uint32_t> parseCpus(const std::string & value){
+    std::vector<uint32_t> cpus;
+    for(const std::string & part : split(value, ',')){
+        if(part.empty()) continue;
+        char * end;
+        unsigned long first = strtoul(part.c_str(), &end, 10);
+        unsigned long last = first;
+        if(*end == '-') last = strtoul(end + 1, &end, 10);
+        if(end == part.c_str() || *end != '\0' || last < first){
+            throw std::runtime_error(std::string("Can't read CPUs \"") + part + "\" in " + LANE_CPUS_ENV + ".");
+        }
+        for(unsigned long cpu = first; cpu <= last; cpu++) cpus.push_back((uint32_t) cpu);
+    }
+    return cpus;
+}
+
+std::vector<LaneSettings> lanesFromEnvironment(){
+    std::vector<LaneSettings> lanes;
+    const char * value = getenv(LANES_ENV);
+    if(value == NULL) return lanes;
+
+    std::vector<std::string> usedNames;
+    for(const std::string & laneNames : split(value, ';')){
+        LaneSettings lane;
+        for(const std::string & name : split(laneNames, ',')){
+            if(name.empty()) continue;
+            if(std::find(usedNames.begin(), usedNames.end(), name) != usedNames.end()){
+                throw std::runtime_error(name + " is in more than one lane in " + LANES_ENV + ".");
+            }
+            usedNames.push_back(name);
+            lane.cameraNames.push_back(name);
+        }
+        if(lane.cameraNames.size() != 2){
+            throw std::runtime_error(std::string("Each lane in ") + LANES_ENV + " needs two cameras. \"" + laneNames
+                                     + "\" has " + std::to_string(lane.cameraNames.size()) + ".");
+        }
+        lanes.push_back(lane);
+    }
+
+    const char * cpus = getenv(LANE_CPUS_ENV);
+    if(cpus != NULL){
+        std::vector<std::string> laneCpus = split(cpus, ';');
+        for(size_t i = 0; i < laneCpus.size() && i < lanes.size(); i++) lanes[i].cpus = parseCpus(laneCpus[i]);
+    }
+    return lanes;
+}
+
+bool pinCurrentThread(const std::vector<uint32_t> & cpus){
+    if(cpus.empty()) return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(uint32_t cpu : cpus){
+        if(cpu >= CPU_SETSIZE) return false;
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+template <typename Task> void Lane::runPinned(Task task){
+    std::exception_ptr error;
+    std::thread thread([&]{
+        if(!pinCurrentThread(settings.cpus)){
+            cerr << "Lane " << laneNo << ": Couldn't run on the CPUs in " << LANE_CPUS_ENV << "." << endl;
+        }
+        try{
+            task();
+        }
+        catch(...){
+            error = std::current_exception();
+        }
+    });
+    thread.join();
+    if(error) std::rethrow_exception(error);
+}
+
+Lane::Lane(uint32_t laneNo, const LaneSettings & settings) : laneNo(laneNo), settings(settings){
+    // Positions are estimated from the lines of the lane's own cameras, numbered the same as in the lane.
+    startupFusion = std::make_shared<SensorFusionEstimator>();
+    startupFusion->loadSensorLines(DB_FILENAME, settings.cameraNames);
+    if(!startupFusion->calibrated(0) || !startupFusion->calibrated(1)){
+        throw std::runtime_error("Lane " + std::to_string(laneNo) + ": The sensor lines for "
+                                 + settings.cameraNames[0] + " and " + settings.cameraNames[1] + " haven't been fitted.");
+    }
+
+    // The cameras' buffers and baselines are first written on the lane's CPUs, which puts them in memory local to them.
+    runPinned([this]{
+        context.reset(new DetectorContext(this->settings.cameraNames));
+        hostSetup(*context);
+        loadLatestBaseline(*context);
+        deviceSetup(*context);
+    });
+}
+
+Lane::~Lane(){
+    // The reloader is stopped before the thresholds it publishes are released.
+    reloader.reset();
+    hostCleanup(*context);
+    deviceCleanup(*context);
+}
+
+void Lane::attach(const std::vector<std::unique_ptr<FrameSource>> & sources, const StereoSettings & stereoSettings){
+    for(uint32_t i = 0; i < 2; i++){
+        for(const std::unique_ptr<FrameSource> & source : sources){
+            if(settings.cameraNames[i] == source->name()) cameras[i] = source.get();
+        }
+        if(cameras[i] == nullptr){
+            throw std::runtime_error("Lane " + std::to_string(laneNo) + ": " + settings.cameraNames[i] + " wasn't found.");
+        }
+    }
+
+    // Measure each camera's frames at the size it sends them.
+    runPinned([&]{ useCameraGeometry(*context, sources); });
+
+    // A reloaded baseline is checked against the cameras' widths, so the reloader only starts once they're set.
+    // The lane doesn't use the coefficients, which are only fitted for one pair of cameras.
+    reloader.reset(new HotReloader(*context, DB_FILENAME, nullptr, startupFusion, 0, reloadIntervalFromEnvironment()));
+    startupFusion.reset();
+
+    // Free running cameras aren't synchronized, so an impact can start up to a frame apart in the two cameras.
+    StereoSettings laneSettings = stereoSettings;
+    for(uint32_t i = 0; i < 2; i++){
+        double frameRate = cameras[i]->frameRate();
+        if(frameRate > 0) laneSettings.windowUs = std::max(laneSettings.windowUs, 1000000 / frameRate);
+    }
+    correlator.reset(new StereoCorrelator(laneSettings));
+    calibrateClockOffsets(cameras, *correlator);
+
+    for(uint32_t i = 0; i < 2; i++){
+        // The source starts its own grab thread, so the thread moves to the lane's CPUs with its first frame.
+        CameraContext & camera = context->camera(i);
+        std::vector<uint32_t> cpus = settings.cpus;
+        cameras[i]->setFrameHandler([&camera, cpus](const Frame & frame){
+            static thread_local bool pinned = false;
+            if(!pinned){
+                pinCurrentThread(cpus);
+                pinned = true;
+            }
+            detectImpactInCamera(camera, frame);
+        });
+    }
+}
+
+void Lane::startGrabbing(){
+    for(FrameSource * camera : cameras) camera->startGrabbing();
+}
+
+void Lane::stopGrabbing(){
+    for(FrameSource * camera : cameras) camera->stopGrabbing();
+}
+
+bool Lane::isGrabbing(){
+    return cameras[0]->isGrabbing() && cameras[1]->isGrabbing();
+}
+
+bool Lane::poll(StereoEvent & event){
+    return pollStereoEvent(*context, *correlator, event);
+}
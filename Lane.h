@@ -0,0 +1,107 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+#ifndef UNTITLED_LANE_H
+#define UNTITLED_LANE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "DetectorContext.h"
+#include "FrameSource.h"
+#include "HotReloader.h"
+#include "SensorFusion.h"
+#include "StereoCorrelator.h"
+
+// Environment variable listing the CPUs each lane's grab threads run on, with lanes separated by semicolons in the
+// same order as LANES_ENV, e.g. "2,3;4-5". A lane without CPUs listed runs wherever the scheduler puts it.
+#define LANE_CPUS_ENV "LSAD_LANE_CPUS"
+
+// The cameras a lane pairs and the CPUs it runs on.
+struct LaneSettings
+{
+    std::vector<std::string> cameraNames;
+    std::vector<uint32_t> cpus;
+};
+
+// Lanes from LANES_ENV and LANE_CPUS_ENV. Throws when a lane doesn't name two cameras, a camera is in two lanes,
+// or the CPUs can't be read.
+std::vector<LaneSettings> lanesFromEnvironment();
+
+// Run the calling thread on cpus only. Does nothing when cpus is empty. Returns false when the CPUs can't be used.
+bool pinCurrentThread(const std::vector<uint32_t> & cpus);
+
+// One screen with its own pair of cameras, baselines and sensor lines, served alongside other lanes by one process.
+// The lane's detection state is allocated on a thread pinned to its CPUs, so it's in memory local to them, and its
+// cameras' grab threads are pinned to the same CPUs. The detection backend, database writer and shot journal are
+// shared by all lanes.
+class Lane {
+private:
+    uint32_t laneNo;
+    LaneSettings settings;
+    std::unique_ptr<DetectorContext> context;
+    FrameSource * cameras[2] = {nullptr, nullptr};
+    std::unique_ptr<StereoCorrelator> correlator;
+    // The sensor lines loaded by the constructor, handed to the reloader when it's started by attach.
+    std::shared_ptr<SensorFusionEstimator> startupFusion;
+    std::unique_ptr<HotReloader> reloader;
+
+    // Run task on a thread pinned to the lane's CPUs and wait for it. Rethrows anything it throws.
+    template <typename Task> void runPinned(Task task);
+public:
+    // Allocate the lane's cameras and load their newest baselines and sensor lines from the database without asking.
+    // Throws if the sensor lines for the lane's cameras haven't been fitted.
+    Lane(uint32_t laneNo, const LaneSettings & settings);
+    // Stops the reloader and releases the thresholds. The cameras must have stopped grabbing.
+    ~Lane();
+
+    Lane(const Lane &) = delete;
+    Lane & operator=(const Lane &) = delete;
+
+    uint32_t number() const { return laneNo; }
+    DetectorContext & detector() { return *context; }
+
+    // Take the lane's cameras from sources, measure their frames at the size they send them and deliver them to
+    // detectImpact. Starts reloading baselines and sensor lines once the sizes are set. Throws when one of them
+    // isn't in sources.
+    void attach(const std::vector<std::unique_ptr<FrameSource>> & sources, const StereoSettings & stereoSettings);
+
+    // Start free running both cameras.
+    void startGrabbing();
+    void stopGrabbing();
+    bool isGrabbing();
+
+    // The lane's camera numbered cameraNo. Only valid after attach.
+    FrameSource & camera(uint32_t cameraNo) { return *cameras[cameraNo]; }
+
+    // Take the lane's next event. Doesn't wait.
+    bool poll(StereoEvent & event);
+
+    // The sensor lines to use for the next event. Keep the pointer until the event is finished. Only valid after attach.
+    std::shared_ptr<const SensorFusionEstimator> fusionEstimator() const { return reloader->fusionEstimator(); }
+
+    // Load the newest baselines and sensor lines even if they're already in use. Only valid after attach.
+    void requestReload() { reloader->requestReload(); }
+};
+
+#endif //UNTITLED_LANE_H
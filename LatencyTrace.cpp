@@ -0,0 +1,250 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "LatencyTrace.h"
+
+#ifdef LSAD_TRACING
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "SpscRing.h"
+
+using std::cerr, std::endl;
+
+// Stages each thread can record before the tracing thread takes them.
+#define TRACE_RING_SIZE 8192
+
+// Milliseconds between the tracing thread's passes over the rings.
+#define TRACE_INTERVAL_MS 10
+
+// Stages are only matched once they're this old, so a stage still being written to another thread's ring isn't
+// counted before an earlier stage of the same frame.
+#define TRACE_SETTLE_NS 2000000
+
+// A frame with no new stage for this long is forgotten.
+#define TRACE_FORGET_NS 1000000000
+
+static const char * stageNames[] = {"trigger issued", "frame grabbed", "CRC verified", "detection done",
+                                    "pair matched", "position estimated", "frame presented"};
+static_assert(sizeof(stageNames) / sizeof(stageNames[0]) == (size_t) TraceStage::Count, "Every stage needs a name.");
+
+struct TraceEvent
+{
+    uint64_t ns;
+    uint64_t frameNumber;
+    uint32_t cameraNo;
+    TraceStage stage;
+};
+
+struct TraceThreadRing
+{
+    SpscRing<TraceEvent, TRACE_RING_SIZE> ring;
+    std::atomic<uint64_t> dropped{0};
+};
+
+// Every thread's ring. Rings are kept until the program exits, even after their thread has finished.
+static std::mutex ringsMutex;
+static std::vector<std::unique_ptr<TraceThreadRing>> rings;
+static thread_local TraceThreadRing * threadRing = nullptr;
+
+static uint64_t monotonicNs(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void traceStage(TraceStage stage, uint32_t cameraNo, uint64_t frameNumber){
+    uint64_t ns = monotonicNs();
+    if(threadRing == nullptr){
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.emplace_back(new TraceThreadRing());
+        threadRing = rings.back().get();
+    }
+    if(!threadRing->ring.tryPush({ns, frameNumber, cameraNo, stage})){
+        threadRing->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint32_t LatencyHistogram::bucketOf(uint64_t ns){
+    if(ns < SUB_BUCKETS) return ns;
+    uint32_t highestBit = 63 - __builtin_clzll(ns);
+    uint32_t group = highestBit - SUB_BUCKET_BITS + 1;
+    uint32_t bucket = group * SUB_BUCKETS + ((ns >> (highestBit - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return std::min(bucket, BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::bucketTop(uint32_t bucket){
+    uint32_t group = bucket / SUB_BUCKETS;
+    uint32_t sub = bucket % SUB_BUCKETS;
+    if(group == 0) return sub;
+    uint32_t shift = group - 1;
+    return (((uint64_t) (SUB_BUCKETS + sub) + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns){
+    counts[bucketOf(ns)]++;
+    total++;
+    maximum = std::max(maximum, ns);
+    sum += ns;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const{
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t) ceil(p * total));
+    uint64_t seen = 0;
+    for(uint32_t bucket = 0; bucket < BUCKETS; bucket++){
+        seen += counts[bucket];
+        if(seen >= rank) return std::min(bucketTop(bucket), maximum);
+    }
+    return maximum;
+}
+
+void LatencyHistogram::print(std::ostream & out, const char * name) const{
+    out << std::left << std::setw(20) << name << std::right << std::setw(10) << total << std::fixed << std::setprecision(1);
+    if(total > 0){
+        out << std::setw(10) << mean() / 1000;
+        for(double p : {0.5, 0.9, 0.99, 0.999}) out << std::setw(10) << percentile(p) / 1000.0;
+        out << std::setw(10) << maximum / 1000.0;
+    }
+    out << "\n";
+}
+
+// Matches up the stages of each frame. Only used by the tracing thread.
+class LatencyTracer {
+private:
+    struct FrameTrace
+    {
+        uint64_t first;
+        uint64_t previous;
+    };
+
+    // Keyed by camera number and frame number, so any number of cameras can be traced.
+    std::map<std::pair<uint32_t, uint64_t>, FrameTrace> frames;
+    std::vector<TraceEvent> pending;
+    LatencyHistogram sinceFirst[(size_t) TraceStage::Count];
+    LatencyHistogram sincePrevious[(size_t) TraceStage::Count];
+    uint64_t lastForget = 0;
+
+    void match(const TraceEvent & event){
+        FrameTrace & frame = frames.try_emplace(std::make_pair(event.cameraNo, event.frameNumber),
+                                                FrameTrace{event.ns, event.ns}).first->second;
+        if(event.ns != frame.first){
+            sinceFirst[(size_t) event.stage].record(event.ns - frame.first);
+            sincePrevious[(size_t) event.stage].record(event.ns - frame.previous);
+        }
+        frame.previous = event.ns;
+    }
+public:
+    // Take the stages written to every ring and match the ones older than settleBefore.
+    void collect(uint64_t settleBefore){
+        std::vector<TraceThreadRing *> threadRings;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            for(std::unique_ptr<TraceThreadRing> & ring : rings) threadRings.push_back(ring.get());
+        }
+        TraceEvent event;
+        for(TraceThreadRing * ring : threadRings){
+            while(ring->ring.tryPop(event)) pending.push_back(event);
+        }
+
+        // Stages from different threads are matched in the order they happened.
+        std::sort(pending.begin(), pending.end(), [](const TraceEvent & a, const TraceEvent & b){ return a.ns < b.ns; });
+        size_t settled = 0;
+        while(settled < pending.size() && pending[settled].ns < settleBefore) match(pending[settled++]);
+        pending.erase(pending.begin(), pending.begin() + settled);
+
+        if(settleBefore - lastForget > TRACE_FORGET_NS){
+            for(auto it = frames.begin(); it != frames.end();){
+                it = it->second.previous + TRACE_FORGET_NS < settleBefore ? frames.erase(it) : std::next(it);
+            }
+            lastForget = settleBefore;
+        }
+    }
+
+    void print(std::ostream & out){
+        uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            for(std::unique_ptr<TraceThreadRing> & ring : rings) dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+        const char * columns = "stage                    count   mean us    p50 us    p90 us    p99 us  p99.9 us    max us\n";
+        out << "Latency since each frame's first stage:\n" << columns;
+        for(size_t i = 0; i < (size_t) TraceStage::Count; i++) sinceFirst[i].print(out, stageNames[i]);
+        out << "Latency since each frame's previous stage:\n" << columns;
+        for(size_t i = 0; i < (size_t) TraceStage::Count; i++) sincePrevious[i].print(out, stageNames[i]);
+        if(dropped > 0) out << dropped << " stages were dropped because a ring was full.\n";
+        out << std::flush;
+    }
+};
+
+static std::mutex tracerMutex;
+static std::condition_variable tracerWake;
+static bool tracerStopping = false;
+static std::thread tracerThread;
+static std::atomic<bool> printRequested{false};
+
+static void requestPrint(int){
+    printRequested.store(true, std::memory_order_relaxed);
+}
+
+static void runTracer(){
+    LatencyTracer tracer;
+    std::unique_lock<std::mutex> lock(tracerMutex);
+    while(!tracerStopping){
+        tracerWake.wait_for(lock, std::chrono::milliseconds(TRACE_INTERVAL_MS));
+        lock.unlock();
+        tracer.collect(monotonicNs() - TRACE_SETTLE_NS);
+        if(printRequested.exchange(false, std::memory_order_relaxed)) tracer.print(cerr);
+        lock.lock();
+    }
+    // Everything has been written by now, so the last stages don't need to settle.
+    tracer.collect(UINT64_MAX);
+    tracer.print(cerr);
+}
+
+void latencyTraceStart(){
+    std::lock_guard<std::mutex> lock(tracerMutex);
+    if(tracerThread.joinable()) return;
+    tracerStopping = false;
+    signal(SIGUSR1, requestPrint);
+    tracerThread = std::thread(runTracer);
+}
+
+void latencyTraceStop(){
+    {
+        std::lock_guard<std::mutex> lock(tracerMutex);
+        if(!tracerThread.joinable()) return;
+        tracerStopping = true;
+    }
+    tracerWake.notify_one();
+    tracerThread.join();
+    signal(SIGUSR1, SIG_DFL);
+}
+#endif //LSAD_TRACING
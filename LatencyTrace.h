@@ -0,0 +1,102 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_LATENCYTRACE_H
+#define UNTITLED_LATENCYTRACE_H
+
+#include <cstdint>
+#include <ostream>
+
+// Where a frame is on its way from the trigger to a point on the screen.
+// Each frame is followed by its camera number and frame number.
+enum class TraceStage : uint8_t
+{
+    TriggerIssued,
+    FrameGrabbed,
+    CrcVerified,
+    DetectionDone,
+    PairMatched,
+    PositionEstimated,
+    FramePresented,
+    Count
+};
+
+// Build with -DLSAD_TRACING=ON to record a monotonic timestamp at each stage. Each thread writes its stages to its
+// own lock free ring and a thread started by LSAD_TRACE_START matches them up by frame into histograms of the time
+// since the frame's first stage and since its previous stage. The histograms are printed to stderr on SIGUSR1 and by
+// LSAD_TRACE_STOP.
+// Without LSAD_TRACING the macros are empty and their arguments aren't evaluated.
+#ifdef LSAD_TRACING
+#define LSAD_TRACE(stage, cameraNo, frameNumber) traceStage(TraceStage::stage, cameraNo, frameNumber)
+#define LSAD_TRACE_PAIR(stage, frameNumber0, frameNumber1) \
+    do { traceStage(TraceStage::stage, 0, frameNumber0); traceStage(TraceStage::stage, 1, frameNumber1); } while(0)
+#define LSAD_TRACE_START() latencyTraceStart()
+#define LSAD_TRACE_STOP() latencyTraceStop()
+#else
+#define LSAD_TRACE(stage, cameraNo, frameNumber) ((void) 0)
+#define LSAD_TRACE_PAIR(stage, frameNumber0, frameNumber1) ((void) 0)
+#define LSAD_TRACE_START() ((void) 0)
+#define LSAD_TRACE_STOP() ((void) 0)
+#endif
+
+#ifdef LSAD_TRACING
+// Record that frame frameNumber from cameraNo reached stage now. Doesn't lock or allocate after a thread's first call.
+void traceStage(TraceStage stage, uint32_t cameraNo, uint64_t frameNumber);
+
+// Start matching up stages and print the histograms on SIGUSR1.
+void latencyTraceStart();
+
+// Match up the stages left, print the histograms and stop.
+void latencyTraceStop();
+
+// Nanosecond latencies counted in buckets about 3% wide, like an HDR histogram.
+// Each power of two is split into 32 buckets, so the error doesn't depend on the size of the value.
+class LatencyHistogram {
+private:
+    static const uint32_t SUB_BUCKET_BITS = 5;
+    static const uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    // Covers up to 2^40 ns, about 18 minutes. Anything longer goes in the last bucket.
+    static const uint32_t BUCKETS = (40 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t maximum = 0;
+    double sum = 0;
+
+    static uint32_t bucketOf(uint64_t ns);
+    // Largest value counted in bucket.
+    static uint64_t bucketTop(uint32_t bucket);
+public:
+    void record(uint64_t ns);
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maximum; }
+    double mean() const { return total > 0 ? sum / total : 0; }
+
+    // The value below which fraction p of the recorded values fall, to the bucket's precision.
+    uint64_t percentile(double p) const;
+
+    // Count, mean, p50, p90, p99, p99.9 and max in microseconds on one line.
+    void print(std::ostream & out, const char * name) const;
+};
+#endif //LSAD_TRACING
+
+#endif //UNTITLED_LATENCYTRACE_H
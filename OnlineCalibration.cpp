@@ -0,0 +1,106 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "OnlineCalibration.h"
+#include <algorithm>
+#include <cmath>
+
+// Relative size of a diagonal element of R below which the points don't determine a coefficient.
+#define RANK_TOLERANCE 1e-10
+
+void OnlineCalibration::reset(){
+    *this = OnlineCalibration();
+}
+
+void OnlineCalibration::addPoint(const struct DataPoint & point){
+    double row[NUM_COEFFICIENTS];
+    calibrationFeatures(point.L45, point.L90, row);
+    double x = point.x;
+    double y = point.y;
+
+    // Rotate the new row into R one column at a time. Whatever is left of x and y adds to the residuals.
+    for(int k = 0; k < NUM_COEFFICIENTS; k++){
+        if(row[k] == 0) continue;
+        double hypotenuse = std::hypot(r[k][k], row[k]);
+        double c = r[k][k] / hypotenuse;
+        double s = row[k] / hypotenuse;
+        r[k][k] = hypotenuse;
+        for(int j = k + 1; j < NUM_COEFFICIENTS; j++){
+            double rkj = r[k][j];
+            r[k][j] = c * rkj + s * row[j];
+            row[j]  = c * row[j] - s * rkj;
+        }
+        double qx = qtx[k], qy = qty[k];
+        qtx[k] = c * qx + s * x;
+        qty[k] = c * qy + s * y;
+        x = c * x - s * qx;
+        y = c * y - s * qy;
+    }
+    residualX += x * x;
+    residualY += y * y;
+    count++;
+}
+
+void OnlineCalibration::addPoints(const std::vector<struct DataPoint> & data){
+    for(const struct DataPoint & point : data) addPoint(point);
+}
+
+size_t OnlineCalibration::points() const{
+    return count;
+}
+
+bool OnlineCalibration::ready() const{
+    if(count < NUM_COEFFICIENTS) return false;
+    double largest = 0;
+    for(int k = 0; k < NUM_COEFFICIENTS; k++) largest = std::max(largest, std::fabs(r[k][k]));
+    for(int k = 0; k < NUM_COEFFICIENTS; k++){
+        if(std::fabs(r[k][k]) <= RANK_TOLERANCE * largest) return false;
+    }
+    return true;
+}
+
+bool OnlineCalibration::currentFit(CalibrationFit & fit) const{
+    if(!ready()) return false;
+
+    // Back substitution with R, then undo the pixel scaling.
+    for(int k = NUM_COEFFICIENTS - 1; k >= 0; k--){
+        double sx = qtx[k], sy = qty[k];
+        for(int j = k + 1; j < NUM_COEFFICIENTS; j++){
+            sx -= r[k][j] * fit.xCoefficients[j];
+            sy -= r[k][j] * fit.yCoefficients[j];
+        }
+        fit.xCoefficients[k] = sx / r[k][k];
+        fit.yCoefficients[k] = sy / r[k][k];
+    }
+    unscaleCoefficients(fit.xCoefficients);
+    unscaleCoefficients(fit.yCoefficients);
+    fit.points = count;
+    fit.rmsErrorX = std::sqrt(residualX / count);
+    fit.rmsErrorY = std::sqrt(residualY / count);
+    return true;
+}
+
+bool OnlineCalibration::publish(ScreenPositionEstimator & estimator) const{
+    CalibrationFit fit;
+    if(!currentFit(fit)) return false;
+    estimator.setCoefficients(fit.xCoefficients, fit.yCoefficients);
+    return true;
+}
@@ -0,0 +1,66 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_ONLINECALIBRATION_H
+#define UNTITLED_ONLINECALIBRATION_H
+
+#include <cstddef>
+#include <vector>
+#include "calibrationFitting.h"
+
+// The least squares calibration fit updated one point at a time.
+// Keeps the R factor of the QR decomposition of the design matrix and Q transpose times the screen coordinates.
+// A point is folded in with Givens rotations in O(NUM_COEFFICIENTS^2), and the coefficients are a back substitution
+// away, so a new shot updates the calibration without refitting every point. Gives the same coefficients
+// as fitCalibration on the same points.
+class OnlineCalibration {
+private:
+    // Upper triangle of R.
+    double r[NUM_COEFFICIENTS][NUM_COEFFICIENTS] = {};
+    // Q transpose times the x and y coordinates.
+    double qtx[NUM_COEFFICIENTS] = {};
+    double qty[NUM_COEFFICIENTS] = {};
+    // Sum of the squared residuals of the fit so far.
+    double residualX = 0;
+    double residualY = 0;
+    size_t count = 0;
+public:
+    // Forget every point.
+    void reset();
+
+    // Fold in one point.
+    void addPoint(const struct DataPoint & point);
+    void addPoints(const std::vector<struct DataPoint> & data);
+
+    // Points folded in so far.
+    size_t points() const;
+
+    // True once the points determine every coefficient.
+    bool ready() const;
+
+    // The fit of every point so far. Returns false when it isn't ready.
+    bool currentFit(CalibrationFit & fit) const;
+
+    // Give estimator the current coefficients. Returns false when it isn't ready.
+    bool publish(ScreenPositionEstimator & estimator) const;
+};
+
+#endif //UNTITLED_ONLINECALIBRATION_H
@@ -0,0 +1,152 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "PositionLookupTable.h"
+#include "ScreenPositionEstimator.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+using std::cerr, std::endl;
+
+// Written at the start of a cache file, followed by the coefficients and then the cells.
+struct PositionLookupHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pixelsPerLine;
+    uint32_t stride;
+    uint32_t numCoefficients;
+};
+
+uint32_t positionLookupStrideFromEnvironment(){
+    const char * value = getenv(POSITION_LUT_STRIDE_ENV);
+    if(value == NULL) return 0;
+    uint32_t stride = atoi(value);
+    if(stride > 0 && PIXELS_PER_LINE % stride != 0){
+        cerr << POSITION_LUT_STRIDE_ENV << " must divide " << PIXELS_PER_LINE << " evenly." << endl;
+        std::abort();
+    }
+    return stride;
+}
+
+void PositionLookupTable::build(ScreenPositionEstimator & estimator, uint32_t pointStride){
+    stride = pointStride;
+    cellsPerRow = PIXELS_PER_LINE / stride;
+    inverseStride = 1.0f / stride;
+    cells.assign(POSITION_LUT_CELL_FLOATS * (size_t) cellsPerRow * cellsPerRow, 0);
+
+    // Rows of cells are shared between the threads. Each row of points is one batch of estimates.
+    uint32_t pointsPerRow = cellsPerRow + 1;
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    auto fillRows = [this, &estimator, threads, pointsPerRow](uint32_t first){
+        std::vector<double> s0(pointsPerRow), s1(pointsPerRow), x[2], y[2];
+        for(int n = 0; n < 2; n++){
+            x[n].resize(pointsPerRow);
+            y[n].resize(pointsPerRow);
+        }
+        for(uint32_t j = 0; j < pointsPerRow; j++) s1[j] = (double) j * stride;
+        double scale = 1.0 / stride;
+        for(uint32_t i = first; i < cellsPerRow; i += threads){
+            // The points along both edges of the row.
+            for(int n = 0; n < 2; n++){
+                std::fill(s0.begin(), s0.end(), (double) (i + n) * stride);
+                estimator.estimateBatch(s0.data(), s1.data(), pointsPerRow, x[n].data(), y[n].data());
+            }
+            float * cell = cells.data() + POSITION_LUT_CELL_FLOATS * (size_t) i * cellsPerRow;
+            for(uint32_t j = 0; j < cellsPerRow; j++, cell += POSITION_LUT_CELL_FLOATS){
+                const std::vector<double> * values[2][2] = {{&x[0], &x[1]}, {&y[0], &y[1]}};
+                for(int k = 0; k < 2; k++){
+                    double p00 = (*values[k][0])[j], p01 = (*values[k][0])[j + 1];
+                    double p10 = (*values[k][1])[j], p11 = (*values[k][1])[j + 1];
+                    cell[4*k]     = p00;
+                    cell[4*k + 1] = (p10 - p00) * scale;
+                    cell[4*k + 2] = (p01 - p00) * scale;
+                    cell[4*k + 3] = (p11 - p10 - p01 + p00) * scale * scale;
+                }
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for(uint32_t t = 1; t < threads; t++) workers.emplace_back(fillRows, t);
+    fillRows(0);
+    for(std::thread & worker : workers) worker.join();
+}
+
+bool PositionLookupTable::load(const std::string & path, const double * coefficients, uint32_t numCoefficients){
+    FILE * file = fopen(path.c_str(), "rb");
+    if(file == NULL) return false;
+
+    PositionLookupHeader header;
+    std::vector<double> stored(numCoefficients);
+    uint32_t rowCells = PIXELS_PER_LINE / stride;
+    std::vector<float> table(POSITION_LUT_CELL_FLOATS * (size_t) rowCells * rowCells);
+    bool matches = fread(&header, sizeof(header), 1, file) == 1 &&
+                   memcmp(header.magic, POSITION_LUT_MAGIC, sizeof(POSITION_LUT_MAGIC)) == 0 &&
+                   header.version == POSITION_LUT_VERSION && header.pixelsPerLine == PIXELS_PER_LINE &&
+                   header.stride == stride && header.numCoefficients == numCoefficients &&
+                   fread(stored.data(), sizeof(double), numCoefficients, file) == numCoefficients &&
+                   memcmp(stored.data(), coefficients, numCoefficients * sizeof(double)) == 0 &&
+                   fread(table.data(), sizeof(float), table.size(), file) == table.size();
+    fclose(file);
+    if(!matches) return false;
+
+    cellsPerRow = rowCells;
+    inverseStride = 1.0f / stride;
+    cells = std::move(table);
+    return true;
+}
+
+void PositionLookupTable::save(const std::string & path, const double * coefficients, uint32_t numCoefficients) const{
+    // Write to a temporary file and rename it so another program never loads a partly written table.
+    std::string temporaryPath = path + ".tmp";
+    FILE * file = fopen(temporaryPath.c_str(), "wb");
+    if(file == NULL){
+        cerr << "Couldn't write the position lookup table to " << temporaryPath << ": " << strerror(errno) << endl;
+        return;
+    }
+
+    PositionLookupHeader header = {};
+    memcpy(header.magic, POSITION_LUT_MAGIC, sizeof(POSITION_LUT_MAGIC));
+    header.version = POSITION_LUT_VERSION;
+    header.pixelsPerLine = PIXELS_PER_LINE;
+    header.stride = stride;
+    header.numCoefficients = numCoefficients;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(coefficients, sizeof(double), numCoefficients, file) == numCoefficients &&
+                   fwrite(cells.data(), sizeof(float), cells.size(), file) == cells.size();
+    written = fclose(file) == 0 && written;
+    if(!written || rename(temporaryPath.c_str(), path.c_str()) != 0){
+        cerr << "Couldn't write the position lookup table to " << path << ": " << strerror(errno) << endl;
+        remove(temporaryPath.c_str());
+    }
+}
+
+void PositionLookupTable::buildCached(ScreenPositionEstimator & estimator, uint32_t pointStride, const std::string & cachePath,
+                                      const double * coefficients, uint32_t numCoefficients){
+    stride = pointStride;
+    if(load(cachePath, coefficients, numCoefficients)) return;
+    build(estimator, pointStride);
+    save(cachePath, coefficients, numCoefficients);
+}
@@ -0,0 +1,99 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_POSITIONLOOKUPTABLE_H
+#define UNTITLED_POSITIONLOOKUPTABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "camerasettings.h"
+
+// Environment variable read by positionLookupStrideFromEnvironment.
+// Pixels between the points of the lookup table used by ScreenPositionEstimator. 0 or unset evaluates the polynomial instead.
+#define POSITION_LUT_STRIDE_ENV "LSAD_POSITION_LUT_STRIDE"
+
+// Identifies a lookup table cache file.
+#define POSITION_LUT_MAGIC "LSADLUT"
+#define POSITION_LUT_VERSION 2
+
+// Floats stored for each cell of the table.
+#define POSITION_LUT_CELL_FLOATS 8
+
+// Stride from POSITION_LUT_STRIDE_ENV, or 0 when it isn't set. Aborts if PIXELS_PER_LINE isn't a multiple of it.
+uint32_t positionLookupStrideFromEnvironment();
+
+class ScreenPositionEstimator;
+
+// Screen positions for a grid of camera pixels. A position between grid points is interpolated from the four around it.
+// The grid covers pixels 0 to PIXELS_PER_LINE in both cameras with a point every stride pixels, so a stride of 1 is
+// 1024 x 1024 cells. Each cell holds the bilinear coefficients of x and then y in 32 bytes, so a lookup reads one cell.
+// A lookup costs about as much as evaluating the degree 4 polynomials even when the table is in cache, so the table is
+// only worth using for models that are slower to evaluate.
+class PositionLookupTable {
+private:
+    uint32_t stride = 0;
+    uint32_t cellsPerRow = 0;
+    float inverseStride = 0;
+    // For L45 pixels i*stride + u and L90 pixels j*stride + v, x is a + b*u + v*(c + d*u) with a, b, c, d at
+    // POSITION_LUT_CELL_FLOATS*(i*cellsPerRow + j), followed by y's.
+    std::vector<float> cells;
+
+    // Read a table built from coefficients from path. Returns false if the file doesn't exist or doesn't match.
+    bool load(const std::string & path, const double * coefficients, uint32_t numCoefficients);
+
+    // Write the table to path. The coefficients are stored with it to check it still matches when it's loaded.
+    void save(const std::string & path, const double * coefficients, uint32_t numCoefficients) const;
+public:
+    // Fill the table from estimator using every hardware thread. PIXELS_PER_LINE must be a multiple of stride.
+    void build(ScreenPositionEstimator & estimator, uint32_t stride);
+
+    // Load the table from cachePath, or build it and write it to cachePath when it's missing or was built from other coefficients.
+    void buildCached(ScreenPositionEstimator & estimator, uint32_t stride, const std::string & cachePath,
+                     const double * coefficients, uint32_t numCoefficients);
+
+    // True once the table is built or loaded.
+    bool ready() const { return !cells.empty(); }
+
+    uint32_t pointStride() const { return stride; }
+
+    // True when (s0, s1) is on the grid. Pixels of cameras wider than PIXELS_PER_LINE can be off it.
+    inline bool covers(double s0, double s1) const {
+        return s0 <= PIXELS_PER_LINE && s1 <= PIXELS_PER_LINE;
+    }
+
+    // Bilinear interpolation between the four points around (s0, s1). Pixels off the grid are moved to its edge.
+    inline void lookup(double s0, double s1, double & x, double & y) const {
+        float u = std::min(std::max((float) s0, 0.0f), (float) PIXELS_PER_LINE);
+        float v = std::min(std::max((float) s1, 0.0f), (float) PIXELS_PER_LINE);
+        uint32_t i = std::min((uint32_t) (u * inverseStride), cellsPerRow - 1);
+        uint32_t j = std::min((uint32_t) (v * inverseStride), cellsPerRow - 1);
+        u -= (float) (i * stride);
+        v -= (float) (j * stride);
+
+        const float * cell = cells.data() + POSITION_LUT_CELL_FLOATS*((size_t) i*cellsPerRow + j);
+        x = cell[0] + cell[1]*u + v*(cell[2] + cell[3]*u);
+        y = cell[4] + cell[5]*u + v*(cell[6] + cell[7]*u);
+    }
+};
+
+#endif //UNTITLED_POSITIONLOOKUPTABLE_H
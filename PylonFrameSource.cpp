@@ -0,0 +1,233 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// Event handlers in Basler C++ samples were used as a starting point.
+
+#include "PylonFrameSource.h"
+#include "cameraSetup.h"
+#include <algorithm>
+
+using namespace Pylon;
+
+FrameSourceImageEventHandler::FrameSourceImageEventHandler(PylonFrameSource * source) : source(source){
+}
+
+void GrabBufferFactory::reserve(size_t bufferBytes, size_t count){
+    pool.reset(new GrabBufferPool(bufferBytes, count));
+}
+
+void GrabBufferFactory::AllocateBuffer(size_t bufferSize, void** pCreatedBuffer, intptr_t& bufferContext){
+    uint8_t * buffer = pool && bufferSize <= pool->bufferBytes() ? pool->acquire() : nullptr;
+    if(buffer == nullptr){
+        throw RUNTIME_EXCEPTION("The camera asked for more grab buffers than were reserved, or larger ones.");
+    }
+    *pCreatedBuffer = buffer;
+    bufferContext = 0;
+}
+
+void GrabBufferFactory::FreeBuffer(void* pCreatedBuffer, intptr_t bufferContext){
+    pool->release((uint8_t *) pCreatedBuffer);
+}
+
+void GrabBufferFactory::DestroyBufferFactory(){
+}
+
+void FrameSourceImageEventHandler::OnImageGrabbed(Camera_t& camera, const GrabResultPtr_t& ptrGrabResult){
+    // Frames are only delivered here when a handler is set. Otherwise they're taken with retrieveFrame.
+    if(source->handler){
+        Frame frame;
+        source->makeFrame(ptrGrabResult, frame);
+        source->handler(frame);
+    }
+}
+
+PylonFrameSource::PylonFrameSource(CDeviceInfo & device, CTlFactory & tlFactory, AcquisitionMode mode, uint32_t cameraNo)
+    : cameraName(device.GetUserDefinedName().c_str()), number(cameraNo), mode(mode){
+    if(mode == AcquisitionMode::SoftwareTrigger){
+        camSetupSoftwareTrigger(camera, device, tlFactory);
+    }
+    else{
+        camSetupContinous(camera, device, tlFactory);
+    }
+
+    // Frames are the size the camera is set up for, which can be cropped from the full sensor.
+    sensorGeometry.pixelsPerLine = (uint32_t) camera.Width.GetValue();
+    sensorGeometry.imageHeight = (uint32_t) camera.Height.GetValue();
+
+    // Grab into buffers from a pool sized for the camera's payload, which includes the chunk data, with as many
+    // buffers as the acquisition mode was set up to queue.
+    bufferFactory.reserve((size_t) camera.PayloadSize.GetValue(), (size_t) camera.MaxNumBuffer.GetValue());
+    camera.SetBufferFactory(&bufferFactory, Cleanup_None);
+
+    // Register an event handler.
+    camera.RegisterImageEventHandler( new FrameSourceImageEventHandler(this), RegistrationMode_Append, Cleanup_Delete);
+}
+
+PylonFrameSource::~PylonFrameSource(){
+    // The grab loop thread has to be stopped before the handler's source is destroyed.
+    if(camera.IsPylonDeviceAttached()) camera.StopGrabbing();
+}
+
+Camera_t & PylonFrameSource::getCamera(){
+    return camera;
+}
+
+const char * PylonFrameSource::name(){
+    return cameraName.c_str();
+}
+
+uint32_t PylonFrameSource::cameraNo(){
+    return number;
+}
+
+SensorGeometry PylonFrameSource::geometry(){
+    return sensorGeometry;
+}
+
+void PylonFrameSource::setFrameHandler(FrameHandler frameHandler){
+    handler = frameHandler;
+}
+
+void PylonFrameSource::startGrabbing(uint64_t count){
+    if(handler){
+        // Can the camera device be queried whether it is ready to accept the next frame trigger?
+        // See the documentation of CInstantCamera::CanWaitForFrameTriggerReady() for more information.
+        if(mode == AcquisitionMode::SoftwareTrigger && !camera.CanWaitForFrameTriggerReady()){
+            throw RUNTIME_EXCEPTION("CanWaitForFrameTriggerReady() failed.");
+        }
+
+        // Start the grabbing using the grab loop thread, by setting the grabLoopType parameter
+        // to GrabLoop_ProvidedByInstantCamera. The grab results are delivered to the image event handlers.
+        // The GrabStrategy_OneByOne default grab strategy is used.
+        if(count > 0){
+            camera.StartGrabbing(count, GrabStrategy_OneByOne, GrabLoop_ProvidedByInstantCamera);
+        }
+        else{
+            camera.StartGrabbing(GrabStrategy_OneByOne, GrabLoop_ProvidedByInstantCamera);
+        }
+    }
+    else{
+        // Camera.StopGrabbing() is called automatically by the RetrieveResult() method
+        // when count images have been retrieved.
+        if(count > 0){
+            camera.StartGrabbing(count);
+        }
+        else{
+            camera.StartGrabbing();
+        }
+    }
+}
+
+void PylonFrameSource::stopGrabbing(){
+    ptrGrabResult.Release();
+    camera.StopGrabbing();
+
+    // Turn off chunk mode for the camera.
+    if(mode == AcquisitionMode::Continuous){
+        camera.ChunkModeActive.SetValue(false);
+    }
+}
+
+bool PylonFrameSource::isGrabbing(){
+    return camera.IsGrabbing();
+}
+
+bool PylonFrameSource::retrieveFrame(Frame & frame, uint32_t timeoutMs){
+    if(!camera.IsGrabbing()) return false;
+
+    // Wait for an image and then retrieve it.
+    // RetrieveResult calls the image event handler's OnImageGrabbed method.
+    if(!camera.RetrieveResult(timeoutMs, ptrGrabResult, TimeoutHandling_ThrowException)) return false;
+
+    // Check to see if a buffer containing chunk data has been received.
+    if (PayloadType_ChunkData != ptrGrabResult->GetPayloadType())
+    {
+        throw RUNTIME_EXCEPTION( "Unexpected payload type received.");
+    }
+
+    makeFrame(ptrGrabResult, frame);
+    return true;
+}
+
+void PylonFrameSource::releaseFrame(){
+    ptrGrabResult.Release();
+}
+
+bool PylonFrameSource::waitForFrameTriggerReady(uint32_t timeoutMs){
+    return camera.WaitForFrameTriggerReady(timeoutMs, TimeoutHandling_ThrowException);
+}
+
+void PylonFrameSource::executeSoftwareTrigger(){
+    camera.ExecuteSoftwareTrigger();
+}
+
+void PylonFrameSource::makeFrame(const GrabResultPtr_t & result, Frame & frame){
+    // The result data is automatically filled with received chunk data.
+    // (Note:  This is not the case when using the low-level API)
+    frame.buffer      = (const uint8_t *) result->GetBuffer();
+    frame.cameraNo    = number;
+    frame.cameraName  = cameraName.c_str();
+    frame.timestamp   = IsReadable(result->ChunkTimestamp) ? result->ChunkTimestamp.GetValue() : 0;
+    frame.frameNumber = result->GetImageNumber();
+    frame.hasCRC      = result->HasCRC();
+    frame.crcPassed   = frame.hasCRC && result->CheckCRC();
+}
+
+bool PylonFrameSource::readClock(uint64_t & ticks){
+    // Latch the camera's timestamp counter and read the latched value.
+    if(!IsWritable(camera.GevTimestampControlLatch) || !IsReadable(camera.GevTimestampValue)) return false;
+    camera.GevTimestampControlLatch.Execute();
+    ticks = camera.GevTimestampValue.GetValue();
+    return true;
+}
+
+double PylonFrameSource::frameRate(){
+    if(!IsReadable(camera.ResultingLineRateAbs)) return 0;
+    return camera.ResultingLineRateAbs.GetValue() / sensorGeometry.imageHeight;
+}
+
+std::vector<std::unique_ptr<FrameSource>> openPylonFrameSources(AcquisitionMode mode, size_t maxSources){
+    // Get the transport layer factory.
+    CTlFactory& tlFactory = CTlFactory::GetInstance();
+
+    // Get all attached devices and exit application if no device is found.
+    // There should be a camera attached for each name in cameraNames.
+    DeviceInfoList_t devices;
+    if( tlFactory.EnumerateDevices(devices) == 0){
+        throw RUNTIME_EXCEPTION("No camera present.");
+    }
+
+    // Put the cameras in camera number order with any other names after them.
+    std::vector<size_t> order(devices.size());
+    for(size_t i = 0; i < order.size(); i++) order[i] = i;
+    auto rank = [&devices](size_t i){
+        int n = cameraNumber(devices[i].GetUserDefinedName().c_str());
+        return n < 0 ? (int) cameraNames().size() : n;
+    };
+    std::stable_sort(order.begin(), order.end(), [&rank](size_t a, size_t b){return rank(a) < rank(b);});
+
+    std::vector<std::unique_ptr<FrameSource>> sources;
+    for(size_t i = 0; i < order.size() && i < maxSources; i++){
+        int n = cameraNumber(devices[order[i]].GetUserDefinedName().c_str());
+        sources.emplace_back(new PylonFrameSource(devices[order[i]], tlFactory, mode, n < 0 ? i : n));
+    }
+    return sources;
+}
@@ -0,0 +1,104 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_PYLONFRAMESOURCE_H
+#define UNTITLED_PYLONFRAMESOURCE_H
+
+#include "camerasettings.h"
+#include "FrameSource.h"
+#include "GrabBufferPool.h"
+#include <memory>
+
+class PylonFrameSource;
+
+// Gives the camera its grab buffers from a GrabBufferPool, so frames are grabbed straight into aligned, huge page
+// backed memory that detection reads in place and that's registered for DMA to the GPU.
+class GrabBufferFactory : public Pylon::IBufferFactory
+{
+private:
+    std::unique_ptr<GrabBufferPool> pool;
+public:
+    // Allocate count buffers of bufferBytes. Must be called before grabbing starts.
+    void reserve(size_t bufferBytes, size_t count);
+
+    virtual void AllocateBuffer(size_t bufferSize, void** pCreatedBuffer, intptr_t& bufferContext);
+    virtual void FreeBuffer(void* pCreatedBuffer, intptr_t bufferContext);
+    // The factory belongs to its PylonFrameSource, so there's nothing to do.
+    virtual void DestroyBufferFactory();
+};
+
+// Image event handler registered with every camera.
+// Converts the grab result to a Frame and passes it to the source's FrameHandler.
+class FrameSourceImageEventHandler : public ImageEventHandler_t
+{
+private:
+    PylonFrameSource * source;
+public:
+    explicit FrameSourceImageEventHandler(PylonFrameSource * source);
+    virtual void OnImageGrabbed( Camera_t& camera, const GrabResultPtr_t& ptrGrabResult);
+};
+
+// A Basler GigE camera.
+class PylonFrameSource : public FrameSource {
+private:
+    // Declared before the camera, so the camera frees its buffers before the pool is.
+    GrabBufferFactory bufferFactory;
+    Camera_t camera;
+    std::string cameraName;
+    uint32_t number;
+    AcquisitionMode mode;
+    SensorGeometry sensorGeometry;
+    FrameHandler handler;
+
+    // Holds the last frame retrieved until releaseFrame is called.
+    GrabResultPtr_t ptrGrabResult;
+
+    friend class FrameSourceImageEventHandler;
+public:
+    // Attach and set up the camera for device using camSetupSoftwareTrigger or camSetupContinous.
+    PylonFrameSource(Pylon::CDeviceInfo & device, Pylon::CTlFactory & tlFactory, AcquisitionMode mode, uint32_t cameraNo);
+    ~PylonFrameSource() override;
+
+    // The camera for settings that aren't part of FrameSource.
+    Camera_t & getCamera();
+
+    const char * name() override;
+    uint32_t cameraNo() override;
+    SensorGeometry geometry() override;
+    void setFrameHandler(FrameHandler handler) override;
+    void startGrabbing(uint64_t count = 0) override;
+    void stopGrabbing() override;
+    bool isGrabbing() override;
+    bool retrieveFrame(Frame & frame, uint32_t timeoutMs) override;
+    void releaseFrame() override;
+    bool waitForFrameTriggerReady(uint32_t timeoutMs) override;
+    void executeSoftwareTrigger() override;
+    bool readClock(uint64_t & ticks) override;
+    double frameRate() override;
+
+    // Fill frame from a grab result.
+    void makeFrame(const GrabResultPtr_t & result, Frame & frame);
+};
+
+// Enumerate the attached cameras and open up to maxSources of them.
+std::vector<std::unique_ptr<FrameSource>> openPylonFrameSources(AcquisitionMode mode, size_t maxSources);
+
+#endif //UNTITLED_PYLONFRAMESOURCE_H
@@ -0,0 +1,268 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "ReplayFrameSource.h"
+#include "camerasettings.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+RecordingFile::RecordingFile(const char * path) : path(path){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        throw std::runtime_error(std::string("Couldn't open the recording file ") + path + ": " + strerror(errno));
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(RecordingFileHeader)){
+        close(fd);
+        throw std::runtime_error(std::string("The recording file ") + path + " is too short.");
+    }
+
+    mapBytes = st.st_size;
+    void * mapped = mmap(NULL, mapBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){
+        throw std::runtime_error(std::string("Couldn't map the recording file ") + path + ": " + strerror(errno));
+    }
+    map = (const uint8_t *) mapped;
+
+    // Frames are read in order, so let the kernel read ahead.
+    madvise(mapped, mapBytes, MADV_SEQUENTIAL);
+
+    const RecordingFileHeader * fileHeader = (const RecordingFileHeader *) map;
+    if(memcmp(fileHeader->magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 || fileHeader->version != RECORDING_VERSION){
+        munmap(mapped, mapBytes);
+        throw std::runtime_error(std::string(path) + " isn't a version " + std::to_string(RECORDING_VERSION) + " recording file.");
+    }
+    if(fileHeader->pixelsPerLine != PIXELS_PER_LINE || fileHeader->imageHeight != IMAGE_HEIGHT ||
+       fileHeader->headerBytes != sizeof(RecordingFileHeader) ||
+       fileHeader->recordBytes != sizeof(RecordingFrameHeader) + PIXELS_PER_LINE*IMAGE_HEIGHT){
+        munmap(mapped, mapBytes);
+        throw std::runtime_error(std::string("The frame size in ") + path + " doesn't match PIXELS_PER_LINE x IMAGE_HEIGHT.");
+    }
+
+    // A partly written record at the end of the file is ignored.
+    recordBytes = fileHeader->recordBytes;
+    recordCount = (mapBytes - fileHeader->headerBytes) / recordBytes;
+}
+
+RecordingFile::~RecordingFile(){
+    munmap((void *) map, mapBytes);
+}
+
+uint64_t RecordingFile::records() const{
+    return recordCount;
+}
+
+const RecordingFrameHeader * RecordingFile::header(uint64_t i) const{
+    return (const RecordingFrameHeader *) (map + sizeof(RecordingFileHeader) + i*recordBytes);
+}
+
+const uint8_t * RecordingFile::frame(uint64_t i) const{
+    return map + sizeof(RecordingFileHeader) + i*recordBytes + sizeof(RecordingFrameHeader);
+}
+
+std::vector<uint32_t> RecordingFile::cameraNumbers() const{
+    std::vector<uint32_t> numbers;
+    for(uint64_t i = 0; i < recordCount; i++){
+        uint32_t cameraNo = header(i)->cameraNo;
+        if(std::find(numbers.begin(), numbers.end(), cameraNo) == numbers.end()) numbers.push_back(cameraNo);
+    }
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+ReplayFrameSource::ReplayFrameSource(std::shared_ptr<const RecordingFile> recording, uint32_t cameraNo, AcquisitionMode mode, double speed)
+    : recording(std::move(recording)), number(cameraNo), mode(mode), speed(speed){
+    for(uint64_t i = 0; i < this->recording->records(); i++){
+        const RecordingFrameHeader * header = this->recording->header(i);
+        if(header->cameraNo != cameraNo) continue;
+        if(recordIndex.empty()) cameraName.assign(header->cameraName, strnlen(header->cameraName, sizeof(header->cameraName)));
+        recordIndex.push_back(i);
+    }
+}
+
+ReplayFrameSource::~ReplayFrameSource(){
+    stopGrabbing();
+}
+
+bool ReplayFrameSource::nextFrame(Frame & frame){
+    if(nextRecord >= recordIndex.size()) return false;
+
+    uint64_t i = recordIndex[nextRecord++];
+    const RecordingFrameHeader * header = recording->header(i);
+    frame.buffer      = recording->frame(i);
+    frame.cameraNo    = number;
+    frame.cameraName  = cameraName.c_str();
+    frame.timestamp   = header->timestamp;
+    frame.frameNumber = header->frameNumber;
+    frame.hasCRC      = header->flags & RECORDING_FLAG_HAS_CRC;
+    frame.crcPassed   = header->flags & RECORDING_FLAG_CRC_PASSED;
+    return true;
+}
+
+void ReplayFrameSource::pace(const Frame & frame){
+    if(framesGrabbed == 0) firstTimestamp = frame.timestamp;
+    if(speed <= 0 || frame.timestamp < firstTimestamp) return;
+
+    double seconds = (double) (frame.timestamp - firstTimestamp) / TIMESTAMP_TICKS_PER_SECOND / speed;
+    std::this_thread::sleep_until(startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds)));
+}
+
+void ReplayFrameSource::frameDone(){
+    framesGrabbed++;
+    if(nextRecord >= recordIndex.size() || (framesToGrab > 0 && framesGrabbed >= framesToGrab)) grabbing = false;
+    cv.notify_all();
+}
+
+void ReplayFrameSource::grabLoop(){
+    std::unique_lock<std::mutex> lk(m);
+    while(true){
+        if(mode == AcquisitionMode::SoftwareTrigger){
+            cv.wait(lk, [this]{return !grabbing || triggersPending > 0;});
+        }
+        if(!grabbing) break;
+
+        // Like a camera, the trigger is taken as soon as the frame starts so the next one can be queued while the handler runs.
+        if(mode == AcquisitionMode::SoftwareTrigger) triggersPending--;
+        cv.notify_all();
+
+        // The handler runs without the lock so triggers can be queued while it runs.
+        Frame frame;
+        nextFrame(frame);
+        lk.unlock();
+        pace(frame);
+        try{
+            handler(frame);
+        }
+        catch (const std::exception &e){
+            std::cerr << "Exception in the frame handler for " << cameraName << ": " << e.what() << std::endl;
+        }
+        lk.lock();
+
+        frameDone();
+    }
+}
+
+const char * ReplayFrameSource::name(){
+    return cameraName.c_str();
+}
+
+uint32_t ReplayFrameSource::cameraNo(){
+    return number;
+}
+
+void ReplayFrameSource::setFrameHandler(FrameHandler frameHandler){
+    handler = frameHandler;
+}
+
+void ReplayFrameSource::startGrabbing(uint64_t count){
+    {
+        std::scoped_lock lk(m);
+        // Each time grabbing starts the recording plays from the beginning.
+        nextRecord = 0;
+        grabbing = !recordIndex.empty();
+        framesToGrab = count;
+        framesGrabbed = 0;
+        triggersPending = 0;
+        startTime = std::chrono::steady_clock::now();
+    }
+    if(handler) grabThread = std::thread(&ReplayFrameSource::grabLoop, this);
+}
+
+void ReplayFrameSource::stopGrabbing(){
+    {
+        std::scoped_lock lk(m);
+        grabbing = false;
+    }
+    cv.notify_all();
+    if(grabThread.joinable()) grabThread.join();
+}
+
+bool ReplayFrameSource::isGrabbing(){
+    std::scoped_lock lk(m);
+    return grabbing;
+}
+
+bool ReplayFrameSource::retrieveFrame(Frame & frame, uint32_t timeoutMs){
+    std::unique_lock<std::mutex> lk(m);
+    if(!grabbing) return false;
+    if(mode == AcquisitionMode::SoftwareTrigger){
+        if(!cv.wait_for(lk, std::chrono::milliseconds(timeoutMs), [this]{return triggersPending > 0;})){
+            throw std::runtime_error("Timed out waiting for a software trigger.");
+        }
+        triggersPending--;
+    }
+    nextFrame(frame);
+    lk.unlock();
+
+    pace(frame);
+
+    lk.lock();
+    frameDone();
+    return true;
+}
+
+void ReplayFrameSource::releaseFrame(){
+    // Frames point into the mapped file and don't need to be released.
+}
+
+bool ReplayFrameSource::waitForFrameTriggerReady(uint32_t timeoutMs){
+    std::unique_lock<std::mutex> lk(m);
+    if(!cv.wait_for(lk, std::chrono::milliseconds(timeoutMs), [this]{return triggersPending == 0 || !grabbing;})){
+        throw std::runtime_error("Timed out waiting for the replay to be ready for a trigger.");
+    }
+    return grabbing;
+}
+
+void ReplayFrameSource::executeSoftwareTrigger(){
+    {
+        std::scoped_lock lk(m);
+        triggersPending++;
+    }
+    cv.notify_all();
+}
+
+std::vector<std::unique_ptr<FrameSource>> openReplayFrameSources(AcquisitionMode mode, size_t maxSources){
+    const char * path = getenv(REPLAY_FILE_ENV);
+    if(path == NULL || path[0] == '\0'){
+        throw std::runtime_error("Set " REPLAY_FILE_ENV " to the recording to replay.");
+    }
+    const char * speedValue = getenv(REPLAY_SPEED_ENV);
+    double speed = speedValue != NULL ? atof(speedValue) : 1;
+
+    std::shared_ptr<const RecordingFile> recording = std::make_shared<const RecordingFile>(path);
+    std::cout << "Replaying " << recording->records() << " frames from " << path << ".\n";
+
+    std::vector<std::unique_ptr<FrameSource>> sources;
+    for(uint32_t cameraNo : recording->cameraNumbers()){
+        if(sources.size() >= maxSources) break;
+        sources.emplace_back(new ReplayFrameSource(recording, cameraNo, mode, speed));
+    }
+    return sources;
+}
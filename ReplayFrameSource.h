@@ -0,0 +1,125 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_REPLAYFRAMESOURCE_H
+#define UNTITLED_REPLAYFRAMESOURCE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameRecorder.h"
+#include "FrameSource.h"
+
+// Environment variables read when FRAME_SOURCE_ENV is "replay".
+// LSAD_REPLAY_FILE   recording made with RECORD_FILE_ENV.
+// LSAD_REPLAY_SPEED  multiple of the recorded speed to replay at, 0 for as fast as possible. Defaults to 1.
+#define REPLAY_FILE_ENV  "LSAD_REPLAY_FILE"
+#define REPLAY_SPEED_ENV "LSAD_REPLAY_SPEED"
+
+// A recording file mapped into memory read only.
+// Frames are used straight from the mapping, so replaying doesn't copy them.
+class RecordingFile {
+private:
+    std::string path;
+    const uint8_t * map = NULL;
+    size_t mapBytes = 0;
+    uint64_t recordBytes = 0;
+    uint64_t recordCount = 0;
+public:
+    // Map the file at path and check its header matches this build's frame size. Throws if it can't be used.
+    explicit RecordingFile(const char * path);
+    ~RecordingFile();
+    RecordingFile(const RecordingFile &) = delete;
+    RecordingFile & operator=(const RecordingFile &) = delete;
+
+    // Number of complete records in the file.
+    uint64_t records() const;
+
+    // Header and frame of record i.
+    const RecordingFrameHeader * header(uint64_t i) const;
+    const uint8_t * frame(uint64_t i) const;
+
+    // Camera numbers in the file in ascending order.
+    std::vector<uint32_t> cameraNumbers() const;
+};
+
+// Plays back the frames for one camera from a RecordingFile.
+// Frames are delivered at the recorded speed using their chunk timestamps, or as fast as possible when speed is 0.
+// In SoftwareTrigger mode each trigger plays the next frame. Grabbing stops after the last frame for the camera.
+class ReplayFrameSource : public FrameSource {
+private:
+    std::shared_ptr<const RecordingFile> recording;
+    uint32_t number;
+    std::string cameraName;
+    AcquisitionMode mode;
+    double speed;
+
+    // Records in the file for this camera.
+    std::vector<uint64_t> recordIndex;
+    size_t nextRecord = 0;
+
+    FrameHandler handler;
+    std::thread grabThread;
+    std::mutex m;
+    std::condition_variable cv;
+    bool grabbing = false;
+    uint64_t framesToGrab = 0;
+    uint64_t framesGrabbed = 0;
+    uint32_t triggersPending = 0;
+    std::chrono::steady_clock::time_point startTime;
+    // Timestamp of the first frame played since grabbing started.
+    uint64_t firstTimestamp = 0;
+
+    // Fill frame from the next record. Returns false when there are no more.
+    bool nextFrame(Frame & frame);
+
+    // Sleep until frame is due at the recorded speed.
+    void pace(const Frame & frame);
+
+    // Count a frame as grabbed and stop grabbing at the end of the recording. Called with m locked.
+    void frameDone();
+
+    // Body of grabThread when a handler is set.
+    void grabLoop();
+public:
+    ReplayFrameSource(std::shared_ptr<const RecordingFile> recording, uint32_t cameraNo, AcquisitionMode mode, double speed);
+    ~ReplayFrameSource() override;
+
+    const char * name() override;
+    uint32_t cameraNo() override;
+    void setFrameHandler(FrameHandler handler) override;
+    void startGrabbing(uint64_t count = 0) override;
+    void stopGrabbing() override;
+    bool isGrabbing() override;
+    bool retrieveFrame(Frame & frame, uint32_t timeoutMs) override;
+    void releaseFrame() override;
+    bool waitForFrameTriggerReady(uint32_t timeoutMs) override;
+    void executeSoftwareTrigger() override;
+};
+
+// Open a ReplayFrameSource for each camera in the file named by REPLAY_FILE_ENV.
+std::vector<std::unique_ptr<FrameSource>> openReplayFrameSources(AcquisitionMode mode, size_t maxSources);
+
+#endif //UNTITLED_REPLAYFRAMESOURCE_H
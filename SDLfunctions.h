@@ -30,10 +30,10 @@ const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 550;
 
 // Global variable for the SDL window.
-SDL_Window* gWindow = NULL;
+inline SDL_Window* gWindow = NULL;
 
 // Global variable for the SDL renderer.
-SDL_Renderer* gRenderer = NULL;
+inline SDL_Renderer* gRenderer = NULL;
 
 // Setup an SDL window.
 void sdlWindowSetup(const char *);
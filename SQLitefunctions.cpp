@@ -19,54 +19,52 @@
 // along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "SQLitefunctions.h"
+#include "DatabaseService.h"
 
 void writeDataPointsToDB(std::vector<struct DataPoint> & data, const char * filename){
-    // Open the database file.
-    sqlite3 *db;
-    SQLite3_CHECK(sqlite3_open(filename, &db),db);
+    // The points are queued and committed in one transaction by the database's writer thread.
+    DatabaseService::forFile(filename).enqueue(dataPointRows(data, localDatetime()));
+}
 
-    // Get the current datetime.
-    sqlite3_stmt * stmt;
-    SQLite3_CHECK(sqlite3_prepare_v2(db,"SELECT datetime('now','localtime');",-1,&stmt,NULL),db);
-    SQLite3_CHECK(sqlite3_step(stmt),db);
-    std::string currentDatetime = reinterpret_cast<const char*>(sqlite3_column_text   (stmt,0));
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+std::vector<DatabaseRow> dataPointRows(const std::vector<struct DataPoint> & data, const std::string & timeCreated){
+    std::vector<DatabaseRow> rows;
+    rows.reserve(data.size() + 1);
 
     // Create the table for training datapoints.
-    SQLite3_CHECK(sqlite3_prepare_v2(db,CREATE_TRAINING_TABLE_QUERY,-1,&stmt,NULL),db);
-    SQLite3_CHECK(sqlite3_step(stmt),db);
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
-
-    // Doing multiple inserts inside of a transaction is faster.
-    // https://stackoverflow.com/questions/1711631/improve-insert-per-second-performance-of-sqlite
-    SQLite3_CHECK(sqlite3_prepare_v2(db,"BEGIN TRANSACTION",-1,&stmt,NULL),db);
-    SQLite3_CHECK(sqlite3_step(stmt),db);
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+    rows.push_back({CREATE_TRAINING_TABLE_QUERY, {}});
+    for(const struct DataPoint & point : data){
+        rows.push_back({INSERT_TRAINING_TABLE_QUERY, {(int64_t) point.x, (int64_t) point.y, (double) point.L45,
+                                                      (double) point.L90, timeCreated}});
+    }
+    return rows;
+}
 
-    // Prepare the statement for writing datapoints to the db.
-    SQLite3_CHECK(sqlite3_prepare_v2(db,INSERT_TRAINING_TABLE_QUERY,-1,&stmt,NULL),db);
-    for(int i = 0; i < data.size(); i++){
-        // Bind variables.
-        SQLite3_CHECK(sqlite3_bind_int(stmt,1,data[i].x),db);
-        SQLite3_CHECK(sqlite3_bind_int(stmt,2,data[i].y),db);
-        SQLite3_CHECK(sqlite3_bind_double(stmt,3,data[i].L45),db);
-        SQLite3_CHECK(sqlite3_bind_double(stmt,4,data[i].L90),db);
-        SQLite3_CHECK(sqlite3_bind_text  (stmt,5,currentDatetime.c_str(),-1,NULL),db);
+std::vector<struct DataPoint> readDataPointsFromDB(const char * filename, std::string & timeCreated){
+    std::vector<struct DataPoint> data;
 
-        // Execute Statement.
-        SQLite3_CHECK(sqlite3_step(stmt),db);
+    // The table doesn't exist until the training program writes points.
+    DatabaseService & database = DatabaseService::forFile(filename);
+    database.enqueue({{CREATE_TRAINING_TABLE_QUERY, {}}});
+    DatabaseSession session = database.session();
+    sqlite3 *db = session.db();
 
-        // Reset Statement to use again.
-        SQLite3_CHECK(sqlite3_reset(stmt),db);
+    // Get the most recent time points were written.
+    sqlite3_stmt * stmt = session.statement(SELECT_TRAINING_TIMES_QUERY);
+    if(SQLite3_CHECK(sqlite3_step(stmt),db) != SQLITE_ROW){
+        return data;
     }
-    // Finalize the statement.
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+    timeCreated = reinterpret_cast<const char*>(sqlite3_column_text(stmt,0));
 
-    // End the transaction.
-    SQLite3_CHECK(sqlite3_prepare_v2(db,"END TRANSACTION",-1,&stmt,NULL),db);
-    SQLite3_CHECK(sqlite3_step(stmt),db);
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
-
-    // Close the database file.
-    SQLite3_CHECK(sqlite3_close(db),db);
-}
\ No newline at end of file
+    // Read every point written at that time.
+    stmt = session.statement(SELECT_TRAINING_QUERY);
+    SQLite3_CHECK(sqlite3_bind_text(stmt,1,timeCreated.c_str(),-1,NULL),db);
+    while(SQLite3_CHECK(sqlite3_step(stmt),db) == SQLITE_ROW){
+        struct DataPoint point;
+        point.x   = sqlite3_column_int   (stmt,0);
+        point.y   = sqlite3_column_int   (stmt,1);
+        point.L45 = sqlite3_column_double(stmt,2);
+        point.L90 = sqlite3_column_double(stmt,3);
+        data.push_back(point);
+    }
+    return data;
+}
@@ -23,13 +23,37 @@
 
 // Include files for SQLite
 #include <sqlite3.h>
-#include "main_training.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Used for checking SQLite3 errors.
+#include "errorCheckingMacros.h"
+#include "DatabaseService.h"
 
 // SQL Queries
 #define CREATE_TRAINING_TABLE_QUERY "CREATE TABLE IF NOT EXISTS 'trainingData' ('x' INTEGER, 'y' INTEGER, 'L45' REAL, 'L90' REAL, 'timeCreated' TEXT);"
 #define INSERT_TRAINING_TABLE_QUERY "INSERT INTO  'trainingData' VALUES (?,?,?,?,?);"
+#define SELECT_TRAINING_TIMES_QUERY "SELECT DISTINCT timeCreated FROM 'trainingData' ORDER BY timeCreated DESC;"
+#define SELECT_TRAINING_QUERY "SELECT x, y, L45, L90 FROM 'trainingData' WHERE timeCreated=?;"
+
+// Used for storing calibration datapoints.
+struct DataPoint
+{
+    uint32_t x;
+    uint32_t y;
+    float L45;
+    float L90;
+};
 
 // Function Definition for writing data points to an SQLite file.
 void writeDataPointsToDB(std::vector<struct DataPoint> & data, const char * filename);
 
+// The rows writeDataPointsToDB writes, creating the table first, for committing with other rows.
+std::vector<DatabaseRow> dataPointRows(const std::vector<struct DataPoint> & data, const std::string & timeCreated);
+
+// Read the most recently collected data points from an SQLite file and set timeCreated to when they were collected.
+// Returns no points when the file has no training data.
+std::vector<struct DataPoint> readDataPointsFromDB(const char * filename, std::string & timeCreated);
+
 #endif //UNTITLED_SQLITEFUNCTIONS_H
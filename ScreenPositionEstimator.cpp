@@ -19,87 +19,143 @@
 // along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "ScreenPositionEstimator.h"
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include "DatabaseService.h"
 
 std::tuple<uint32_t,uint32_t> ScreenPositionEstimator::estimatePosition(double s0, double s1) {
-    // Zero order terms
-    // First order terms
-    // Second order terms
-    // Third order terms
-    // Fourth order terms
-    uint32_t y = y_1                 + \
-                 y_L45*s0            + y_L90*s1                + \
-                 y_L45_2*s0*s0       + y_L45_L90*s0*s1         + y_L90_2*s1*s1             + \
-                 y_L45_3*s0*s0*s0    + y_L45_2_L90*s0*s0*s1    + y_L45_L90_2*s0*s1*s1      + y_L90_3*s1*s1*s1        + \
-                 y_L45_4*s0*s0*s0*s0 + y_L45_3_L90*s0*s0*s0*s1 + y_L45_2_L90_2*s0*s0*s1*s1 + y_L45_L90_3*s0*s1*s1*s1 + y_L90_4*s1*s1*s1*s1;
-
-    uint32_t x = x_1                 + \
-                 x_L45*s0            + x_L90*s1                + \
-                 x_L45_2*s0*s0       + x_L45_L90*s0*s1         + x_L90_2*s1*s1             + \
-                 x_L45_3*s0*s0*s0    + x_L45_2_L90*s0*s0*s1    + x_L45_L90_2*s0*s1*s1      + x_L90_3*s1*s1*s1        + \
-                 x_L45_4*s0*s0*s0*s0 + x_L45_3_L90*s0*s0*s0*s1 + x_L45_2_L90_2*s0*s0*s1*s1 + x_L45_L90_3*s0*s1*s1*s1 + x_L90_4*s1*s1*s1*s1;
-
+    // The table only covers the first PIXELS_PER_LINE pixels of each camera. The rest use the polynomials.
+    if(lookupTable.ready() && lookupTable.covers(s0, s1)){
+        double x, y;
+        lookupTable.lookup(s0, s1, x, y);
+        return std::make_tuple((uint32_t) x, (uint32_t) y);
+    }
+    uint32_t x = xPolynomial.evaluate(s0, s1);
+    uint32_t y = yPolynomial.evaluate(s0, s1);
     return std::make_tuple(x,y);
 }
 
-void ScreenPositionEstimator::loadCoefficients(const char *filename) {
-    // Open the database file.
-    sqlite3 *db;
-    SQLite3_CHECK(sqlite3_open(filename, &db),db);
+// Both polynomials are evaluated for a block of points while the block is in cache.
+static inline void estimateBlocks(const BivariatePolynomial<COEFFICIENTS_DEGREE> & xPolynomial,
+                                  const BivariatePolynomial<COEFFICIENTS_DEGREE> & yPolynomial,
+                                  const double * s0, const double * s1, size_t blocks, double * x, double * y){
+    for(size_t n = 0; n < blocks*POLYNOMIAL_BATCH_LANES; n += POLYNOMIAL_BATCH_LANES){
+        xPolynomial.evaluateBlock(s0 + n, s1 + n, x + n);
+        yPolynomial.evaluateBlock(s0 + n, s1 + n, y + n);
+    }
+}
 
-    // Generate an SQL statement to get all the times coefficients have been written to a database file.
-    sqlite3_stmt *stmt;
-    SQLite3_CHECK(sqlite3_prepare_v2(db,DISTICT_COEFFICIENTS_STATEMENT,-1,&stmt,NULL),db);
+__attribute__((target("avx2")))
+static void estimateBlocksAVX2(const BivariatePolynomial<COEFFICIENTS_DEGREE> & xPolynomial,
+                               const BivariatePolynomial<COEFFICIENTS_DEGREE> & yPolynomial,
+                               const double * s0, const double * s1, size_t blocks, double * x, double * y){
+    estimateBlocks(xPolynomial, yPolynomial, s0, s1, blocks, x, y);
+}
+
+void ScreenPositionEstimator::estimateBatch(const double * s0, const double * s1, size_t count, double * x, double * y) {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    size_t blocks = count / POLYNOMIAL_BATCH_LANES;
+    if(avx2){
+        estimateBlocksAVX2(xPolynomial, yPolynomial, s0, s1, blocks, x, y);
+    }
+    else{
+        estimateBlocks(xPolynomial, yPolynomial, s0, s1, blocks, x, y);
+    }
+
+    // The points left over after the last full block.
+    for(size_t n = blocks*POLYNOMIAL_BATCH_LANES; n < count; n++){
+        x[n] = xPolynomial.evaluate(s0[n], s1[n]);
+        y[n] = yPolynomial.evaluate(s0[n], s1[n]);
+    }
+}
+
+void ScreenPositionEstimator::useLookupTable(uint32_t stride) {
+    lookupStride = stride;
+}
+
+void ScreenPositionEstimator::setCoefficients(const double * xCoefficients, const double * yCoefficients) {
+    // A table built from the old coefficients no longer matches.
+    lookupTable = PositionLookupTable();
+    timeCreated.clear();
+    xPolynomial.setCoefficients(xCoefficients);
+    yPolynomial.setCoefficients(yCoefficients);
+}
+
+void ScreenPositionEstimator::estimatePositions(const double * s0, uint32_t n0, const double * s1, uint32_t n1,
+                                                 std::tuple<uint32_t,uint32_t> * positions) {
+    for(uint32_t i = 0; i < n0; i++){
+        for(uint32_t j = 0; j < n1; j++){
+            positions[i*n1 + j] = estimatePosition(s0[i], s1[j]);
+        }
+    }
+}
+
+std::string latestCoefficientsTime(const char * filename) {
+    DatabaseSession session = DatabaseService::forFile(filename).session();
+    sqlite3 *db = session.db();
+
+    // Get all the times coefficients have been written to the database file.
+    sqlite3_stmt *stmt = session.statement(DISTICT_COEFFICIENTS_STATEMENT);
 
     // Get the most recent time.
-    SQLite3_CHECK(sqlite3_step(stmt),db);
-    std::string mostRecentTime = std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt,0)));
+    std::string mostRecentTime;
+    if(SQLite3_CHECK(sqlite3_step(stmt),db) == SQLITE_ROW){
+        mostRecentTime = std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt,0)));
+    }
 
-    // Cleanup that statement.
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+    return mostRecentTime;
+}
+
+std::string readCoefficientsFromDB(const char * filename, double * xCoefficients, double * yCoefficients) {
+    std::string mostRecentTime = latestCoefficientsTime(filename);
+    if(mostRecentTime.empty()){
+        std::cerr << "There are no coefficients in " << filename << ". Run the training program first. Aborting." << std::endl;
+        std::abort();
+    }
 
-    // Prepare the statement for loading coefficients.
-    SQLite3_CHECK(sqlite3_prepare_v2(db,SELECT_COEFFICIENTS,-1,&stmt,NULL),db);
+    DatabaseSession session = DatabaseService::forFile(filename).session();
+    sqlite3 *db = session.db();
+    sqlite3_stmt *stmt = session.statement(SELECT_COEFFICIENTS);
     SQLite3_CHECK(sqlite3_bind_text(stmt,1,mostRecentTime.c_str(),-1,NULL),db);
 
     // Execute the statement.
     SQLite3_CHECK(sqlite3_step(stmt),db);
 
-    // Load the coefficients.
-    x_1           = sqlite3_column_double(stmt,0);
-    x_L45         = sqlite3_column_double(stmt,1);
-    x_L90         = sqlite3_column_double(stmt,2);
-    x_L45_2       = sqlite3_column_double(stmt,3);
-    x_L45_L90     = sqlite3_column_double(stmt,4);
-    x_L90_2       = sqlite3_column_double(stmt,5);
-    x_L45_3       = sqlite3_column_double(stmt,6);
-    x_L45_2_L90   = sqlite3_column_double(stmt,7);
-    x_L45_L90_2   = sqlite3_column_double(stmt,8);
-    x_L90_3       = sqlite3_column_double(stmt,9);
-    x_L45_4       = sqlite3_column_double(stmt,10);
-    x_L45_3_L90   = sqlite3_column_double(stmt,11);
-    x_L45_2_L90_2 = sqlite3_column_double(stmt,12);
-    x_L45_L90_3   = sqlite3_column_double(stmt,13);
-    x_L90_4       = sqlite3_column_double(stmt,14);
-    y_1           = sqlite3_column_double(stmt,15);
-    y_L45         = sqlite3_column_double(stmt,16);
-    y_L90         = sqlite3_column_double(stmt,17);
-    y_L45_2       = sqlite3_column_double(stmt,18);
-    y_L45_L90     = sqlite3_column_double(stmt,19);
-    y_L90_2       = sqlite3_column_double(stmt,20);
-    y_L45_3       = sqlite3_column_double(stmt,21);
-    y_L45_2_L90   = sqlite3_column_double(stmt,22);
-    y_L45_L90_2   = sqlite3_column_double(stmt,23);
-    y_L90_3       = sqlite3_column_double(stmt,24);
-    y_L45_4       = sqlite3_column_double(stmt,25);
-    y_L45_3_L90   = sqlite3_column_double(stmt,26);
-    y_L45_2_L90_2 = sqlite3_column_double(stmt,27);
-    y_L45_L90_3   = sqlite3_column_double(stmt,28);
-    y_L90_4       = sqlite3_column_double(stmt,29);
-
-    // Cleanup the statement.
-    SQLite3_CHECK(sqlite3_finalize(stmt),db);
-
-    // Close the database file.
-    SQLite3_CHECK(sqlite3_close(db),db);
+    // Load the coefficients. The columns are in the order BivariatePolynomial takes them, x and then y.
+    for(int i = 0; i < NUM_COEFFICIENTS; i++){
+        xCoefficients[i] = sqlite3_column_double(stmt,i);
+        yCoefficients[i] = sqlite3_column_double(stmt,NUM_COEFFICIENTS + i);
+    }
+    return mostRecentTime;
+}
+
+void ScreenPositionEstimator::loadCoefficients(const char *filename) {
+    // The session reading the coefficients ends before the lookup table is built.
+    double xCoefficients[NUM_COEFFICIENTS];
+    double yCoefficients[NUM_COEFFICIENTS];
+    std::string mostRecentTime = readCoefficientsFromDB(filename, xCoefficients, yCoefficients);
+    useCoefficients(xCoefficients, yCoefficients, mostRecentTime, filename);
+}
+
+void ScreenPositionEstimator::useCoefficients(const double * xCoefficients, const double * yCoefficients,
+                                              const std::string & mostRecentTime, const char * filename) {
+    setCoefficients(xCoefficients, yCoefficients);
+    timeCreated = mostRecentTime;
+
+    if(lookupStride > 0){
+        // Cache the table next to the database, named by when the coefficients were created.
+        std::string directory = filename;
+        size_t slash = directory.find_last_of('/');
+        directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+        std::string name = mostRecentTime;
+        for(char & c : name) if(!isalnum((unsigned char) c)) c = '-';
+        std::string cachePath = directory + "positionLUT_" + name + "_" + std::to_string(lookupStride) + ".bin";
+
+        double coefficients[2*NUM_COEFFICIENTS];
+        std::copy(xCoefficients, xCoefficients + NUM_COEFFICIENTS, coefficients);
+        std::copy(yCoefficients, yCoefficients + NUM_COEFFICIENTS, coefficients + NUM_COEFFICIENTS);
+        lookupTable.buildCached(*this, lookupStride, cachePath, coefficients, 2*NUM_COEFFICIENTS);
+    }
 }
 
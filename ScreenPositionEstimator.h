@@ -21,54 +21,84 @@
 #ifndef UNTITLED_SCREENPOSITIONESTIMATOR_H
 #define UNTITLED_SCREENPOSITIONESTIMATOR_H
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
 #include <tuple>
-#include "globals.h"
+#include "BivariatePolynomial.h"
+#include "PositionLookupTable.h"
+#include "errorCheckingMacros.h"
 
 #define SELECT_COEFFICIENTS "SELECT \
 x_1,x_L45,x_L90,x_L45_2,x_L45_L90,x_L90_2,x_L45_3,x_L45_2_L90,x_L45_L90_2,x_L90_3,x_L45_4,x_L45_3_L90,x_L45_2_L90_2,x_L45_L90_3,x_L90_4, \
 y_1,y_L45,y_L90,y_L45_2,y_L45_L90,y_L90_2,y_L45_3,y_L45_2_L90,y_L45_L90_2,y_L90_3,y_L45_4,y_L45_3_L90,y_L45_2_L90_2,y_L45_L90_3,y_L90_4  \
 FROM coefficients WHERE timeCreated=?;"
 
+// Matches the coefficients table written by regression_fitting.py.
+#define CREATE_COEFFICIENTS_TABLE_STATEMENT "CREATE TABLE IF NOT EXISTS coefficients ( \
+x_1 REAL, x_L45 REAL, x_L90 REAL, x_L45_2 REAL, x_L45_L90 REAL, x_L90_2 REAL, x_L45_3 REAL, x_L45_2_L90 REAL, x_L45_L90_2 REAL, x_L90_3 REAL, x_L45_4 REAL, x_L45_3_L90 REAL, x_L45_2_L90_2 REAL, x_L45_L90_3 REAL, x_L90_4 REAL, \
+y_1 REAL, y_L45 REAL, y_L90 REAL, y_L45_2 REAL, y_L45_L90 REAL, y_L90_2 REAL, y_L45_3 REAL, y_L45_2_L90 REAL, y_L45_L90_2 REAL, y_L90_3 REAL, y_L45_4 REAL, y_L45_3_L90 REAL, y_L45_2_L90_2 REAL, y_L45_L90_3 REAL, y_L90_4 REAL, \
+'timeCreated' TEXT );"
+
+#define INSERT_COEFFICIENTS_STATEMENT "INSERT INTO coefficients VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);"
+
+// Degree of the polynomials stored in the coefficients table.
+#define COEFFICIENTS_DEGREE 4
+
+// Number of coefficients for each of x and y in a fourth order polynomial of the two camera pixels.
+#define NUM_COEFFICIENTS 15
+static_assert(NUM_COEFFICIENTS == BivariatePolynomial<COEFFICIENTS_DEGREE>::NUM_TERMS, "The coefficients table doesn't match its degree.");
+
 #define DISTICT_COEFFICIENTS_STATEMENT "SELECT DISTINCT timeCreated FROM coefficients ORDER BY timeCreated DESC;"
 
+// Time the newest coefficients in an SQLite3 file were created, or an empty string if there aren't any.
+std::string latestCoefficientsTime(const char * filename);
+
+// Read the newest coefficients in an SQLite3 file, in the column order of the coefficients table.
+// Returns the time they were created. Aborts if there aren't any.
+std::string readCoefficientsFromDB(const char * filename, double * xCoefficients, double * yCoefficients);
+
+// Screen position from the pixels blocked in both cameras.
+// x and y are each a polynomial of the L45 and L90 pixels, with coefficients fitted by regression_fitting.py.
 class ScreenPositionEstimator {
 private:
-    double x_1;
-    double x_L45;
-    double x_L90;
-    double x_L45_2;
-    double x_L45_L90;
-    double x_L90_2;
-    double x_L45_3;
-    double x_L45_2_L90;
-    double x_L45_L90_2;
-    double x_L90_3;
-    double x_L45_4;
-    double x_L45_3_L90;
-    double x_L45_2_L90_2;
-    double x_L45_L90_3;
-    double x_L90_4;
-    double y_1;
-    double y_L45;
-    double y_L90;
-    double y_L45_2;
-    double y_L45_L90;
-    double y_L90_2;
-    double y_L45_3;
-    double y_L45_2_L90;
-    double y_L45_L90_2;
-    double y_L90_3;
-    double y_L45_4;
-    double y_L45_3_L90;
-    double y_L45_2_L90_2;
-    double y_L45_L90_3;
-    double y_L90_4;
+    BivariatePolynomial<COEFFICIENTS_DEGREE> xPolynomial;
+    BivariatePolynomial<COEFFICIENTS_DEGREE> yPolynomial;
+    // Answers estimatePosition instead of the polynomials when lookupStride isn't 0.
+    uint32_t lookupStride = 0;
+    PositionLookupTable lookupTable;
+    // When the coefficients in use were created. Empty when they were set directly.
+    std::string timeCreated;
 public:
+    // Answer estimatePosition from a table with a point every stride pixels, built when the coefficients are loaded.
+    // The table is cached next to the SQLite3 file by the time the coefficients were created.
+    // Must be called before loadCoefficients. A stride of 0 evaluates the polynomials for every estimate.
+    void useLookupTable(uint32_t stride);
+
     // Load the coefficients from an SQLite3 file.
     void loadCoefficients(const char * filename);
 
-    // Estimate the point using a polynomial approximation and pixel values.
-    std::tuple<uint32_t,uint32_t> estimatePosition(double s0 = pixelCamera0, double s1 = pixelCamera1);
+    // Use coefficients created at timeCreated that were read from filename some other way, as loadCoefficients would.
+    void useCoefficients(const double * xCoefficients, const double * yCoefficients, const std::string & timeCreated,
+                         const char * filename);
+
+    // Set the coefficients directly, in the column order of the coefficients table.
+    void setCoefficients(const double * xCoefficients, const double * yCoefficients);
+
+    // When the coefficients loaded by loadCoefficients were created.
+    const std::string & coefficientsTime() const { return timeCreated; }
+
+    // Estimate the point using a polynomial approximation and pixel values, or the lookup table when there is one.
+    std::tuple<uint32_t,uint32_t> estimatePosition(double s0, double s1);
+
+    // Estimate count points at once from arrays of L45 (s0) and L90 (s1) pixels.
+    // Uses AVX2 when the processor supports it. Meant for reprocessing recorded data and validating a calibration.
+    void estimateBatch(const double * s0, const double * s1, size_t count, double * x, double * y);
+
+    // Estimate the point for every pairing of a camera 0 pixel with a camera 1 pixel.
+    // positions[i*n1 + j] is the estimate for s0[i] and s1[j] and must hold n0*n1 points.
+    // Used when a camera sees more than one object and it isn't known which of the other camera's objects is the same one.
+    void estimatePositions(const double * s0, uint32_t n0, const double * s1, uint32_t n1, std::tuple<uint32_t,uint32_t> * positions);
 };
 
 
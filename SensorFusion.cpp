@@ -0,0 +1,297 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "SensorFusion.h"
+#include "DatabaseService.h"
+#include "camerasettings.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+// Relative size of a pivot below which the training points don't determine the fit.
+#define RANK_TOLERANCE 1e-12
+
+// Least angleRms used to weight a sensor, so a line fitted to perfect points doesn't get every bit of the weight.
+#define SENSOR_LINE_MIN_ANGLE_RMS 1e-4
+
+// Lines closer to parallel than this, as the squared sine of the angle between them, don't give a position.
+#define PARALLEL_TOLERANCE 1e-6
+
+// Sensors estimatePosition can use at once.
+#define SENSOR_FUSION_MAX_SENSORS 16
+
+bool sensorLinesFromEnvironment(){
+    const char * value = getenv(POSITION_MODEL_ENV);
+    if(value == NULL || strcmp(value, "polynomial") == 0) return false;
+    if(strcmp(value, "lines") == 0) return true;
+    throw std::runtime_error(std::string("Unknown ") + POSITION_MODEL_ENV + " \"" + value + "\".");
+}
+
+// Solve the normal equations m x = v of a least squares fit with n unknowns by a Cholesky decomposition.
+// m is row major and overwritten. Returns false when the fit doesn't determine every unknown.
+static bool solveNormalEquations(double * m, double * v, int n, double * x){
+    double largest = 0;
+    for(int k = 0; k < n; k++) largest = std::max(largest, m[k*n + k]);
+    for(int k = 0; k < n; k++){
+        double pivot = m[k*n + k];
+        for(int j = 0; j < k; j++) pivot -= m[k*n + j] * m[k*n + j];
+        if(pivot <= RANK_TOLERANCE * largest) return false;
+        pivot = std::sqrt(pivot);
+        m[k*n + k] = pivot;
+        for(int i = k + 1; i < n; i++){
+            double sum = m[i*n + k];
+            for(int j = 0; j < k; j++) sum -= m[i*n + j] * m[k*n + j];
+            m[i*n + k] = sum / pivot;
+        }
+    }
+    // Forward substitution with L, then back substitution with L transpose.
+    for(int i = 0; i < n; i++){
+        double sum = v[i];
+        for(int j = 0; j < i; j++) sum -= m[i*n + j] * x[j];
+        x[i] = sum / m[i*n + i];
+    }
+    for(int i = n - 1; i >= 0; i--){
+        double sum = x[i];
+        for(int j = i + 1; j < n; j++) sum -= m[j*n + i] * x[j];
+        x[i] = sum / m[i*n + i];
+    }
+    return true;
+}
+
+SensorLine fitSensorLine(const std::vector<SensorSample> & samples){
+    const size_t n = samples.size();
+    if(n < SENSOR_LINE_MIN_POINTS){
+        throw std::runtime_error("At least " + std::to_string(SENSOR_LINE_MIN_POINTS) + " training points are needed for a sensor's line. There are "
+                                 + std::to_string(n) + ".");
+    }
+
+    // Move the points to around the origin at about unit distance, and the pixels to about -1 to 1.
+    double meanX = 0, meanY = 0, meanPixel = 0;
+    for(const SensorSample & sample : samples){
+        meanX += sample.x;
+        meanY += sample.y;
+        meanPixel += sample.pixel;
+    }
+    meanX /= n;
+    meanY /= n;
+    meanPixel /= n;
+    double spread = 0, pixelSpread = 0;
+    for(const SensorSample & sample : samples){
+        spread += (sample.x - meanX) * (sample.x - meanX) + (sample.y - meanY) * (sample.y - meanY);
+        pixelSpread += (sample.pixel - meanPixel) * (sample.pixel - meanPixel);
+    }
+    spread = std::sqrt(spread / n);
+    pixelSpread = std::sqrt(pixelSpread / n);
+    if(spread == 0 || pixelSpread == 0){
+        throw std::runtime_error("The training points don't determine the sensor's line. Collect points across the whole screen.");
+    }
+
+    // A projective camera with one pixel coordinate sees q = (c x + d y + e) / (a x + b y + 1).
+    // Multiplied out it's linear in a to e: q = -a q x - b q y + c x + d y + e.
+    double m[5*5] = {}, v[5] = {}, p[5];
+    for(const SensorSample & sample : samples){
+        double x = (sample.x - meanX) / spread;
+        double y = (sample.y - meanY) / spread;
+        double q = (sample.pixel - meanPixel) / pixelSpread;
+        double row[5] = {-q * x, -q * y, x, y, 1};
+        for(int i = 0; i < 5; i++){
+            for(int j = 0; j < 5; j++) m[i*5 + j] += row[i] * row[j];
+            v[i] += row[i] * q;
+        }
+    }
+    if(!solveNormalEquations(m, v, 5, p)){
+        throw std::runtime_error("The training points don't determine the sensor's line. Collect points across the whole screen.");
+    }
+
+    // Every pixel's line (c - q a) x + (d - q b) y + (e - q) = 0 passes through the point that's on both
+    // (c, d, e) and (a, b, 1), their cross product.
+    double centerX = p[3] - p[4] * p[1];
+    double centerY = p[4] * p[0] - p[2];
+    double centerW = p[2] * p[1] - p[3] * p[0];
+    if(std::fabs(centerW) <= RANK_TOLERANCE * (std::fabs(centerX) + std::fabs(centerY))){
+        throw std::runtime_error("The training points don't show where the sensor is. Collect points across the whole screen.");
+    }
+    SensorLine line;
+    line.centerX = centerX / centerW * spread + meanX;
+    line.centerY = centerY / centerW * spread + meanY;
+
+    // Angles seen from the center, measured from their mean direction so none of them wrap around.
+    std::vector<double> angles(n);
+    double sumCos = 0, sumSin = 0;
+    for(size_t i = 0; i < n; i++){
+        angles[i] = std::atan2(samples[i].y - line.centerY, samples[i].x - line.centerX);
+        sumCos += std::cos(angles[i]);
+        sumSin += std::sin(angles[i]);
+    }
+    double meanAngle = std::atan2(sumSin, sumCos);
+    for(double & angle : angles) angle = std::remainder(angle - meanAngle, 2 * M_PI);
+
+    // Least squares fit of the angle to a polynomial of the pixel scaled to 0-1, then scaled back.
+    const int terms = SENSOR_LINE_DEGREE + 1;
+    double a[terms*terms] = {}, b[terms] = {};
+    for(size_t i = 0; i < n; i++){
+        double u = samples[i].pixel / PIXELS_PER_LINE;
+        double powers[terms];
+        powers[0] = 1;
+        for(int k = 1; k < terms; k++) powers[k] = powers[k - 1] * u;
+        for(int r = 0; r < terms; r++){
+            for(int c = 0; c < terms; c++) a[r*terms + c] += powers[r] * powers[c];
+            b[r] += powers[r] * angles[i];
+        }
+    }
+    if(!solveNormalEquations(a, b, terms, line.angle)){
+        throw std::runtime_error("The training points don't determine the sensor's line. Collect points across the whole screen.");
+    }
+    for(int k = 0; k < terms; k++) line.angle[k] /= std::pow((double) PIXELS_PER_LINE, k);
+    line.angle[0] += meanAngle;
+
+    double sum = 0;
+    for(size_t i = 0; i < n; i++){
+        double error = std::remainder(line.angleAt(samples[i].pixel) - meanAngle - angles[i], 2 * M_PI);
+        sum += error * error;
+    }
+    line.angleRms = std::sqrt(sum / n);
+    line.points = n;
+    return line;
+}
+
+std::string writeSensorLinesToDB(const std::vector<std::string> & names, const std::vector<SensorLine> & lines,
+                                 const char * filename){
+    std::string currentDatetime = localDatetime();
+    std::vector<DatabaseRow> rows = {{CREATE_SENSOR_LINES_TABLE_STATEMENT, {}}};
+    for(size_t i = 0; i < lines.size() && i < names.size(); i++){
+        const SensorLine & line = lines[i];
+        if(line.points == 0) continue;
+        DatabaseRow row = {INSERT_SENSOR_LINE_STATEMENT, {names[i], line.centerX, line.centerY}};
+        for(double angle : line.angle) row.values.push_back(angle);
+        row.values.push_back(line.angleRms);
+        row.values.push_back((int64_t) line.points);
+        row.values.push_back(currentDatetime);
+        rows.push_back(std::move(row));
+    }
+    DatabaseService::forFile(filename).enqueue(std::move(rows));
+    return currentDatetime;
+}
+
+std::string latestSensorLinesTime(const char * filename){
+    // The table doesn't exist until calibrate or the training program writes lines.
+    DatabaseService & database = DatabaseService::forFile(filename);
+    database.enqueue({{CREATE_SENSOR_LINES_TABLE_STATEMENT, {}}});
+    DatabaseSession session = database.session();
+    sqlite3 *db = session.db();
+
+    sqlite3_stmt *stmt = session.statement(SELECT_SENSOR_LINES_TIMES_STATEMENT);
+    std::string mostRecentTime;
+    if(SQLite3_CHECK(sqlite3_step(stmt),db) == SQLITE_ROW){
+        mostRecentTime = std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt,0)));
+    }
+    return mostRecentTime;
+}
+
+void SensorFusionEstimator::setSensorLine(uint32_t sensor, const SensorLine & line){
+    if(sensor >= lines.size()) lines.resize(sensor + 1);
+    lines[sensor] = line;
+    timeCreated.clear();
+}
+
+bool SensorFusionEstimator::calibrated(uint32_t sensor) const{
+    return sensor < lines.size() && lines[sensor].points > 0;
+}
+
+void SensorFusionEstimator::loadSensorLines(const char * filename, const std::vector<std::string> & names){
+    std::string mostRecentTime = latestSensorLinesTime(filename);
+    if(mostRecentTime.empty()){
+        throw std::runtime_error(std::string("There are no sensor lines in ") + filename + ". Run calibrate or the training program first.");
+    }
+
+    std::vector<SensorLine> loaded(names.size());
+    bool any = false;
+    {
+        DatabaseSession session = DatabaseService::forFile(filename).session();
+        sqlite3 *db = session.db();
+        sqlite3_stmt *stmt = session.statement(SELECT_SENSOR_LINES_STATEMENT);
+        SQLite3_CHECK(sqlite3_bind_text(stmt,1,mostRecentTime.c_str(),-1,NULL),db);
+        while(SQLite3_CHECK(sqlite3_step(stmt),db) == SQLITE_ROW){
+            std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt,0));
+            auto found = std::find(names.begin(), names.end(), name);
+            if(found == names.end()) continue;
+            SensorLine & line = loaded[found - names.begin()];
+            line.centerX = sqlite3_column_double(stmt,1);
+            line.centerY = sqlite3_column_double(stmt,2);
+            for(int k = 0; k <= SENSOR_LINE_DEGREE; k++) line.angle[k] = sqlite3_column_double(stmt,3 + k);
+            line.angleRms = sqlite3_column_double(stmt,4 + SENSOR_LINE_DEGREE);
+            line.points = sqlite3_column_int64(stmt,5 + SENSOR_LINE_DEGREE);
+            any = any || line.points > 0;
+        }
+    }
+    if(!any){
+        throw std::runtime_error(std::string("None of the cameras have sensor lines created ") + mostRecentTime + " in " + filename + ".");
+    }
+    lines = std::move(loaded);
+    timeCreated = mostRecentTime;
+}
+
+bool SensorFusionEstimator::estimatePosition(const double * pixels, uint32_t count, double & x, double & y) const{
+    // Each line is nx x + ny y = d with (nx, ny) its unit normal.
+    struct Line { double nx, ny, d, centerX, centerY, sigma; };
+    Line used[SENSOR_FUSION_MAX_SENSORS];
+    uint32_t usedCount = 0;
+    uint32_t sensors = std::min({count, (uint32_t) lines.size(), (uint32_t) SENSOR_FUSION_MAX_SENSORS});
+    for(uint32_t i = 0; i < sensors; i++){
+        const SensorLine & line = lines[i];
+        if(line.points == 0 || std::isnan(pixels[i])) continue;
+        double angle = line.angleAt(pixels[i]);
+        Line & l = used[usedCount++];
+        l.nx = -std::sin(angle);
+        l.ny = std::cos(angle);
+        l.d = l.nx * line.centerX + l.ny * line.centerY;
+        l.centerX = line.centerX;
+        l.centerY = line.centerY;
+        l.sigma = std::max(line.angleRms, SENSOR_LINE_MIN_ANGLE_RMS);
+    }
+    if(usedCount < 2) return false;
+
+    // Minimize the weighted sum of squared distances to the lines. The first pass weights each line by its
+    // angular error alone. The second scales that by the distance from its sensor to the first estimate,
+    // which is how far the line can be off there.
+    for(int pass = 0; pass < 2; pass++){
+        double a11 = 0, a12 = 0, a22 = 0, b1 = 0, b2 = 0;
+        for(uint32_t i = 0; i < usedCount; i++){
+            const Line & l = used[i];
+            double sigma = l.sigma;
+            if(pass > 0) sigma *= std::max(std::hypot(x - l.centerX, y - l.centerY), 1.0);
+            double w = 1 / (sigma * sigma);
+            a11 += w * l.nx * l.nx;
+            a12 += w * l.nx * l.ny;
+            a22 += w * l.ny * l.ny;
+            b1 += w * l.nx * l.d;
+            b2 += w * l.ny * l.d;
+        }
+        double determinant = a11 * a22 - a12 * a12;
+        double trace = a11 + a22;
+        if(determinant <= PARALLEL_TOLERANCE * trace * trace) return false;
+        x = (a22 * b1 - a12 * b2) / determinant;
+        y = (a11 * b2 - a12 * b1) / determinant;
+    }
+    return true;
+}
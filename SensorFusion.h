@@ -0,0 +1,129 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_SENSORFUSION_H
+#define UNTITLED_SENSORFUSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Environment variable read by sensorLinesFromEnvironment.
+// "polynomial" estimates positions with the coefficients table. This is the default.
+// "lines" intersects the line each camera's pixel falls on, from the sensorLines table.
+#define POSITION_MODEL_ENV "LSAD_POSITION_MODEL"
+
+// Degree of the polynomial giving the angle of a sensor's line from its pixel.
+// 1 is an ideal lens. The higher terms follow the lens distortion.
+#define SENSOR_LINE_DEGREE 3
+
+// Fewest training points a sensor's line is fitted to.
+#define SENSOR_LINE_MIN_POINTS 8
+
+// One row per camera. The angle coefficients are for the unscaled pixel, from the constant term up.
+#define CREATE_SENSOR_LINES_TABLE_STATEMENT "CREATE TABLE IF NOT EXISTS sensorLines ( \
+cameraName TEXT, centerX REAL, centerY REAL, angle_0 REAL, angle_1 REAL, angle_2 REAL, angle_3 REAL, \
+angleRms REAL, points INTEGER, timeCreated TEXT );"
+
+#define INSERT_SENSOR_LINE_STATEMENT "INSERT INTO sensorLines VALUES(?,?,?,?,?,?,?,?,?,?);"
+
+#define SELECT_SENSOR_LINES_TIMES_STATEMENT "SELECT DISTINCT timeCreated FROM sensorLines ORDER BY timeCreated DESC;"
+
+#define SELECT_SENSOR_LINES_STATEMENT "SELECT cameraName,centerX,centerY,angle_0,angle_1,angle_2,angle_3,angleRms,points \
+FROM sensorLines WHERE timeCreated=?;"
+
+static_assert(SENSOR_LINE_DEGREE == 3, "The sensorLines table doesn't match the degree of the angle polynomial.");
+
+// True when POSITION_MODEL_ENV asks for the sensor lines. Throws on a model it doesn't know.
+bool sensorLinesFromEnvironment();
+
+// A training point seen by one sensor.
+struct SensorSample
+{
+    double pixel;
+    double x;
+    double y;
+};
+
+// Where on the screen a line sensor's pixel can be. Every pixel sees along a line through the sensor's center,
+// the point on the screen the lens looks out from, at an angle that's a polynomial of the pixel.
+struct SensorLine
+{
+    double centerX = 0;
+    double centerY = 0;
+    // Radians from the screen's x axis.
+    double angle[SENSOR_LINE_DEGREE + 1] = {};
+    // Root mean square difference between the training points' angles and the fitted ones, in radians.
+    double angleRms = 0;
+    // Training points the line was fitted to. 0 when the sensor isn't calibrated.
+    size_t points = 0;
+
+    double angleAt(double pixel) const {
+        double result = angle[SENSOR_LINE_DEGREE];
+        for(int k = SENSOR_LINE_DEGREE - 1; k >= 0; k--) result = result * pixel + angle[k];
+        return result;
+    }
+};
+
+// Fit a sensor's line to its training points. The center is found from a projective fit of the pixels first,
+// then the angle polynomial is a least squares fit of the angles seen from it.
+// Throws if there are fewer than SENSOR_LINE_MIN_POINTS or they don't determine the line.
+SensorLine fitSensorLine(const std::vector<SensorSample> & samples);
+
+// Add a row for each calibrated sensor to the sensorLines table of an SQLite file and return their timeCreated.
+// names[i] is the camera lines[i] was fitted for.
+std::string writeSensorLinesToDB(const std::vector<std::string> & names, const std::vector<SensorLine> & lines,
+                                 const char * filename);
+
+// Time the newest sensor lines in an SQLite3 file were created, or an empty string if there aren't any.
+std::string latestSensorLinesTime(const char * filename);
+
+// Screen position from any number of line sensors.
+// Each sensor's pixel puts the impact on a line. The position is the weighted least squares intersection of the lines,
+// each weighted by how far its sensor's calibration can be off at that distance, so a sensor looking at the impact
+// edge on or from far away counts for less. A sensor without a reading or a calibration is left out.
+class SensorFusionEstimator {
+private:
+    // Indexed by camera number.
+    std::vector<SensorLine> lines;
+    // When the lines in use were created. Empty when they were set directly.
+    std::string timeCreated;
+public:
+    // Use line for the camera numbered sensor.
+    void setSensorLine(uint32_t sensor, const SensorLine & line);
+
+    // Load the newest lines from an SQLite3 file for the cameras named in names, in camera number order.
+    // Cameras without a row are left uncalibrated. Throws if no camera has one.
+    void loadSensorLines(const char * filename, const std::vector<std::string> & names);
+
+    // When the lines loaded by loadSensorLines were created.
+    const std::string & linesTime() const { return timeCreated; }
+
+    // True when the camera numbered sensor has a line.
+    bool calibrated(uint32_t sensor) const;
+
+    // Estimate the position from pixels[i] of camera i for count cameras. A NaN pixel is a camera that didn't see
+    // the impact. Returns false when fewer than two sensors with readings are calibrated or their lines are parallel.
+    bool estimatePosition(const double * pixels, uint32_t count, double & x, double & y) const;
+};
+
+#endif //UNTITLED_SENSORFUSION_H
@@ -0,0 +1,294 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "ShotJournal.h"
+#include "DatabaseService.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+using std::cerr, std::endl;
+
+static_assert(sizeof(ShotRecord) % 8 == 0, "Shot records are packed end to end in the journal.");
+
+// Milliseconds the compactor sleeps between checks when it isn't woken.
+#define SHOT_COMPACT_INTERVAL_MS 1000
+
+// States of a segment. Only the thread calling append opens and seals segments and only the compactor frees them.
+#define SHOT_SEGMENT_FREE   0
+#define SHOT_SEGMENT_OPEN   1
+#define SHOT_SEGMENT_SEALED 2
+
+// Written at the start of the journal file, followed by the segments and then the records.
+struct ShotJournalHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordBytes;
+    uint32_t segmentRecords;
+    uint32_t segmentCount;
+};
+
+// count and state are shared between the two threads through __atomic builtins, since they live in the file.
+struct ShotJournalSegment
+{
+    uint64_t firstSequence;
+    uint32_t count;
+    uint32_t state;
+};
+
+bool shotJournalFromEnvironment(){
+    const char * value = getenv(SHOT_JOURNAL_ENV);
+    return value == NULL || strcmp(value, "0") != 0;
+}
+
+std::string shotJournalPath(const char * databaseFilename){
+    std::string directory = databaseFilename;
+    size_t slash = directory.find_last_of('/');
+    directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+    return directory + SHOT_JOURNAL_FILENAME;
+}
+
+// Local time formatted like localDatetime with milliseconds added.
+static std::string formatTimeRecorded(int64_t timeRecordedUs){
+    time_t seconds = timeRecordedUs / 1000000;
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char formatted[32];
+    size_t length = strftime(formatted, sizeof(formatted), "%Y-%m-%d %H:%M:%S", &local);
+    snprintf(formatted + length, sizeof(formatted) - length, ".%03d", (int) (timeRecordedUs / 1000 % 1000));
+    return formatted;
+}
+
+// A time set with setShotTime.
+static std::string storedTime(const char (&field)[SHOT_TIME_BYTES]){
+    return std::string(field, strnlen(field, SHOT_TIME_BYTES));
+}
+
+ShotJournal::ShotJournal(const std::string & path, const char * databaseFilename) : databaseFilename(databaseFilename){
+    openFile(path);
+
+    // Sequences carry on from the newest shot, whether it's still in the journal or already moved.
+    DatabaseService & database = DatabaseService::forFile(databaseFilename);
+    database.enqueue({{CREATE_SHOTS_STATEMENT, {}}, {CREATE_SHOTS_INDEX_STATEMENT, {}}});
+    database.flush();
+    // Columns added since the table was created. They're queued once the session is closed.
+    std::vector<DatabaseRow> addColumns;
+    {
+        DatabaseSession session = database.session();
+        sqlite3 *db = session.db();
+        sqlite3_stmt *stmt = session.statement(SHOTS_HAS_LANE_STATEMENT);
+        if(SQLite3_CHECK(sqlite3_step(stmt),db) == SQLITE_ROW && sqlite3_column_int(stmt,0) == 0){
+            addColumns.push_back({ADD_SHOTS_LANE_STATEMENT, {}});
+        }
+        stmt = session.statement(SHOTS_HAS_PAIRINGS_STATEMENT);
+        if(SQLite3_CHECK(sqlite3_step(stmt),db) == SQLITE_ROW && sqlite3_column_int(stmt,0) == 0){
+            addColumns.push_back({ADD_SHOTS_PAIRINGS_STATEMENT, {}});
+        }
+        stmt = session.statement(LAST_SHOT_STATEMENT);
+        if(SQLite3_CHECK(sqlite3_step(stmt),db) == SQLITE_ROW && sqlite3_column_type(stmt,0) != SQLITE_NULL){
+            nextSequence = sqlite3_column_int64(stmt,0) + 1;
+        }
+    }
+    if(!addColumns.empty()){
+        database.enqueue(std::move(addColumns));
+        database.flush();
+    }
+    uint64_t newestFirst = 0;
+    for(uint32_t i = 0; i < SHOT_SEGMENT_COUNT; i++){
+        ShotJournalSegment & segment = segments[i];
+        if(segment.state == SHOT_SEGMENT_FREE){
+            clearSegment(i);
+            continue;
+        }
+        // A segment still open was being written when the program stopped. Its records up to count are whole.
+        if(segment.state == SHOT_SEGMENT_OPEN) segment.state = SHOT_SEGMENT_SEALED;
+        nextSequence = std::max(nextSequence, segment.firstSequence + segment.count);
+        if(segment.firstSequence >= newestFirst){
+            newestFirst = segment.firstSequence;
+            lastSegment = i;
+        }
+    }
+
+    // Anything left from before is moved straight away.
+    segmentSealed = true;
+    compactor = std::thread(&ShotJournal::compactSegments, this);
+}
+
+ShotJournal::~ShotJournal(){
+    if(currentSegment >= 0) sealSegment();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    compactor.join();
+    if(dropped > 0) cerr << "The shot journal dropped " << dropped << " shots." << endl;
+    munmap(mapping, mappingBytes);
+    close(fd);
+}
+
+void ShotJournal::openFile(const std::string & path){
+    mappingBytes = sizeof(ShotJournalHeader) + SHOT_SEGMENT_COUNT * sizeof(ShotJournalSegment) +
+                   (size_t) SHOT_SEGMENT_COUNT * SHOT_SEGMENT_RECORDS * sizeof(ShotRecord);
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0){
+        cerr << "Couldn't open the shot journal " << path << ": " << strerror(errno) << ". Aborting." << endl;
+        std::abort();
+    }
+
+    ShotJournalHeader expected = {};
+    memcpy(expected.magic, SHOT_JOURNAL_MAGIC, sizeof(SHOT_JOURNAL_MAGIC));
+    expected.version = SHOT_JOURNAL_VERSION;
+    expected.recordBytes = sizeof(ShotRecord);
+    expected.segmentRecords = SHOT_SEGMENT_RECORDS;
+    expected.segmentCount = SHOT_SEGMENT_COUNT;
+
+    struct stat status;
+    ShotJournalHeader existing = {};
+    bool matches = fstat(fd, &status) == 0 && (size_t) status.st_size == mappingBytes &&
+                   pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+                   memcmp(&existing, &expected, sizeof(expected)) == 0;
+    if(!matches){
+        if(status.st_size > 0){
+            cerr << "The shot journal " << path << " is from another version and is being started again." << endl;
+        }
+        // Reserve the whole file now, so appending never waits for the filesystem to find space.
+        int error = ftruncate(fd, 0) == 0 ? posix_fallocate(fd, 0, mappingBytes) : errno;
+        if(error != 0){
+            cerr << "Couldn't make room for the shot journal " << path << ": " << strerror(error) << ". Aborting." << endl;
+            std::abort();
+        }
+    }
+
+    // Populate the pages now, so the first shot in each page doesn't fault.
+    void * mapped = mmap(NULL, mappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if(mapped == MAP_FAILED){
+        cerr << "Couldn't map the shot journal " << path << ": " << strerror(errno) << ". Aborting." << endl;
+        std::abort();
+    }
+    mapping = static_cast<uint8_t *>(mapped);
+    header = reinterpret_cast<ShotJournalHeader *>(mapping);
+    segments = reinterpret_cast<ShotJournalSegment *>(mapping + sizeof(ShotJournalHeader));
+    records = reinterpret_cast<ShotRecord *>(mapping + sizeof(ShotJournalHeader) +
+                                             SHOT_SEGMENT_COUNT * sizeof(ShotJournalSegment));
+    // The header goes in last, so a file that was cut short never looks complete.
+    if(!matches) *header = expected;
+}
+
+bool ShotJournal::openSegment(){
+    uint32_t next = (lastSegment + 1) % SHOT_SEGMENT_COUNT;
+    ShotJournalSegment & segment = segments[next];
+    if(__atomic_load_n(&segment.state, __ATOMIC_ACQUIRE) != SHOT_SEGMENT_FREE) return false;
+    segment.firstSequence = nextSequence;
+    segment.count = 0;
+    __atomic_store_n(&segment.state, SHOT_SEGMENT_OPEN, __ATOMIC_RELEASE);
+    currentSegment = next;
+    lastSegment = next;
+    return true;
+}
+
+void ShotJournal::sealSegment(){
+    ShotJournalSegment & segment = segments[currentSegment];
+    __atomic_store_n(&segment.state, segment.count > 0 ? SHOT_SEGMENT_SEALED : SHOT_SEGMENT_FREE, __ATOMIC_RELEASE);
+    currentSegment = -1;
+    segmentSealed.store(true, std::memory_order_release);
+    wake.notify_one();
+}
+
+bool ShotJournal::append(ShotRecord & record){
+    if(currentSegment < 0 && !openSegment()){
+        dropped++;
+        return false;
+    }
+    ShotJournalSegment & segment = segments[currentSegment];
+    record.sequence = nextSequence++;
+    uint32_t count = segment.count;
+    records[(size_t) currentSegment * SHOT_SEGMENT_RECORDS + count] = record;
+
+    // The record is written before it's counted, so a crash never leaves part of one counted.
+    __atomic_store_n(&segment.count, count + 1, __ATOMIC_RELEASE);
+    if(count + 1 == SHOT_SEGMENT_RECORDS) sealSegment();
+    return true;
+}
+
+void ShotJournal::clearSegment(uint32_t segment){
+    memset(records + (size_t) segment * SHOT_SEGMENT_RECORDS, 0, SHOT_SEGMENT_RECORDS * sizeof(ShotRecord));
+}
+
+void ShotJournal::compactSegments(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+        wake.wait_for(lock, std::chrono::milliseconds(SHOT_COMPACT_INTERVAL_MS), [this]{
+            return stopping || segmentSealed.load(std::memory_order_acquire);
+        });
+        bool finishing = stopping;
+        segmentSealed = false;
+        lock.unlock();
+
+        // Oldest first, so the table fills in the order the shots were taken.
+        std::vector<uint32_t> sealed;
+        for(uint32_t i = 0; i < SHOT_SEGMENT_COUNT; i++){
+            if(__atomic_load_n(&segments[i].state, __ATOMIC_ACQUIRE) == SHOT_SEGMENT_SEALED) sealed.push_back(i);
+        }
+        std::sort(sealed.begin(), sealed.end(), [this](uint32_t a, uint32_t b){
+            return segments[a].firstSequence < segments[b].firstSequence;
+        });
+        for(uint32_t segment : sealed) compactSegment(segment);
+
+        lock.lock();
+        if(finishing) break;
+    }
+}
+
+void ShotJournal::compactSegment(uint32_t segment){
+    uint32_t count = __atomic_load_n(&segments[segment].count, __ATOMIC_ACQUIRE);
+    const ShotRecord * segmentRecords = records + (size_t) segment * SHOT_SEGMENT_RECORDS;
+
+    // The segment is committed in one transaction and only freed once it's on disk.
+    std::vector<DatabaseRow> rows;
+    rows.reserve(count);
+    for(uint32_t i = 0; i < count; i++){
+        const ShotRecord & r = segmentRecords[i];
+        rows.push_back({INSERT_SHOT_STATEMENT, {(int64_t) r.sequence, formatTimeRecorded(r.timeRecordedUs),
+                                                (int64_t) r.timestamp[0], (int64_t) r.timestamp[1],
+                                                (int64_t) r.frameNumber[0], (int64_t) r.frameNumber[1],
+                                                (int64_t) r.firstColumn[0], (int64_t) r.lastColumn[0],
+                                                (int64_t) r.firstColumn[1], (int64_t) r.lastColumn[1],
+                                                r.centroid[0], r.centroid[1], r.width[0], r.width[1],
+                                                (int64_t) r.x, (int64_t) r.y,
+                                                storedTime(r.baselineTime[0]), storedTime(r.baselineTime[1]),
+                                                storedTime(r.coefficientsTime), (int64_t) r.lane,
+                                                (int64_t) r.pairings}});
+    }
+    DatabaseService & database = DatabaseService::forFile(databaseFilename.c_str());
+    database.enqueue(std::move(rows));
+    database.flush();
+    clearSegment(segment);
+    __atomic_store_n(&segments[segment].state, SHOT_SEGMENT_FREE, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,179 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_SHOTJOURNAL_H
+#define UNTITLED_SHOTJOURNAL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Environment variable. Set to 0 to stop testing_continous and lanes journaling shots.
+#define SHOT_JOURNAL_ENV "LSAD_SHOT_JOURNAL"
+
+// The journal is kept next to the database with this name.
+#define SHOT_JOURNAL_FILENAME "shotJournal.bin"
+
+// Identifies a shot journal file.
+#define SHOT_JOURNAL_MAGIC "LSADSHT"
+#define SHOT_JOURNAL_VERSION 2
+
+// Shots in a segment, and segments in the file. A segment is moved to the database once it's full.
+#define SHOT_SEGMENT_RECORDS 1024
+#define SHOT_SEGMENT_COUNT 64
+
+// Room for a timeCreated string and its terminating null.
+#define SHOT_TIME_BYTES 20
+
+// SQL Statements:
+#define CREATE_SHOTS_STATEMENT "CREATE TABLE IF NOT EXISTS shots ('sequence' INTEGER PRIMARY KEY, 'timeRecorded' TEXT, \
+'timestampL45' INTEGER, 'timestampL90' INTEGER, 'frameL45' INTEGER, 'frameL90' INTEGER, \
+'firstColumnL45' INTEGER, 'lastColumnL45' INTEGER, 'firstColumnL90' INTEGER, 'lastColumnL90' INTEGER, \
+'L45' REAL, 'L90' REAL, 'widthL45' REAL, 'widthL90' REAL, 'x' INTEGER, 'y' INTEGER, \
+'baselineL45' TEXT, 'baselineL90' TEXT, 'coefficients' TEXT, 'lane' INTEGER DEFAULT 0, 'pairings' INTEGER DEFAULT 1);"
+
+// Tables created before lanes don't have the lane column.
+#define SHOTS_HAS_LANE_STATEMENT "SELECT COUNT(*) FROM pragma_table_info('shots') WHERE name = 'lane';"
+#define ADD_SHOTS_LANE_STATEMENT "ALTER TABLE shots ADD COLUMN 'lane' INTEGER DEFAULT 0;"
+
+// Or the pairings column. Shots recorded before it was added are counted as unambiguous.
+#define SHOTS_HAS_PAIRINGS_STATEMENT "SELECT COUNT(*) FROM pragma_table_info('shots') WHERE name = 'pairings';"
+#define ADD_SHOTS_PAIRINGS_STATEMENT "ALTER TABLE shots ADD COLUMN 'pairings' INTEGER DEFAULT 1;"
+
+#define CREATE_SHOTS_INDEX_STATEMENT "CREATE INDEX IF NOT EXISTS 'shots timeRecorded' ON shots ('timeRecorded');"
+
+// A crash after a segment is committed but before it's freed moves it again, so rows already there are skipped.
+#define INSERT_SHOT_STATEMENT "INSERT OR IGNORE INTO shots VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);"
+
+#define LAST_SHOT_STATEMENT "SELECT MAX(sequence) FROM shots;"
+
+// One position estimated from a matched pair of frames. Index 0 is L45, or the lane's first camera, and 1 is L90.
+// When a camera sees more than one object there's a record for each pairing, and pairings says how many there were.
+struct ShotRecord
+{
+    // Set by append. Counts up across sessions.
+    uint64_t sequence;
+    // Wall clock time the shot was recorded, in microseconds since the epoch.
+    int64_t timeRecordedUs;
+    // Chunk timestamps and frame numbers of the two frames.
+    uint64_t timestamp[2];
+    uint64_t frameNumber[2];
+    // The run of blocked columns the position was estimated from.
+    uint32_t firstColumn[2];
+    uint32_t lastColumn[2];
+    double centroid[2];
+    double width[2];
+    uint32_t x;
+    uint32_t y;
+    // When the baselines and coefficients, or sensor lines, used were created.
+    char baselineTime[2][SHOT_TIME_BYTES];
+    char coefficientsTime[SHOT_TIME_BYTES];
+    // The lane the shot was taken in. 0 for testing_continous.
+    uint32_t lane;
+    // Records made from the same pair of frames, this one included. More than one means some of them pair different
+    // objects and are positions nothing hit.
+    uint32_t pairings;
+};
+
+// Copy time into a fixed size field of a ShotRecord, cut short if it's too long.
+inline void setShotTime(char (&field)[SHOT_TIME_BYTES], const std::string & time){
+    size_t length = std::min(time.size(), (size_t) SHOT_TIME_BYTES - 1);
+    memcpy(field, time.data(), length);
+    field[length] = '\0';
+}
+
+struct ShotJournalHeader;
+struct ShotJournalSegment;
+
+// Append-only record of every shot, kept in a preallocated file mapped into memory.
+// append copies the record into the current segment without allocating or locking, so it can be called on the
+// detection thread. The file is populated when it's mapped, so appending doesn't fault pages in either. A compactor thread moves each full segment into the shots table through the
+// DatabaseService and frees it for reuse. Segments left in the file by a crash are moved the next time it's opened.
+// If the compactor falls a whole file behind, shots are counted as dropped instead of waiting for it.
+class ShotJournal {
+private:
+    std::string databaseFilename;
+    int fd = -1;
+    uint8_t * mapping = nullptr;
+    size_t mappingBytes = 0;
+    ShotJournalHeader * header = nullptr;
+    ShotJournalSegment * segments = nullptr;
+    ShotRecord * records = nullptr;
+
+    // Only used by the thread calling append.
+    uint64_t nextSequence = 0;
+    int32_t currentSegment = -1;
+    uint32_t lastSegment = SHOT_SEGMENT_COUNT - 1;
+    uint64_t dropped = 0;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> segmentSealed{false};
+    bool stopping = false;
+    std::thread compactor;
+
+    // Map the journal at path, creating it or starting it again when it doesn't match this build.
+    void openFile(const std::string & path);
+
+    // Start writing the segment after the last one. Returns false when it hasn't been moved to the database yet.
+    bool openSegment();
+
+    // Mark the current segment full and wake the compactor.
+    void sealSegment();
+
+    // Move sealed segments to the database, oldest first, until stopped.
+    void compactSegments();
+
+    // Move one sealed segment to the database and free it.
+    void compactSegment(uint32_t segment);
+
+    // Write over a segment's records before it's freed. Writing to a clean page of a shared file mapping faults
+    // the first time, so this takes those faults here instead of in append.
+    void clearSegment(uint32_t segment);
+public:
+    // Open the journal at path and move the shots in it to the shots table in databaseFilename.
+    ShotJournal(const std::string & path, const char * databaseFilename);
+    // Seals the current segment and moves everything left to the database before closing the file.
+    ~ShotJournal();
+
+    ShotJournal(const ShotJournal &) = delete;
+    ShotJournal & operator=(const ShotJournal &) = delete;
+
+    // Add record to the journal, setting its sequence. Only call from one thread.
+    // Returns false when the shot had to be dropped.
+    bool append(ShotRecord & record);
+
+    // Shots dropped because the compactor was behind. Read on the thread calling append.
+    uint64_t droppedShots() const { return dropped; }
+};
+
+// False when SHOT_JOURNAL_ENV is 0.
+bool shotJournalFromEnvironment();
+
+// Path of the journal kept next to databaseFilename.
+std::string shotJournalPath(const char * databaseFilename);
+
+#endif //UNTITLED_SHOTJOURNAL_H
@@ -0,0 +1,93 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_SPSCRING_H
+#define UNTITLED_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+
+// Size of a cache line. The producer and consumer indexes are kept on separate lines so they don't share one.
+#define CACHE_LINE_BYTES 64
+
+// Fixed size lock free ring buffer with one producer thread and one consumer thread.
+// Neither side ever blocks or takes a lock. The producer only writes tail and the consumer only writes head,
+// and each keeps a cached copy of the other's index so the shared index is only read when the ring looks full or empty.
+// Capacity must be a power of two. T is copied in and out, so it should be small and trivially copyable.
+template<typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two.");
+private:
+    // Next slot to read. Written by the consumer.
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> head{0};
+    // Consumer's copy of tail.
+    size_t cachedTail = 0;
+
+    // Next slot to write. Written by the producer.
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> tail{0};
+    // Producer's copy of head.
+    size_t cachedHead = 0;
+
+    alignas(CACHE_LINE_BYTES) T slots[Capacity];
+public:
+    // Producer: add item. Returns false without waiting when the ring is full.
+    bool tryPush(const T & item){
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(t - cachedHead == Capacity){
+            cachedHead = head.load(std::memory_order_acquire);
+            if(t - cachedHead == Capacity) return false;
+        }
+        slots[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: the oldest item, or NULL when the ring is empty. Valid until pop is called.
+    const T * front(){
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h == cachedTail){
+            cachedTail = tail.load(std::memory_order_acquire);
+            if(h == cachedTail) return NULL;
+        }
+        return &slots[h & (Capacity - 1)];
+    }
+
+    // Consumer: remove the item returned by front.
+    void pop(){
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer: remove the oldest item into item. Returns false when the ring is empty.
+    bool tryPop(T & item){
+        const T * oldest = front();
+        if(oldest == NULL) return false;
+        item = *oldest;
+        pop();
+        return true;
+    }
+
+    // Number of items in the ring. Only exact when neither side is running.
+    size_t size() const{
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+};
+
+#endif //UNTITLED_SPSCRING_H
@@ -0,0 +1,218 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "StartupSnapshot.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+using std::cerr, std::cout, std::endl;
+
+bool startWithLatestFromEnvironment(){
+    const char * value = getenv(STARTUP_MODE_ENV);
+    if(value == NULL || value[0] == '\0' || strcmp(value, "prompt") == 0) return false;
+    if(strcmp(value, "latest") == 0) return true;
+    cerr << "Unknown " << STARTUP_MODE_ENV << " \"" << value << "\". Use latest or prompt. Aborting." << endl;
+    std::abort();
+}
+
+// The snapshot is kept in the same directory as the database.
+static std::string snapshotPath(const char * filename){
+    std::string directory = filename;
+    size_t slash = directory.find_last_of('/');
+    directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+    return directory + STARTUP_SNAPSHOT_FILENAME;
+}
+
+// Bytes the lines of a baseline pixels wide take in a snapshot.
+static size_t snapshotLineBytes(uint32_t pixels){
+    return (size_t) STARTUP_BASELINE_LINES * pixels * sizeof(uint32_t);
+}
+
+// A snapshot file mapped read-only, or null when it doesn't exist or is too small to be a snapshot.
+// Unmapped when it goes out of scope.
+class MappedSnapshot {
+public:
+    const StartupSnapshot * snapshot = nullptr;
+    size_t bytes = 0;
+
+    explicit MappedSnapshot(const std::string & path){
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) return;
+        struct stat status;
+        if(fstat(fd, &status) == 0 && (size_t) status.st_size >= sizeof(StartupSnapshot)){
+            void * mapped = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapped != MAP_FAILED){
+                snapshot = static_cast<const StartupSnapshot *>(mapped);
+                bytes = status.st_size;
+            }
+        }
+        close(fd);
+    }
+    ~MappedSnapshot(){
+        if(snapshot != nullptr) munmap(const_cast<StartupSnapshot *>(snapshot), bytes);
+    }
+
+    MappedSnapshot(const MappedSnapshot &) = delete;
+    MappedSnapshot & operator=(const MappedSnapshot &) = delete;
+};
+
+// True when value is the null terminated string stored in a field of fieldBytes.
+static bool storedStringIs(const char * field, size_t fieldBytes, const std::string & value){
+    return memchr(field, '\0', fieldBytes) != NULL && value == field;
+}
+
+// True when the bytes of snapshot were written by this build for the current camera settings and hold the
+// baselines created for cameraNames at baselineTimes, and the coefficients created at coefficientsTime unless it's empty.
+static bool snapshotMatches(const StartupSnapshot * snapshot, size_t bytes, const std::string cameraNames[2],
+                            const std::string baselineTimes[2], const std::string & coefficientsTime){
+    if(memcmp(snapshot->magic, STARTUP_SNAPSHOT_MAGIC, sizeof(STARTUP_SNAPSHOT_MAGIC)) != 0 ||
+       snapshot->version != STARTUP_SNAPSHOT_VERSION || snapshot->bytes != bytes ||
+       snapshot->numCoefficients != NUM_COEFFICIENTS ||
+       bytes != sizeof(StartupSnapshot) + snapshotLineBytes(snapshot->baselinePixels[0])
+                + snapshotLineBytes(snapshot->baselinePixels[1])) return false;
+    for(int i = 0; i < 2; i++){
+        if(snapshot->baselineGain[i] != CAMERA_GAIN || snapshot->baselineExposure[i] != CAMERA_EXPOSURE_TIME ||
+           snapshot->baselinePixels[i] == 0 ||
+           !storedStringIs(snapshot->cameraName[i], STARTUP_NAME_BYTES, cameraNames[i]) ||
+           !storedStringIs(snapshot->baselineTime[i], STARTUP_TIME_BYTES, baselineTimes[i])) return false;
+    }
+    return coefficientsTime.empty() || storedStringIs(snapshot->coefficientsTime, STARTUP_TIME_BYTES, coefficientsTime);
+}
+
+// The lines of baseline, in the order they're stored in a snapshot.
+static void * baselineLine(BaselineData * baseline, int line){
+    switch(line){
+        case 0:  return baseline->avgLine.data();
+        case 1:  return baseline->minLine.data();
+        case 2:  return baseline->maxLine.data();
+        case 3:  return baseline->stdDevLine.data();
+        default: return baseline->thresholdLine.data();
+    }
+}
+
+// Copy the baselines stored after snapshot into baselines.
+static void copySnapshotBaselines(const StartupSnapshot * snapshot, struct BaselineData * baselines[2]){
+    const uint8_t * lines = reinterpret_cast<const uint8_t *>(snapshot + 1);
+    for(int i = 0; i < 2; i++){
+        uint32_t pixels = snapshot->baselinePixels[i];
+        baselines[i]->gain = snapshot->baselineGain[i];
+        baselines[i]->exposure_time = snapshot->baselineExposure[i];
+        baselines[i]->resize(pixels);
+        for(int line = 0; line < STARTUP_BASELINE_LINES; line++){
+            memcpy(baselineLine(baselines[i], line), lines, pixels * sizeof(uint32_t));
+            lines += pixels * sizeof(uint32_t);
+        }
+    }
+}
+
+// Write snapshot followed by the lines of baselines to path. A temporary file is renamed over the old one,
+// so a crash never leaves half a snapshot.
+static void writeSnapshot(const std::string & path, const StartupSnapshot & snapshot, struct BaselineData * baselines[2]){
+    std::string temporaryPath = path + ".tmp";
+    FILE * file = fopen(temporaryPath.c_str(), "wb");
+    if(file == NULL){
+        cerr << "Couldn't write the startup snapshot to " << temporaryPath << ": " << strerror(errno) << endl;
+        return;
+    }
+    bool written = fwrite(&snapshot, sizeof(snapshot), 1, file) == 1;
+    for(int i = 0; i < 2; i++){
+        for(int line = 0; line < STARTUP_BASELINE_LINES; line++){
+            uint32_t pixels = baselines[i]->pixelsPerLine();
+            written = written && fwrite(baselineLine(baselines[i], line), sizeof(uint32_t), pixels, file) == pixels;
+        }
+    }
+    written = fclose(file) == 0 && written;
+    if(!written || rename(temporaryPath.c_str(), path.c_str()) != 0){
+        cerr << "Couldn't write the startup snapshot to " << path << ": " << strerror(errno) << endl;
+        remove(temporaryPath.c_str());
+    }
+}
+
+void loadStartupCalibration(const char * filename, const std::string cameraNames[2], struct BaselineData * baselines[2],
+                            std::string baselineTimes[2], ScreenPositionEstimator * estimator){
+    // Find the newest of each. These are read from the indexes, so checking is quick.
+    for(int i = 0; i < 2; i++){
+        baselineTimes[i] = latestBaselineTime(filename, cameraNames[i].c_str());
+        if(baselineTimes[i].empty()){
+            cerr << "There's no baseline for " << cameraNames[i] << " with the current gain and exposure. Aborting." << endl;
+            std::abort();
+        }
+    }
+    std::string coefficientsTime;
+    if(estimator != nullptr){
+        coefficientsTime = latestCoefficientsTime(filename);
+        if(coefficientsTime.empty()){
+            cerr << "There are no coefficients in " << filename << ". Run the training program first. Aborting." << endl;
+            std::abort();
+        }
+    }
+
+    // Use the snapshot when it already holds them.
+    std::string path = snapshotPath(filename);
+    {
+        MappedSnapshot mapped(path);
+        if(mapped.snapshot != nullptr &&
+           snapshotMatches(mapped.snapshot, mapped.bytes, cameraNames, baselineTimes, coefficientsTime)){
+            const StartupSnapshot * snapshot = mapped.snapshot;
+            copySnapshotBaselines(snapshot, baselines);
+            if(estimator != nullptr){
+                estimator->useCoefficients(snapshot->xCoefficients, snapshot->yCoefficients, coefficientsTime, filename);
+            }
+            cout << "Loaded the newest baselines" << (estimator != nullptr ? " and coefficients" : "") << " from "
+                 << path << "." << endl;
+            return;
+        }
+    }
+
+    // Otherwise read them from the database and keep them for the next start.
+    std::unique_ptr<StartupSnapshot> snapshot(new StartupSnapshot());
+    memcpy(snapshot->magic, STARTUP_SNAPSHOT_MAGIC, sizeof(STARTUP_SNAPSHOT_MAGIC));
+    snapshot->version = STARTUP_SNAPSHOT_VERSION;
+    snapshot->bytes = sizeof(StartupSnapshot);
+    snapshot->numCoefficients = NUM_COEFFICIENTS;
+    for(int i = 0; i < 2; i++){
+        readBaselineFromDB(baselines[i], filename, cameraNames[i].c_str(), baselineTimes[i]);
+        baselines[i]->gain = CAMERA_GAIN;
+        baselines[i]->exposure_time = CAMERA_EXPOSURE_TIME;
+        snapshot->baselineGain[i] = CAMERA_GAIN;
+        snapshot->baselineExposure[i] = CAMERA_EXPOSURE_TIME;
+        snapshot->baselinePixels[i] = baselines[i]->pixelsPerLine();
+        snapshot->bytes += snapshotLineBytes(baselines[i]->pixelsPerLine());
+        snprintf(snapshot->cameraName[i], STARTUP_NAME_BYTES, "%s", cameraNames[i].c_str());
+        snprintf(snapshot->baselineTime[i], STARTUP_TIME_BYTES, "%s", baselineTimes[i].c_str());
+    }
+    if(estimator != nullptr){
+        coefficientsTime = readCoefficientsFromDB(filename, snapshot->xCoefficients, snapshot->yCoefficients);
+        snprintf(snapshot->coefficientsTime, STARTUP_TIME_BYTES, "%s", coefficientsTime.c_str());
+        estimator->useCoefficients(snapshot->xCoefficients, snapshot->yCoefficients, coefficientsTime, filename);
+    }
+    writeSnapshot(path, *snapshot, baselines);
+    cout << "Loaded the newest baselines" << (estimator != nullptr ? " and coefficients" : "") << " from " << filename
+         << "." << endl;
+}
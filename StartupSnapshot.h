@@ -0,0 +1,80 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_STARTUPSNAPSHOT_H
+#define UNTITLED_STARTUPSNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include "BaselineData.h"
+#include "ScreenPositionEstimator.h"
+
+// Environment variable choosing how training and testing_continous pick their baselines and coefficients.
+// "latest" loads the newest of each without asking, from the startup snapshot when it's still the newest.
+// Unset or "prompt" asks which baseline to load for each camera.
+#define STARTUP_MODE_ENV "LSAD_STARTUP"
+
+// The startup snapshot is kept next to the database with this name.
+#define STARTUP_SNAPSHOT_FILENAME "startupSnapshot.bin"
+
+// Identifies a startup snapshot file.
+#define STARTUP_SNAPSHOT_MAGIC "LSADSNP"
+#define STARTUP_SNAPSHOT_VERSION 3
+
+// Room for a timeCreated string or a camera name and its terminating null.
+#define STARTUP_TIME_BYTES 32
+#define STARTUP_NAME_BYTES 32
+
+// Lines of a baseline stored in a startup snapshot: avg, min, max, stdDev and threshold.
+#define STARTUP_BASELINE_LINES 5
+
+// The start of a startup snapshot: the baselines and coefficients last loaded with STARTUP_MODE_ENV=latest.
+// Each baseline's lines follow it in the file, one value for each of its baselinePixels pixels.
+// The file is mapped and read in place, so the layout is the host's.
+struct StartupSnapshot
+{
+    char magic[8];
+    uint32_t version;
+    // Size of the whole file, including the lines.
+    uint32_t bytes;
+    uint32_t numCoefficients;
+    char cameraName[2][STARTUP_NAME_BYTES];
+    char baselineTime[2][STARTUP_TIME_BYTES];
+    // Empty when the snapshot was written without coefficients.
+    char coefficientsTime[STARTUP_TIME_BYTES];
+    uint32_t baselineGain[2];
+    uint32_t baselineExposure[2];
+    uint32_t baselinePixels[2];
+    double xCoefficients[NUM_COEFFICIENTS];
+    double yCoefficients[NUM_COEFFICIENTS];
+};
+
+// True when STARTUP_MODE_ENV is "latest". Aborts on a mode it doesn't know.
+bool startWithLatestFromEnvironment();
+
+// Load the newest baseline for each of cameraNames with the current gain and exposure into baselines, and the newest
+// coefficients into estimator when it isn't null. baselineTimes is set to when the baselines were created.
+// They're copied from the snapshot next to filename when the database has nothing newer. Otherwise they're read
+// from the database and the snapshot is written again. Aborts when the database doesn't have them.
+void loadStartupCalibration(const char * filename, const std::string cameraNames[2], struct BaselineData * baselines[2],
+                            std::string baselineTimes[2], ScreenPositionEstimator * estimator);
+
+#endif //UNTITLED_STARTUPSNAPSHOT_H
@@ -0,0 +1,175 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "StereoCorrelator.h"
+#include "camerasettings.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+StereoSettings stereoSettingsFromEnvironment(){
+    StereoSettings settings;
+    const char * value;
+    if((value = getenv(STEREO_WINDOW_ENV)) != NULL)   settings.windowUs = atof(value);
+    if((value = getenv(STEREO_MAX_WAIT_ENV)) != NULL) settings.maxWaitMs = atof(value);
+    return settings;
+}
+
+StereoCorrelator::StereoCorrelator(const StereoSettings & settings)
+    : settings(settings),
+      windowTicks((int64_t) (settings.windowUs * TIMESTAMP_TICKS_PER_SECOND / 1000000)),
+      maxWait(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(settings.maxWaitMs))){
+}
+
+void StereoCorrelator::setClockOffset(uint32_t cameraNo, int64_t ticks){
+    clockOffsets[cameraNo] = ticks;
+}
+
+int64_t StereoCorrelator::clockOffset(uint32_t cameraNo) const{
+    return llround(clockOffsets[cameraNo]);
+}
+
+void StereoCorrelator::add(const DetectionResult & result, std::chrono::steady_clock::time_point arrival){
+    uint32_t cameraNo = result.cameraNo;
+    int64_t time = (int64_t) result.timestamp + clockOffset(cameraNo);
+
+    // The partner of this result was already reported as unmatched.
+    if(expired[cameraNo] && time <= expiredUntil[cameraNo]){
+        StereoEvent event = {};
+        event.type = StereoEventType::Late;
+        event.cameraNo = cameraNo;
+        event.result[cameraNo] = result;
+        events.push_back(event);
+        stats.late[cameraNo]++;
+        return;
+    }
+
+    pending[cameraNo].push_back({result, time, arrival});
+    latestTime[cameraNo] = time;
+    seen[cameraNo] = true;
+}
+
+void StereoCorrelator::reportUnmatched(uint32_t cameraNo){
+    StereoEvent event = {};
+    event.type = StereoEventType::Unmatched;
+    event.cameraNo = cameraNo;
+    event.result[cameraNo] = pending[cameraNo].front().result;
+    events.push_back(event);
+    stats.unmatched[cameraNo]++;
+    pending[cameraNo].pop_front();
+}
+
+void StereoCorrelator::correlate(std::chrono::steady_clock::time_point now){
+    while(!pending[0].empty() || !pending[1].empty()){
+        if(!pending[0].empty() && !pending[1].empty()){
+            const Pending & p0 = pending[0].front();
+            const Pending & p1 = pending[1].front();
+            int64_t skew = p1.time - p0.time;
+
+            if(std::llabs(skew) <= windowTicks){
+                StereoEvent event = {};
+                event.type = StereoEventType::Matched;
+                event.result[0] = p0.result;
+                event.result[1] = p1.result;
+                event.skewTicks = skew;
+                events.push_back(event);
+                stats.matched++;
+
+                // Follow the drift between the camera clocks.
+                clockOffsets[1] -= settings.driftGain * skew;
+
+                pending[0].pop_front();
+                pending[1].pop_front();
+            }
+            else{
+                // Results arrive in order, so the earlier one can't be matched by anything still to come.
+                reportUnmatched(skew > 0 ? 0 : 1);
+            }
+            continue;
+        }
+
+        // Only one camera has a result waiting.
+        uint32_t cameraNo = pending[0].empty() ? 1 : 0;
+        uint32_t other = 1 - cameraNo;
+        const Pending & p = pending[cameraNo].front();
+        if(seen[other] && latestTime[other] > p.time + windowTicks){
+            // The other camera has already moved past this result.
+            reportUnmatched(cameraNo);
+        }
+        else if(now - p.arrival > maxWait){
+            // Stop waiting. A partner arriving after this is late.
+            int64_t until = p.time + windowTicks;
+            expiredUntil[other] = expired[other] && expiredUntil[other] > until ? expiredUntil[other] : until;
+            expired[other] = true;
+            reportUnmatched(cameraNo);
+        }
+        else{
+            break;
+        }
+    }
+}
+
+bool StereoCorrelator::poll(StereoEvent & event, std::chrono::steady_clock::time_point now){
+    if(events.empty()) correlate(now);
+    if(events.empty()) return false;
+    event = events.front();
+    events.pop_front();
+    return true;
+}
+
+size_t StereoCorrelator::pendingCount() const{
+    return pending[0].size() + pending[1].size();
+}
+
+const StereoStats & StereoCorrelator::statistics() const{
+    return stats;
+}
+
+void calibrateClockOffsets(std::vector<std::unique_ptr<FrameSource>> & cameras, StereoCorrelator & correlator){
+    FrameSource * pair[2] = {nullptr, nullptr};
+    for(std::unique_ptr<FrameSource> & camera : cameras){
+        if(camera->cameraNo() <= 1) pair[camera->cameraNo()] = camera.get();
+    }
+    calibrateClockOffsets(pair, correlator);
+}
+
+void calibrateClockOffsets(FrameSource * const (&pair)[2], StereoCorrelator & correlator){
+    auto hostEpoch = std::chrono::steady_clock::now();
+    for(uint32_t cameraNo = 0; cameraNo < 2; cameraNo++){
+        FrameSource * camera = pair[cameraNo];
+        if(camera == nullptr) continue;
+
+        // Take the host time halfway through reading the camera's clock.
+        uint64_t cameraTicks;
+        auto before = std::chrono::steady_clock::now();
+        bool hasClock = camera->readClock(cameraTicks);
+        auto after = std::chrono::steady_clock::now();
+        if(!hasClock){
+            correlator.setClockOffset(cameraNo, 0);
+            continue;
+        }
+
+        auto hostTime = std::chrono::duration_cast<std::chrono::nanoseconds>((before - hostEpoch) + (after - before) / 2);
+        int64_t hostTicks = hostTime.count() * (TIMESTAMP_TICKS_PER_SECOND / 1000000000.0);
+        correlator.setClockOffset(cameraNo, hostTicks - (int64_t) cameraTicks);
+        std::cout << camera->name() << " clock offset: " << hostTicks - (int64_t) cameraTicks << " ticks.\n";
+    }
+}
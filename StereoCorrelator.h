@@ -0,0 +1,142 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_STEREOCORRELATOR_H
+#define UNTITLED_STEREOCORRELATOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "DetectionPipeline.h"
+#include "FrameSource.h"
+
+// Environment variables read by stereoSettingsFromEnvironment.
+// LSAD_STEREO_WINDOW_US    largest difference between the timestamps of two frames taken as the same shot.
+// LSAD_STEREO_MAX_WAIT_MS  longest a result waits for its partner before being reported as unmatched.
+#define STEREO_WINDOW_ENV   "LSAD_STEREO_WINDOW_US"
+#define STEREO_MAX_WAIT_ENV "LSAD_STEREO_MAX_WAIT_MS"
+
+struct StereoSettings
+{
+    // Matching window in microseconds. Should be under half the frame period.
+    double windowUs = 1000;
+    // How long a result waits for a partner from the other camera in milliseconds.
+    double maxWaitMs = 100;
+    // Fraction of each matched pair's timestamp difference used to correct the clock offset of camera 1.
+    // Follows the slow drift between the two camera clocks. 0 turns the correction off.
+    double driftGain = 0.01;
+};
+
+// Default settings changed by the STEREO_*_ENV environment variables.
+StereoSettings stereoSettingsFromEnvironment();
+
+enum class StereoEventType
+{
+    // Results from both cameras within the window.
+    Matched,
+    // A result with no partner from the other camera.
+    Unmatched,
+    // A result arriving after its partner was already reported as unmatched.
+    Late
+};
+
+struct StereoEvent
+{
+    StereoEventType type;
+    // Both results for Matched. Only result[cameraNo] for Unmatched and Late.
+    DetectionResult result[2];
+    uint32_t cameraNo;
+    // Camera 1's timestamp minus camera 0's after the clock offsets, for Matched.
+    int64_t skewTicks;
+};
+
+// Counts of events reported by a StereoCorrelator.
+struct StereoStats
+{
+    uint64_t matched = 0;
+    uint64_t unmatched[2] = {0, 0};
+    uint64_t late[2] = {0, 0};
+};
+
+// Matches detection results from the two cameras by chunk timestamp.
+// Each camera's timestamps are moved onto a common clock by adding its clock offset. Results from the two cameras
+// within the window of each other are matched. A result is reported as unmatched as soon as the other camera
+// has passed it, or after it has waited settings.maxWaitMs, so no result waits forever.
+// Results from each camera must be added in the order they were grabbed. Only used by one thread.
+class StereoCorrelator {
+private:
+    struct Pending
+    {
+        DetectionResult result;
+        // Timestamp on the common clock.
+        int64_t time;
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    StereoSettings settings;
+    int64_t windowTicks;
+    std::chrono::steady_clock::duration maxWait;
+    double clockOffsets[2] = {0, 0};
+    std::deque<Pending> pending[2];
+    // Latest timestamp added for each camera on the common clock.
+    int64_t latestTime[2];
+    bool seen[2] = {false, false};
+    // Results up to this time had their partner given up on, so they're late.
+    int64_t expiredUntil[2];
+    bool expired[2] = {false, false};
+    std::deque<StereoEvent> events;
+    StereoStats stats;
+
+    // Pop the front pending result for cameraNo and report it as unmatched.
+    void reportUnmatched(uint32_t cameraNo);
+
+    // Match pending results and queue events.
+    void correlate(std::chrono::steady_clock::time_point now);
+public:
+    explicit StereoCorrelator(const StereoSettings & settings);
+
+    // Ticks added to cameraNo's timestamps to put them on the common clock.
+    void setClockOffset(uint32_t cameraNo, int64_t ticks);
+    int64_t clockOffset(uint32_t cameraNo) const;
+
+    // Add a result from either camera.
+    void add(const DetectionResult & result, std::chrono::steady_clock::time_point arrival = std::chrono::steady_clock::now());
+
+    // Take the next event. Returns false when nothing is ready yet.
+    bool poll(StereoEvent & event, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    // Results waiting for a partner.
+    size_t pendingCount() const;
+
+    const StereoStats & statistics() const;
+};
+
+// Read every camera's clock and set the correlator's offsets so all timestamps are on the host's steady clock.
+// Cameras that can't read their clock are given an offset of 0.
+void calibrateClockOffsets(std::vector<std::unique_ptr<FrameSource>> & cameras, StereoCorrelator & correlator);
+
+// The same for cameras whose results come to the correlator as cameras 0 and 1, whatever their camera numbers.
+// Used by lanes, which number their own cameras.
+void calibrateClockOffsets(FrameSource * const (&pair)[2], StereoCorrelator & correlator);
+
+#endif //UNTITLED_STEREOCORRELATOR_H
@@ -0,0 +1,58 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "StreamingBaseline.h"
+
+StreamingBaseline::StreamingBaseline(const SensorGeometry & geometry)
+    : queue(geometry.frameBytes(), BASELINE_QUEUE_FRAMES), accumulator(geometry),
+      accumulatorThread(&StreamingBaseline::accumulate, this){
+}
+
+StreamingBaseline::~StreamingBaseline(){
+    // Stop the thread if finish wasn't called, e.g. when grabbing throws an exception.
+    if(accumulatorThread.joinable()) {
+        queue.close();
+        accumulatorThread.join();
+    }
+}
+
+void StreamingBaseline::accumulate(){
+    const uint8_t * frame;
+    while((frame = queue.front()) != NULL) {
+        accumulator.addFrame(frame);
+        queue.pop();
+    }
+}
+
+void StreamingBaseline::addFrame(const uint8_t * frame){
+    queue.push(frame);
+}
+
+void StreamingBaseline::finish(struct BaselineData * data){
+    // The thread exits after the last queued frame is added.
+    queue.close();
+    accumulatorThread.join();
+    accumulator.finish(data);
+}
+
+uint64_t StreamingBaseline::frames() const{
+    return accumulator.frames();
+}
@@ -0,0 +1,59 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_STREAMINGBASELINE_H
+#define UNTITLED_STREAMINGBASELINE_H
+
+#include <thread>
+#include "BaselineAccumulator.h"
+#include "FrameQueue.h"
+
+// Number of frames that can wait for the accumulator thread.
+// At 44 us per frame the accumulator keeps up with the camera, so the queue only absorbs scheduling delays.
+#define BASELINE_QUEUE_FRAMES 64
+
+// Calculates a baseline on a background thread while frames are being grabbed.
+// addFrame copies the frame into a bounded FrameQueue and returns, so the grab buffer can be released immediately.
+// Memory used is BASELINE_QUEUE_FRAMES frames no matter how many frames are added.
+class StreamingBaseline {
+private:
+    FrameQueue queue;
+    BaselineAccumulator accumulator;
+    std::thread accumulatorThread;
+
+    // Body of accumulatorThread. Adds frames from the queue until it's closed.
+    void accumulate();
+public:
+    explicit StreamingBaseline(const SensorGeometry & geometry = SensorGeometry());
+    ~StreamingBaseline();
+
+    // Queue a frame of the geometry given to the constructor to be added to the baseline.
+    void addFrame(const uint8_t * frame);
+
+    // Wait for the queued frames to be added and calculate the baseline.
+    // No frames can be added afterwards.
+    void finish(struct BaselineData * data);
+
+    // Number of frames added to the accumulator. Only accurate after finish.
+    uint64_t frames() const;
+};
+
+#endif //UNTITLED_STREAMINGBASELINE_H
@@ -0,0 +1,285 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "SyntheticFrameSource.h"
+#include "camerasettings.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// Extra noise past one frame so every frame can start from a different offset into the table.
+#define NOISE_TABLE_EXTRA 65536
+
+SyntheticSettings syntheticSettingsFromEnvironment(){
+    SyntheticSettings settings;
+    const char * value;
+    if((value = getenv(SYNTHETIC_RATE_ENV)) != NULL)  settings.frameRate = atof(value);
+    if((value = getenv(SYNTHETIC_NOISE_ENV)) != NULL) settings.noise = atof(value);
+    if((value = getenv(SYNTHETIC_GEOMETRY_ENV)) != NULL && !parseSensorGeometry(value, settings.geometry)){
+        throw std::runtime_error(std::string("Couldn't read the size in " SYNTHETIC_GEOMETRY_ENV ": ") + value);
+    }
+    return settings;
+}
+
+double syntheticArrowFromEnvironment(uint32_t cameraNo){
+    const char * value = getenv(SYNTHETIC_ARROW_ENV);
+    if(value == NULL) return -1;
+
+    // Skip to the cameraNo'th comma separated column.
+    for(uint32_t i = 0; i < cameraNo; i++){
+        value = strchr(value, ',');
+        if(value == NULL) return -1;
+        value++;
+    }
+    return atof(value);
+}
+
+SyntheticFrameSource::SyntheticFrameSource(const char * cameraName, uint32_t cameraNo, AcquisitionMode mode, const SyntheticSettings & settings)
+    : cameraName(cameraName), number(cameraNo), mode(mode), settings(settings),
+      backgroundLine(settings.geometry.pixelsPerLine), shadedLine(settings.geometry.pixelsPerLine), noiseTable(settings.geometry.frameBytes() + NOISE_TABLE_EXTRA),
+      pool(settings.geometry.frameBytes(), 1), buffer(pool.acquire()), rng(settings.seed + cameraNo){
+    // The background varies slowly across the line like the LED strip seen by a real camera.
+    for(size_t i = 0; i < backgroundLine.size(); i++){
+        double level = settings.background + settings.backgroundRipple * sin(2 * M_PI * i / 173.0);
+        backgroundLine[i] = level < 0 ? 0 : level > 255 ? 255 : (int16_t) lround(level);
+    }
+
+    std::normal_distribution<double> gaussian(0, settings.noise);
+    for(size_t i = 0; i < noiseTable.size(); i++){
+        double n = gaussian(rng);
+        noiseTable[i] = n < -127 ? -127 : n > 127 ? 127 : (int8_t) lround(n);
+    }
+}
+
+SyntheticFrameSource::~SyntheticFrameSource(){
+    stopGrabbing();
+}
+
+void SyntheticFrameSource::setArrow(double column, double width){
+    arrowWidth = width;
+    arrowColumn = column;
+}
+
+void SyntheticFrameSource::clearArrow(){
+    arrowColumn = -1;
+}
+
+void SyntheticFrameSource::render(Frame & frame, std::chrono::steady_clock::time_point exposureTime){
+    // Background for this frame with the arrow's shadow.
+    const int width = settings.geometry.pixelsPerLine;
+    int16_t * line = shadedLine.data();
+    memcpy(line, backgroundLine.data(), width*sizeof(int16_t));
+    double column = arrowColumn;
+    if(column >= 0){
+        double halfWidth = arrowWidth / 2;
+        int first = (int) ceil(column - halfWidth);
+        int last  = (int) floor(column + halfWidth);
+        for(int i = first < 0 ? 0 : first; i <= last && i < width; i++){
+            line[i] = (int16_t) (line[i] * settings.shadowLevel);
+        }
+    }
+
+    // Add noise starting from a random offset into the noise table.
+    std::uniform_int_distribution<size_t> offset(0, NOISE_TABLE_EXTRA - 1);
+    const int8_t * noise = noiseTable.data() + offset(rng);
+    for(int l = 0; l < (int) settings.geometry.imageHeight; l++){
+        uint8_t * pixels = buffer + (size_t) l*width;
+        const int8_t * lineNoise = noise + (size_t) l*width;
+        for(int i = 0; i < width; i++){
+            int16_t value = line[i] + lineNoise[i];
+            pixels[i] = value < 0 ? 0 : value > 255 ? 255 : value;
+        }
+    }
+
+    // Chunk data.
+    std::uniform_real_distribution<double> uniform(0, 1);
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(exposureTime - startTime);
+    frame.buffer      = buffer;
+    frame.cameraNo    = number;
+    frame.cameraName  = cameraName.c_str();
+    frame.timestamp   = settings.timestampOffset + (uint64_t) elapsed.count() * TIMESTAMP_TICKS_PER_SECOND / 1000000000;
+    frame.frameNumber = framesGrabbed + 1;
+    frame.hasCRC      = true;
+    frame.crcPassed   = settings.crcFailureRate <= 0 || uniform(rng) >= settings.crcFailureRate;
+}
+
+void SyntheticFrameSource::pace(){
+    if(settings.frameRate <= 0) return;
+
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / settings.frameRate));
+    std::this_thread::sleep_until(nextFrameTime);
+
+    // Don't try to catch up after falling more than a frame behind.
+    auto now = std::chrono::steady_clock::now();
+    nextFrameTime = nextFrameTime + period < now ? now + period : nextFrameTime + period;
+}
+
+void SyntheticFrameSource::grabLoop(){
+    std::unique_lock<std::mutex> lk(m);
+    while(true){
+        if(mode == AcquisitionMode::SoftwareTrigger){
+            cv.wait(lk, [this]{return !grabbing || !triggerTimes.empty();});
+        }
+        if(!grabbing) break;
+
+        // Like a camera, the trigger is taken as soon as the frame starts so the next one can be queued while the handler runs.
+        // A triggered frame is exposed when the trigger was executed.
+        std::chrono::steady_clock::time_point triggerTime;
+        if(mode == AcquisitionMode::SoftwareTrigger){
+            triggerTime = triggerTimes.front();
+            triggerTimes.pop_front();
+        }
+        cv.notify_all();
+
+        // The handler runs without the lock so triggers can be queued while it runs.
+        lk.unlock();
+        pace();
+        Frame frame;
+        render(frame, mode == AcquisitionMode::SoftwareTrigger ? triggerTime : std::chrono::steady_clock::now());
+        try{
+            handler(frame);
+        }
+        catch (const std::exception &e){
+            // Like the pylon grab loop thread, exceptions from the handler are reported and grabbing continues.
+            std::cerr << "Exception in the frame handler for " << cameraName << ": " << e.what() << std::endl;
+        }
+        lk.lock();
+
+        framesGrabbed++;
+        if(framesToGrab > 0 && framesGrabbed >= framesToGrab) grabbing = false;
+        cv.notify_all();
+    }
+}
+
+const char * SyntheticFrameSource::name(){
+    return cameraName.c_str();
+}
+
+uint32_t SyntheticFrameSource::cameraNo(){
+    return number;
+}
+
+SensorGeometry SyntheticFrameSource::geometry(){
+    return settings.geometry;
+}
+
+void SyntheticFrameSource::setFrameHandler(FrameHandler frameHandler){
+    handler = frameHandler;
+}
+
+void SyntheticFrameSource::startGrabbing(uint64_t count){
+    {
+        std::scoped_lock lk(m);
+        grabbing = true;
+        framesToGrab = count;
+        framesGrabbed = 0;
+        triggerTimes.clear();
+        startTime = nextFrameTime = std::chrono::steady_clock::now();
+    }
+    if(handler) grabThread = std::thread(&SyntheticFrameSource::grabLoop, this);
+}
+
+void SyntheticFrameSource::stopGrabbing(){
+    {
+        std::scoped_lock lk(m);
+        grabbing = false;
+    }
+    cv.notify_all();
+    if(grabThread.joinable()) grabThread.join();
+}
+
+bool SyntheticFrameSource::isGrabbing(){
+    std::scoped_lock lk(m);
+    return grabbing;
+}
+
+bool SyntheticFrameSource::retrieveFrame(Frame & frame, uint32_t timeoutMs){
+    std::unique_lock<std::mutex> lk(m);
+    if(!grabbing) return false;
+    std::chrono::steady_clock::time_point triggerTime;
+    if(mode == AcquisitionMode::SoftwareTrigger){
+        if(!cv.wait_for(lk, std::chrono::milliseconds(timeoutMs), [this]{return !triggerTimes.empty();})){
+            throw std::runtime_error("Timed out waiting for a software trigger.");
+        }
+        triggerTime = triggerTimes.front();
+        triggerTimes.pop_front();
+        cv.notify_all();
+    }
+    else if(settings.frameRate > 0 && 1000 / settings.frameRate > timeoutMs){
+        throw std::runtime_error("The synthetic frame rate is too low to grab a frame before the timeout.");
+    }
+    lk.unlock();
+
+    pace();
+    render(frame, mode == AcquisitionMode::SoftwareTrigger ? triggerTime : std::chrono::steady_clock::now());
+
+    lk.lock();
+    framesGrabbed++;
+    if(framesToGrab > 0 && framesGrabbed >= framesToGrab) grabbing = false;
+    return true;
+}
+
+void SyntheticFrameSource::releaseFrame(){
+    // The buffer is reused for the next frame rendered.
+}
+
+bool SyntheticFrameSource::waitForFrameTriggerReady(uint32_t timeoutMs){
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    std::unique_lock<std::mutex> lk(m);
+    if(!cv.wait_until(lk, deadline, [this]{return triggerTimes.empty() || !grabbing;})){
+        throw std::runtime_error("Timed out waiting for the synthetic camera to be ready for a trigger.");
+    }
+
+    // Like a camera, the next trigger isn't accepted until a frame period after the last one.
+    if(grabbing && settings.frameRate > 0){
+        auto readyTime = lastTriggerTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / settings.frameRate));
+        if(readyTime > deadline){
+            throw std::runtime_error("Timed out waiting for the synthetic camera to be ready for a trigger.");
+        }
+        lk.unlock();
+        std::this_thread::sleep_until(readyTime);
+        lk.lock();
+    }
+    return grabbing;
+}
+
+bool SyntheticFrameSource::readClock(uint64_t & ticks){
+    // The same clock as the chunk timestamps in render.
+    std::scoped_lock lk(m);
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime);
+    ticks = settings.timestampOffset + (uint64_t) elapsed.count() * TIMESTAMP_TICKS_PER_SECOND / 1000000000;
+    return true;
+}
+
+void SyntheticFrameSource::executeSoftwareTrigger(){
+    {
+        std::scoped_lock lk(m);
+        lastTriggerTime = std::chrono::steady_clock::now();
+        triggerTimes.push_back(lastTriggerTime);
+    }
+    cv.notify_all();
+}
+
+double SyntheticFrameSource::frameRate(){
+    return settings.frameRate;
+}
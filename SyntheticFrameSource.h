@@ -0,0 +1,145 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_SYNTHETICFRAMESOURCE_H
+#define UNTITLED_SYNTHETICFRAMESOURCE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include "FrameSource.h"
+#include "GrabBufferPool.h"
+
+// Environment variables read by syntheticSettingsFromEnvironment.
+// LSAD_SYNTHETIC_RATE   frames per second, 0 for as fast as possible.
+// LSAD_SYNTHETIC_NOISE  standard deviation of the noise added to each pixel.
+// LSAD_SYNTHETIC_ARROW  column of the arrow shadow for each camera separated by a comma, e.g. "300,700".
+// LSAD_SYNTHETIC_GEOMETRY  size of the frames as WIDTHxHEIGHT, e.g. "512x128".
+#define SYNTHETIC_RATE_ENV  "LSAD_SYNTHETIC_RATE"
+#define SYNTHETIC_NOISE_ENV "LSAD_SYNTHETIC_NOISE"
+#define SYNTHETIC_ARROW_ENV "LSAD_SYNTHETIC_ARROW"
+#define SYNTHETIC_GEOMETRY_ENV "LSAD_SYNTHETIC_GEOMETRY"
+
+// Settings for the frames rendered by a SyntheticFrameSource.
+struct SyntheticSettings
+{
+    // Frames per second. 0 renders frames as fast as possible.
+    double frameRate = 200;
+    // Average brightness of the background and how much it varies across the line.
+    double background = 180;
+    double backgroundRipple = 20;
+    // Standard deviation of the gaussian noise added to every pixel.
+    double noise = 2;
+    // Brightness inside the arrow shadow as a fraction of the background.
+    double shadowLevel = 0.2;
+    // Fraction of frames that fail the CRC check.
+    double crcFailureRate = 0;
+    // Added to every chunk timestamp to simulate cameras with unsynchronized clocks.
+    uint64_t timestampOffset = 0;
+    // Seed for the noise.
+    uint32_t seed = 1;
+    // Size of the frames rendered.
+    SensorGeometry geometry;
+};
+
+// Default settings changed by the SYNTHETIC_*_ENV environment variables. Throws on a geometry it can't read.
+SyntheticSettings syntheticSettingsFromEnvironment();
+
+// Arrow column for cameraNo from SYNTHETIC_ARROW_ENV, or a negative number when there isn't one.
+double syntheticArrowFromEnvironment(uint32_t cameraNo);
+
+// Renders frames of settings.geometry without a camera.
+// Each column has its own background level with gaussian noise, and an arrow blocks a band of columns when set.
+// Frames have chunk timestamps and CRC flags like a Basler camera and are paced to settings.frameRate.
+class SyntheticFrameSource : public FrameSource {
+private:
+    std::string cameraName;
+    uint32_t number;
+    AcquisitionMode mode;
+    SyntheticSettings settings;
+
+    // Background brightness of each column.
+    std::vector<int16_t> backgroundLine;
+    // The background of the frame being rendered with the arrow's shadow.
+    std::vector<int16_t> shadedLine;
+    // Noise is copied from a random offset into this table so rendering a frame doesn't call the random number generator per pixel.
+    std::vector<int8_t> noiseTable;
+    // Frames are rendered into a grab buffer from the same kind of pool a camera grabs into.
+    GrabBufferPool pool;
+    uint8_t * buffer;
+    std::mt19937 rng;
+
+    // Arrow shadow band. A negative column means there's no arrow.
+    std::atomic<double> arrowColumn{-1};
+    std::atomic<double> arrowWidth{6};
+
+    FrameHandler handler;
+    std::thread grabThread;
+    std::mutex m;
+    std::condition_variable cv;
+    bool grabbing = false;
+    uint64_t framesToGrab = 0;
+    uint64_t framesGrabbed = 0;
+    // Times of the software triggers not taken by a frame yet.
+    std::deque<std::chrono::steady_clock::time_point> triggerTimes;
+    std::chrono::steady_clock::time_point lastTriggerTime;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point nextFrameTime;
+
+    // Render the next frame into buffer. The chunk timestamp is taken from exposureTime.
+    void render(Frame & frame, std::chrono::steady_clock::time_point exposureTime);
+
+    // Sleep until the next frame is due at settings.frameRate.
+    void pace();
+
+    // Body of grabThread when a handler is set.
+    void grabLoop();
+public:
+    SyntheticFrameSource(const char * cameraName, uint32_t cameraNo, AcquisitionMode mode, const SyntheticSettings & settings);
+    ~SyntheticFrameSource() override;
+
+    // Put the center of an arrow's shadow at column, blocking width columns. Takes effect on the next frame.
+    void setArrow(double column, double width);
+
+    // Remove the arrow.
+    void clearArrow();
+
+    const char * name() override;
+    uint32_t cameraNo() override;
+    SensorGeometry geometry() override;
+    void setFrameHandler(FrameHandler handler) override;
+    void startGrabbing(uint64_t count = 0) override;
+    void stopGrabbing() override;
+    bool isGrabbing() override;
+    bool retrieveFrame(Frame & frame, uint32_t timeoutMs) override;
+    void releaseFrame() override;
+    bool waitForFrameTriggerReady(uint32_t timeoutMs) override;
+    void executeSoftwareTrigger() override;
+    bool readClock(uint64_t & ticks) override;
+    double frameRate() override;
+};
+
+#endif //UNTITLED_SYNTHETICFRAMESOURCE_H
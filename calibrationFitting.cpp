@@ -0,0 +1,223 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "calibrationFitting.h"
+#include "camerasettings.h"
+#include "DatabaseService.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Relative size of a diagonal element of R below which the points don't determine a coefficient.
+#define RANK_TOLERANCE 1e-10
+
+void calibrationFeatures(double L45, double L90, double * features){
+    double u = L45 / PIXELS_PER_LINE;
+    double v = L90 / PIXELS_PER_LINE;
+    for(int d = 0; d <= COEFFICIENTS_DEGREE; d++){
+        for(int j = 0; j <= d; j++){
+            features[d*(d+1)/2 + j] = std::pow(u, d - j) * std::pow(v, j);
+        }
+    }
+}
+
+void unscaleCoefficients(double * coefficients){
+    // L45^i L90^j was scaled by PIXELS_PER_LINE^(i+j).
+    for(int d = 0; d <= COEFFICIENTS_DEGREE; d++){
+        double scale = std::pow((double) PIXELS_PER_LINE, d);
+        for(int j = 0; j <= d; j++) coefficients[d*(d+1)/2 + j] /= scale;
+    }
+}
+
+CalibrationFit fitCalibration(const std::vector<struct DataPoint> & data){
+    const size_t rows = data.size();
+    const int columns = NUM_COEFFICIENTS;
+    if(rows < (size_t) columns){
+        throw std::runtime_error("At least " + std::to_string(columns) + " training points are needed for a calibration. There are "
+                                 + std::to_string(rows) + ".");
+    }
+
+    // Design matrix stored by column, one row of calibrationFeatures per point.
+    std::vector<double> a(rows * columns);
+    std::vector<double> bx(rows), by(rows);
+    for(size_t r = 0; r < rows; r++){
+        double features[NUM_COEFFICIENTS];
+        calibrationFeatures(data[r].L45, data[r].L90, features);
+        for(int c = 0; c < columns; c++) a[(size_t) c * rows + r] = features[c];
+        bx[r] = data[r].x;
+        by[r] = data[r].y;
+    }
+
+    // Householder QR. Each reflection zeroes one column below the diagonal and is applied to both right hand sides.
+    double largestDiagonal = 0;
+    for(int k = 0; k < columns; k++){
+        double * column = a.data() + (size_t) k * rows;
+        double norm = 0;
+        for(size_t r = k; r < rows; r++) norm += column[r] * column[r];
+        norm = std::sqrt(norm);
+        largestDiagonal = std::max(largestDiagonal, norm);
+        if(norm <= RANK_TOLERANCE * largestDiagonal){
+            throw std::runtime_error("The training points don't determine every coefficient. Collect points across the whole screen.");
+        }
+
+        // v = x + sign(x0)|x| e0 is kept in the column below the diagonal. R's diagonal element is -sign(x0)|x|.
+        double alpha = column[k] > 0 ? -norm : norm;
+        column[k] -= alpha;
+        double vNorm2 = 0;
+        for(size_t r = k; r < rows; r++) vNorm2 += column[r] * column[r];
+
+        auto reflect = [&](double * target){
+            double dot = 0;
+            for(size_t r = k; r < rows; r++) dot += column[r] * target[r];
+            double scale = 2 * dot / vNorm2;
+            for(size_t r = k; r < rows; r++) target[r] -= scale * column[r];
+        };
+        for(int c = k + 1; c < columns; c++) reflect(a.data() + (size_t) c * rows);
+        reflect(bx.data());
+        reflect(by.data());
+        column[k] = alpha;
+    }
+
+    // Back substitution with R, then undo the pixel scaling.
+    CalibrationFit fit = {};
+    fit.points = rows;
+    for(int k = columns - 1; k >= 0; k--){
+        double sx = bx[k], sy = by[k];
+        for(int c = k + 1; c < columns; c++){
+            double rkc = a[(size_t) c * rows + k];
+            sx -= rkc * fit.xCoefficients[c];
+            sy -= rkc * fit.yCoefficients[c];
+        }
+        double rkk = a[(size_t) k * rows + k];
+        fit.xCoefficients[k] = sx / rkk;
+        fit.yCoefficients[k] = sy / rkk;
+    }
+    unscaleCoefficients(fit.xCoefficients);
+    unscaleCoefficients(fit.yCoefficients);
+
+    // Residuals of the fitted coefficients on the training points.
+    BivariatePolynomial<COEFFICIENTS_DEGREE> xPolynomial(fit.xCoefficients), yPolynomial(fit.yCoefficients);
+    double sumX = 0, sumY = 0;
+    for(const struct DataPoint & point : data){
+        double ex = xPolynomial.evaluate(point.L45, point.L90) - point.x;
+        double ey = yPolynomial.evaluate(point.L45, point.L90) - point.y;
+        sumX += ex * ex;
+        sumY += ey * ey;
+    }
+    fit.rmsErrorX = std::sqrt(sumX / rows);
+    fit.rmsErrorY = std::sqrt(sumY / rows);
+    return fit;
+}
+
+CameraSamples & samplesFor(std::vector<CameraSamples> & cameras, const std::string & cameraName){
+    for(CameraSamples & camera : cameras){
+        if(camera.cameraName == cameraName) return camera;
+    }
+    cameras.push_back({cameraName, {}});
+    return cameras.back();
+}
+
+std::vector<CameraSamples> cameraSamples(const std::vector<struct DataPoint> & data, const std::vector<std::string> & names){
+    std::vector<CameraSamples> cameras;
+    for(size_t sensor = 0; sensor < 2 && sensor < names.size(); sensor++){
+        CameraSamples & camera = samplesFor(cameras, names[sensor]);
+        camera.samples.reserve(data.size());
+        for(const struct DataPoint & point : data){
+            camera.samples.push_back({sensor == 0 ? point.L45 : point.L90, (double) point.x, (double) point.y});
+        }
+    }
+    return cameras;
+}
+
+std::vector<SensorLine> fitSensorLines(const std::vector<CameraSamples> & cameras, std::vector<std::string> & errors){
+    std::vector<SensorLine> lines(cameras.size());
+    for(size_t sensor = 0; sensor < cameras.size(); sensor++){
+        try{
+            lines[sensor] = fitSensorLine(cameras[sensor].samples);
+        }
+        catch(const std::runtime_error & e){
+            errors.push_back(cameras[sensor].cameraName + ": " + e.what());
+        }
+    }
+    return lines;
+}
+
+std::vector<std::string> cameraSampleNames(const std::vector<CameraSamples> & cameras){
+    std::vector<std::string> names;
+    for(const CameraSamples & camera : cameras) names.push_back(camera.cameraName);
+    return names;
+}
+
+std::vector<CameraSamples> readTrainingPixelsFromDB(const char * filename, const std::string & timeCreated){
+    // The table doesn't exist until the training program writes pixels.
+    DatabaseService & database = DatabaseService::forFile(filename);
+    database.enqueue({{CREATE_TRAINING_PIXELS_TABLE_STATEMENT, {}}});
+    DatabaseSession session = database.session();
+    sqlite3 *db = session.db();
+
+    std::vector<CameraSamples> cameras;
+    sqlite3_stmt * stmt = session.statement(SELECT_TRAINING_PIXELS_STATEMENT);
+    SQLite3_CHECK(sqlite3_bind_text(stmt,1,timeCreated.c_str(),-1,NULL),db);
+    while(SQLite3_CHECK(sqlite3_step(stmt),db) == SQLITE_ROW){
+        std::string cameraName = reinterpret_cast<const char*>(sqlite3_column_text(stmt,0));
+        samplesFor(cameras, cameraName).samples.push_back({sqlite3_column_double(stmt,1),
+                                                          (double) sqlite3_column_int64(stmt,2),
+                                                          (double) sqlite3_column_int64(stmt,3)});
+    }
+    return cameras;
+}
+
+// The coefficients row for fit with timeCreated last.
+static DatabaseRow coefficientsRow(const CalibrationFit & fit, const std::string & timeCreated){
+    DatabaseRow coefficients = {INSERT_COEFFICIENTS_STATEMENT, {}};
+    for(int i = 0; i < NUM_COEFFICIENTS; i++) coefficients.values.push_back(fit.xCoefficients[i]);
+    for(int i = 0; i < NUM_COEFFICIENTS; i++) coefficients.values.push_back(fit.yCoefficients[i]);
+    coefficients.values.push_back(timeCreated);
+    return coefficients;
+}
+
+std::string writeCalibrationToDB(const CalibrationFit & fit, const char * filename){
+    // Use the current datetime the same way regression_fitting.py does.
+    std::string currentDatetime = localDatetime();
+
+    // Create the table if it doesn't exist and insert the coefficients.
+    DatabaseService::forFile(filename).enqueue({{CREATE_COEFFICIENTS_TABLE_STATEMENT, {}}, coefficientsRow(fit, currentDatetime)});
+    return currentDatetime;
+}
+
+std::string writeTrainingToDB(const std::vector<struct DataPoint> & data, const std::vector<CameraSamples> & pixels,
+                              const CalibrationFit * fit, const char * filename){
+    std::string currentDatetime = localDatetime();
+    std::vector<DatabaseRow> rows = dataPointRows(data, currentDatetime);
+    rows.push_back({CREATE_TRAINING_PIXELS_TABLE_STATEMENT, {}});
+    for(const CameraSamples & camera : pixels){
+        for(const SensorSample & sample : camera.samples){
+            rows.push_back({INSERT_TRAINING_PIXEL_STATEMENT, {(int64_t) sample.x, (int64_t) sample.y, camera.cameraName,
+                                                              sample.pixel, currentDatetime}});
+        }
+    }
+    if(fit != nullptr){
+        rows.push_back({CREATE_COEFFICIENTS_TABLE_STATEMENT, {}});
+        rows.push_back(coefficientsRow(*fit, currentDatetime));
+    }
+    DatabaseService::forFile(filename).enqueue(std::move(rows));
+    return currentDatetime;
+}
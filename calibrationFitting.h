@@ -0,0 +1,98 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_CALIBRATIONFITTING_H
+#define UNTITLED_CALIBRATIONFITTING_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "SQLitefunctions.h"
+#include "ScreenPositionEstimator.h"
+#include "SensorFusion.h"
+
+// Every camera's pixel for each training point, so a line can be fitted for any number of cameras.
+// trainingData only holds the first two cameras' pixels, for the coefficients.
+#define CREATE_TRAINING_PIXELS_TABLE_STATEMENT "CREATE TABLE IF NOT EXISTS trainingPixels ('x' INTEGER, 'y' INTEGER, \
+'cameraName' TEXT, 'pixel' REAL, 'timeCreated' TEXT);"
+#define INSERT_TRAINING_PIXEL_STATEMENT "INSERT INTO trainingPixels VALUES (?,?,?,?,?);"
+#define SELECT_TRAINING_PIXELS_STATEMENT "SELECT cameraName, pixel, x, y FROM trainingPixels WHERE timeCreated=? ORDER BY rowid;"
+
+// Coefficients for ScreenPositionEstimator fitted to training data.
+struct CalibrationFit
+{
+    // In the column order of the coefficients table.
+    double xCoefficients[NUM_COEFFICIENTS];
+    double yCoefficients[NUM_COEFFICIENTS];
+    // Root mean square distance between the training points and the fitted positions in screen pixels.
+    double rmsErrorX;
+    double rmsErrorY;
+    size_t points;
+};
+
+// Fill features with the NUM_COEFFICIENTS terms of the polynomial for a point, in the column order of the
+// coefficients table. The pixels are scaled to 0-1 first, so every term is between 0 and 1.
+void calibrationFeatures(double L45, double L90, double * features);
+
+// Turn coefficients fitted to calibrationFeatures into coefficients of the unscaled pixels.
+void unscaleCoefficients(double * coefficients);
+
+// Least squares fit of x and y to a fourth order polynomial of the L45 and L90 pixels,
+// the same fit regression_fitting.py makes with scikit-learn.
+// Solved with a Householder QR decomposition of the design matrix. Pixels are scaled to 0-1 for the decomposition
+// and the coefficients scaled back, so the fourth powers don't swamp the first.
+// Throws if there are fewer points than coefficients or the points don't determine every coefficient.
+CalibrationFit fitCalibration(const std::vector<struct DataPoint> & data);
+
+// The training points one camera saw.
+struct CameraSamples
+{
+    std::string cameraName;
+    std::vector<SensorSample> samples;
+};
+
+// The samples of the camera named cameraName in cameras, added to the end when it isn't there yet.
+CameraSamples & samplesFor(std::vector<CameraSamples> & cameras, const std::string & cameraName);
+
+// The L45 and L90 pixels of data as samples of the first two cameras in names. Used for training data collected
+// before trainingPixels.
+std::vector<CameraSamples> cameraSamples(const std::vector<struct DataPoint> & data, const std::vector<std::string> & names);
+
+// Fit the line of every camera in cameras, in the same order. A camera whose points don't determine
+// its line is left uncalibrated and the reason is put in errors.
+std::vector<SensorLine> fitSensorLines(const std::vector<CameraSamples> & cameras, std::vector<std::string> & errors);
+
+// The names of cameras, in order, for writeSensorLinesToDB.
+std::vector<std::string> cameraSampleNames(const std::vector<CameraSamples> & cameras);
+
+// Every camera's samples in the trainingPixels table of an SQLite file collected at timeCreated, in the order the
+// cameras first appear. Returns none when there are no rows for timeCreated.
+std::vector<CameraSamples> readTrainingPixelsFromDB(const char * filename, const std::string & timeCreated);
+
+// Add a row to the coefficients table of an SQLite file and return its timeCreated.
+std::string writeCalibrationToDB(const CalibrationFit & fit, const char * filename);
+
+// Write the training data points, every camera's samples and, unless fit is null, the coefficients fitted to them
+// to an SQLite file in one transaction with the same timeCreated, which is returned.
+std::string writeTrainingToDB(const std::vector<struct DataPoint> & data, const std::vector<CameraSamples> & pixels,
+                              const CalibrationFit * fit, const char * filename);
+
+#endif //UNTITLED_CALIBRATIONFITTING_H
@@ -21,116 +21,149 @@
 // Event handlers in Basler C++ samples were used as a starting point.
 
 #include "cameraEvent.h"
+#include "DetectionPipeline.h"
+#include "LatencyTrace.h"
+#include "errorCheckingMacros.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
 
 using std::cout, std::endl, std::cerr;
-using namespace Pylon;
 
-__global__ void aboveThresholdCalc(const uint32_t* thresholdLine, const uint8_t* b, uint32_t* c, int N){
-    uint32_t idx = (hipBlockIdx_x * hipBlockDim_x + hipThreadIdx_x);
-
-    if (idx < N) {
-        if(thresholdLine[hipThreadIdx_x] > (((uint32_t) b[idx]))) atomicAdd(c+hipThreadIdx_x,1);
+// Add result to the camera's ring. The ring only fills up if the main loop stops taking results.
+static void publishResult(CameraContext & camera, const DetectionResult & result){
+    if(!camera.results.tryPush(result)){
+        cerr << "The detection results for camera " << result.cameraNo << " are full. A result was dropped.\n";
     }
 }
 
-void SoftwareTriggerImageEventHandler::OnImageGrabbed(Camera_t& camera, const GrabResultPtr_t& ptrGrabResult){
-    // Get the user defined name for the camera.
-    // Determine which camera is being used from the user defined name and set cameraNo.
-    String_t cameraName = camera.GetDeviceInfo().GetUserDefinedName();
-    uint32_t cameraNo;
-    if(cameraName == CAMERA_NAME_0){
-        cameraNo = 0;
-    }
-    else if(cameraName == CAMERA_NAME_1){
-        cameraNo = 1;
-    }
-    else{
-        throw RUNTIME_EXCEPTION("No Matching Camera Name.");
+void useAdaptiveBaseline(DetectorContext & context, uint32_t timeConstantFrames){
+    for(uint32_t i = 0; i < context.cameraCount(); i++){
+        context.camera(i).adaptiveBaseline.setTimeConstant(timeConstantFrames);
     }
+}
 
-    // Gain control of the mutex used to block the main loop while in the camera event handler scope.
-    // May not be necessary, but prevents it from being modified in another scope causing a spurious wakeup
-    // before the camera event finishes executing.
-    // The lock is automatically removed when the function ends.
-    std::scoped_lock event_lk(m[cameraNo]);
+// Compare frame to the camera's threshold, fill in result and set the camera's column mask to the blocked columns.
+// result.valid is false and nothing else is measured when the frame doesn't pass its CRC check.
+static void measureFrame(CameraContext & camera, const Frame & frame, DetectionResult & result){
+    uint32_t cameraNo = camera.cameraNo;
+    const SensorGeometry & geometry = camera.geometry;
+    LSAD_TRACE(FrameGrabbed, cameraNo, frame.frameNumber);
+
+    result = {};
+    result.cameraNo = cameraNo;
+    result.timestamp = frame.timestamp;
+    result.frameNumber = frame.frameNumber;
 
     // The images being grabbed should have a CRC and the CRC should pass.
-    if(ptrGrabResult->HasCRC()) {
-        if (ptrGrabResult->CheckCRC() == false) {
-            throw RUNTIME_EXCEPTION("Image failed CRC check.");
-        }
+    if(!frame.hasCRC || !frame.crcPassed) return;
+    result.valid = true;
+    LSAD_TRACE(CrcVerified, cameraNo, frame.frameNumber);
+
+    // Hold the threshold for the whole frame. A reload publishing a new one doesn't free this one until the frame is done.
+    std::shared_ptr<const DetectionThreshold> threshold = std::atomic_load(&camera.threshold);
+
+#ifdef LSAD_USE_HIP
+    if(currentDetectionBackend() == DetectionBackend::GPU) {
+        // Reset aboveThresholdCount to zero on the GPU.
+        HIP_CHECK(hipMemset(camera.aboveThresholdCount_d, 0, geometry.pixelsPerLine*sizeof(uint32_t)));
+
+        // Copy the grabbed frame to the GPU. Grab buffers are registered with the HIP runtime, so it's one DMA transfer.
+        HIP_CHECK(hipMemcpy(camera.grabResult_d, frame.buffer, geometry.frameBytes(), hipMemcpyHostToDevice));
+
+        // Count the number of pixels above the threshold in the grab result and copy the result back to the host.
+        aboveThresholdCalcGPU(threshold->thresholdLine_d, camera.grabResult_d, camera.aboveThresholdCount_d, geometry);
+        HIP_CHECK(hipMemcpy(camera.aboveThresholdCount_h.data(), camera.aboveThresholdCount_d,
+                            geometry.pixelsPerLine*sizeof(uint32_t), hipMemcpyDeviceToHost));
     }
-    else{
-        throw RUNTIME_EXCEPTION("Image doesn't have CRC.");
+    else
+#endif
+    {
+        // Count the number of pixels above the threshold directly from the grab buffer on the CPU.
+        aboveThresholdCalcCPU(threshold->baseline.thresholdLine.data(), frame.buffer, camera.aboveThresholdCount_h.data(),
+                              geometry);
     }
 
-    // Reset aboveThresholdCount to zero on the GPU.
-    HIP_CHECK(hipMemset(aboveThresholdCount_d[cameraNo], 0, PIXELS_PER_LINE*sizeof(uint32_t)));
-
-    // Copy the grabbed frame to the GPU.
-    HIP_CHECK(hipMemcpy(grabResult_d[cameraNo], ptrGrabResult->GetBuffer(), PIXELS_PER_LINE*IMAGE_HEIGHT, hipMemcpyHostToDevice));
-
-    // Count the number of pixels above the threshold in the grab result and copy the result back to the host.
-    hipLaunchKernelGGL(aboveThresholdCalc, dim3(IMAGE_HEIGHT), dim3(PIXELS_PER_LINE), 0, 0,
-                       Baseline_d[cameraNo]->thresholdLine, grabResult_d[cameraNo], aboveThresholdCount_d[cameraNo],
-                       IMAGE_HEIGHT * PIXELS_PER_LINE);
-    HIP_CHECK(hipGetLastError());
-    HIP_CHECK(hipMemcpy(aboveThresholdCount_h[cameraNo], aboveThresholdCount_d[cameraNo], PIXELS_PER_LINE*sizeof(uint32_t), hipMemcpyDeviceToHost));
-
-    // Write the number of pixels detected to the terminal.
-    //cout << camera.GetDeviceInfo().GetUserDefinedName() <<": Object Detected at the following pixels.\n" << endl;
-    uint32_t totalPixels = 0;
-    uint32_t pixelSum = 0;
-
-    // If half of the pixels in an image above the threshold, Consider an object to be blocking light to that pixel.
-    // Every pixel above the threshold is given an equal weight for calculating the average pixel.
-    for(int i = 0; i < PIXELS_PER_LINE; i++){
-        if(aboveThresholdCount_h[cameraNo][i] > IMAGE_HEIGHT/2){
-            cout << camera.GetDeviceInfo().GetUserDefinedName() << " : " << i << " : " << aboveThresholdCount_h[cameraNo][i] << endl;
-            totalPixels++;
-            pixelSum += i;
-        }
+    // Frames keep the threshold following the light when the adaptive baseline is used.
+    camera.adaptiveBaseline.addFrame(camera, frame.buffer, camera.aboveThresholdCount_h.data(), threshold);
+
+    // If half of the pixels in a column are above the threshold, consider an object to be blocking light to that column.
+    // Each run of blocked columns is a separate object, so two arrows give two positions instead of one between them.
+    const uint32_t * count = camera.aboveThresholdCount_h.data();
+    blockedColumnMask(count, camera.columnMask.data(), geometry);
+    result.runCount = segmentColumns(count, camera.columnMask.data(), result.runs, MAX_COLUMN_RUNS, geometry);
+    result.detected = result.runCount > 0;
+    LSAD_TRACE(DetectionDone, cameraNo, frame.frameNumber);
+}
+
+// Print each run in result.
+static void printRuns(const char * cameraName, const char * what, const DetectionResult & result){
+    for(uint32_t i = 0; i < result.runCount; i++){
+        const ColumnRun & run = result.runs[i];
+        cout << cameraName << ": " << what << " at pixels " << run.firstColumn << " - " << run.lastColumn
+             << " centered at " << run.centroid << ".\n";
     }
+}
 
-    // Set the global variables that will be written to an SQLite file for calibration.
-    if(cameraName == CAMERA_NAME_0 && totalPixels > 0){
-        cout << "Set pixelCamera0.\n";
-        pixelCamera0 = pixelSum / totalPixels;
-        cout << camera.GetDeviceInfo().GetUserDefinedName() <<": Object Detected at the average pixel above.\n" << endl;
+void detectObjectInCamera(CameraContext & camera, const Frame & frame){
+    DetectionResult result;
+    measureFrame(camera, frame, result);
+
+    // A result is still published for a failed frame so the main loop doesn't wait for it.
+    if(!result.valid) {
+        publishResult(camera, result);
+        throw std::runtime_error(frame.hasCRC ? "Image failed CRC check." : "Image doesn't have CRC.");
     }
-    else if(cameraName == CAMERA_NAME_1 && totalPixels > 0){
-        cout << "Set pixelCamera1.\n";
-        pixelCamera1 = pixelSum / totalPixels;
-        cout << camera.GetDeviceInfo().GetUserDefinedName() <<": Object Detected at the average pixel above.\n" << endl;
+
+    printRuns(frame.cameraName, "Object detected", result);
+
+    // Hand the result to the main loop.
+    publishResult(camera, result);
+}
+
+void detectObject(const Frame & frame){
+    // The camera number is determined from the user defined name by the frame source.
+    detectObjectInCamera(detectorContext().camera(frame.cameraNo), frame);
+}
+
+void detectImpactInCamera(CameraContext & camera, const Frame & frame){
+    DetectionResult result;
+    measureFrame(camera, frame, result);
+
+    // A failed frame doesn't end or start an impact. The correlator reports the other camera's impact
+    // as unmatched if this frame held its partner.
+    if(!result.valid) {
+        cerr << frame.cameraName << ": Frame " << frame.frameNumber
+             << (frame.hasCRC ? " failed CRC check." : " doesn't have CRC.") << " Skipping it.\n";
+        return;
     }
 
-    // Unlock the mutex for the camera number in the main loop.
-    // Only the thread for the main loop should be waiting.
-    cameraEventComplete[cameraNo] = true;
-    cv[cameraNo].notify_one();
+    // Columns blocked in any of the recent frames.
+    ImpactState & state = camera.impactState;
+    std::vector<uint64_t> & recent = state.recent;
+    std::fill(recent.begin(), recent.end(), 0);
+    for(uint32_t n = 0; n < IMPACT_CLEAR_FRAMES; n++){
+        for(size_t word = 0; word < recent.size(); word++) recent[word] |= state.recentMasks[n][word];
+    }
+    state.recentMasks[state.next] = camera.columnMask;
+    state.next = (state.next + 1) % IMPACT_CLEAR_FRAMES;
+
+    // Keep the runs over columns that were clear. Runs continuing from earlier frames were already reported.
+    uint32_t newRuns = 0;
+    for(uint32_t i = 0; i < result.runCount; i++){
+        if(!columnsSet(recent.data(), result.runs[i].firstColumn, result.runs[i].lastColumn)){
+            result.runs[newRuns++] = result.runs[i];
+        }
+    }
+    result.runCount = newRuns;
+    result.detected = newRuns > 0;
+    if(!result.detected) return;
 
-    // Write the thread ID and camera name for the camera event handler.
-    //cout << "Event Handler Exiting. Thread ID: " << std::this_thread::get_id() << " Camera: " << cameraName << endl;
+    printRuns(frame.cameraName, "Impact", result);
+    publishResult(camera, result);
 }
 
-// Example of a device-specific handler for image events.
-void ContinousAcquisitionImageEventHandler::OnImageGrabbed( Camera_t& camera, const GrabResultPtr_t& ptrGrabResult){
-    // The chunk data is attached to the grab result and can be accessed anywhere.
-
-    // Generic parameter access:
-    // This shows the access via the chunk data node map. This method is available for all grab result types.
-    GenApi::CIntegerPtr chunkTimestamp( ptrGrabResult->GetChunkDataNodeMap().GetNode( "ChunkTimestamp"));
-
-    // Access the chunk data attached to the result.
-    // Before accessing the chunk data, you should check to see
-    // if the chunk is readable. When it is readable, the buffer
-    // contains the requested chunk data.
-    if ( IsReadable( chunkTimestamp))
-        cout << "OnImageGrabbed: TimeStamp (Result) accessed via node map: " << chunkTimestamp->GetValue() << endl;
-
-    // Native parameter access:
-    // When using the device-specific grab results the chunk data can be accessed
-    // via the members of the grab result data.
-    if ( IsReadable(ptrGrabResult->ChunkTimestamp))
-        cout << "OnImageGrabbed: TimeStamp (Result) accessed via result member: " << ptrGrabResult->ChunkTimestamp.GetValue() << endl;
+void detectImpact(const Frame & frame){
+    detectImpactInCamera(detectorContext().camera(frame.cameraNo), frame);
 }
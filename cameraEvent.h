@@ -21,28 +21,31 @@
 #ifndef UNTITLED_CAMERAEVENT_H
 #define UNTITLED_CAMERAEVENT_H
 
-#include "main_training.h"
 #include "globals.h"
 #include "camerasettings.h"
+#include "cpuDetection.h"
+#include "gpuDetection.h"
+#include "FrameSource.h"
+#include "AdaptiveBaseline.h"
 #include <thread>
 
-// Compares the a frame grabbed to the threshold and calculates the number of pixels for each line below the threshold.
-__global__ void aboveThresholdCalc(const uint32_t* thresholdLine, const uint8_t* b, uint32_t* c, int N);
-
-// Event handler used with software triggering.
-// Sets the global variables for the pixels blocked on each camera.
-class SoftwareTriggerImageEventHandler : public ImageEventHandler_t
-{
-public:
-    virtual void OnImageGrabbed( Camera_t& camera, const GrabResultPtr_t& ptrGrabResult);
-};
-
-// Event handler used with continous acquisition.
-// Only prints information for debugging.
-class ContinousAcquisitionImageEventHandler : public ImageEventHandler_t
-{
-public:
-    virtual void OnImageGrabbed( Camera_t& camera, const GrabResultPtr_t& ptrGrabResult);
-};
+// Adapt the baseline of the cameras in context to frames with a time constant of timeConstantFrames,
+// or keep the published one with 0. Must be called before grabbing starts.
+void useAdaptiveBaseline(DetectorContext & context, uint32_t timeConstantFrames);
+
+// Frame handler used with software triggering. Measures the frame for camera frame.cameraNo of detectorContext().
+// Publishes a DetectionResult for every frame to the camera's results ring without taking a lock.
+void detectObject(const Frame & frame);
+
+// detectObject for a camera of another context, used by handlers bound to a lane's camera.
+void detectObjectInCamera(CameraContext & camera, const Frame & frame);
+
+// Frame handler used with continuous acquisition.
+// Every frame is compared to the threshold, but a DetectionResult is only published to the camera's results ring
+// when a new run of blocked columns appears. It holds only the new runs. Frames failing their CRC check are skipped.
+void detectImpact(const Frame & frame);
+
+// detectImpact for a camera of another context.
+void detectImpactInCamera(CameraContext & camera, const Frame & frame);
 
 #endif //UNTITLED_CAMERAEVENT_H
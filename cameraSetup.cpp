@@ -21,7 +21,6 @@
 // Based on Basler C++ samples for setting up cameras.
 
 #include "cameraSetup.h"
-#include "cameraEvent.h"
 
 void camSetup(Camera_t & camera, Pylon::CDeviceInfo & device, Pylon::CTlFactory& tlFactory){
     // Camera must be open before setting gain, and exposure time.
@@ -62,9 +61,6 @@ void camSetupSoftwareTrigger(Camera_t & camera, Pylon::CDeviceInfo & device, Pyl
 
     // Open the camera device and set parameters used for all configurations.
     camSetup(camera,device,tlFactory);
-
-    // Register an event handler.
-    camera.RegisterImageEventHandler( new SoftwareTriggerImageEventHandler, Pylon::RegistrationMode_Append, Pylon::Cleanup_Delete);
 }
 
 void camSetupContinous(Camera_t & camera, Pylon::CDeviceInfo & device, Pylon::CTlFactory& tlFactory){
@@ -79,6 +75,11 @@ void camSetupContinous(Camera_t & camera, Pylon::CDeviceInfo & device, Pylon::CT
     // Open the camera device and set parameters used for all configurations.
     camSetup(camera,device,tlFactory);
 
-    // Register an event handler.
-    camera.RegisterImageEventHandler( new ContinousAcquisitionImageEventHandler, Pylon::RegistrationMode_Append, Pylon::Cleanup_Delete);
+    // Free run at the fastest line rate the exposure time allows so an arrow can't pass between frames.
+    if (GenApi::IsWritable(camera.AcquisitionLineRateAbs)){
+        camera.AcquisitionLineRateAbs.SetValue(camera.AcquisitionLineRateAbs.GetMax());
+    }
+
+    // Extra buffers let the camera keep grabbing while the grab thread is held up by a slow frame.
+    camera.MaxNumBuffer.SetValue(CONTINUOUS_GRAB_BUFFERS);
 }
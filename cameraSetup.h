@@ -22,7 +22,8 @@
 #define UNTITLED_CAMERASETUP_H
 
 #include "camerasettings.h"
-#include "cameraEvent.h"
+
+// Used by PylonFrameSource, which registers its own image event handler.
 
 // Called by the camSetupSoftwareTrigger and camSetupContinous.
 // Should not be called directly.
@@ -21,6 +21,9 @@
 #ifndef UNTITLED_CAMERASETTINGS_H
 #define UNTITLED_CAMERASETTINGS_H
 
+#include <cstdint>
+
+#ifdef LSAD_USE_PYLON
 // Include files to use the pylon API
 #include <pylon/PylonIncludes.h>
 
@@ -30,24 +33,36 @@ typedef Pylon::CBaslerGigEInstantCamera Camera_t;
 typedef Pylon::CBaslerGigEImageEventHandler ImageEventHandler_t; // Or use Camera_t::ImageEventHandler_t
 typedef Pylon::CBaslerGigEGrabResultPtr GrabResultPtr_t; // Or use Camera_t::GrabResultPtr_t
 using namespace Basler_GigECameraParams;
+#endif //LSAD_USE_PYLON
 
 // Include files used by samples.
 //#include "/opt/pylon5/Samples/C++/include/ConfigurationEventPrinter.h"
 //#include "/opt/pylon5/Samples/C++/include/ImageEventPrinter.h"
 
 //Camera Settings
-#define CAMERA_NAME_0 "L45"
-#define CAMERA_NAME_1 "L90"
+// User defined names of the cameras when LSAD_CAMERA_NAMES isn't set. A camera's number is its position in the list.
+#define DEFAULT_CAMERA_NAMES "L45,L90"
 #define CAMERA_GAIN 625
 #define CAMERA_EXPOSURE_TIME 32
+// Default frame size. A camera can send frames of another size, see SensorGeometry in CameraConfiguration.h.
+// Detection has a faster build for frames PIXELS_PER_LINE wide.
 #define PIXELS_PER_LINE 1024
 #define IMAGE_HEIGHT 256
 
+// Buffers queued to each camera when free running.
+// 64 buffers hold at least a quarter of a second of frames at the maximum line rate.
+#define CONTINUOUS_GRAB_BUFFERS 64
+
+// Chunk timestamps count ticks of the camera's 125 MHz clock.
+#define TIMESTAMP_TICKS_PER_SECOND 125000000
+
 //Baseline Collection Settings
+// The streaming baseline uses the same memory for any number of samples.
+// LSAD_BASELINE_BACKEND=gpu holds every frame in GPU memory and is limited to 16383 samples.
 #define NUM_SAMPLES 4096
 
 // Total number of pixel datapoints.
-#define NUM_DATAPOINTS PIXELS_PER_LINE*IMAGE_HEIGHT*NUM_SAMPLES
+#define NUM_DATAPOINTS ((uint64_t) PIXELS_PER_LINE*IMAGE_HEIGHT*NUM_SAMPLES)
 
 
 #endif //UNTITLED_CAMERASETTINGS_H
@@ -0,0 +1,101 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "columnSegmentation.h"
+#include "cpuDetection.h"
+#include <immintrin.h>
+#include <algorithm>
+
+static void blockedColumnMaskScalar(const uint32_t* count, uint64_t* mask, uint32_t words, uint32_t blockedCount){
+    for(uint32_t word = 0; word < words; word++){
+        uint64_t bits = 0;
+        for(int i = 0; i < 64; i++){
+            bits |= (uint64_t) (count[word*64 + i] > blockedCount) << i;
+        }
+        mask[word] = bits;
+    }
+}
+
+__attribute__((target("avx2")))
+static void blockedColumnMaskAVX2(const uint32_t* count, uint64_t* mask, uint32_t words, uint32_t blockedCount){
+    // Compare 8 counts at a time and pack the sign bits of the comparison into the mask.
+    const __m256i blocked = _mm256_set1_epi32(blockedCount);
+    for(uint32_t word = 0; word < words; word++){
+        uint64_t bits = 0;
+        for(int i = 0; i < 64; i += 8){
+            __m256i c = _mm256_loadu_si256((const __m256i*) (count + word*64 + i));
+            uint32_t lanes = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(c, blocked)));
+            bits |= (uint64_t) lanes << i;
+        }
+        mask[word] = bits;
+    }
+}
+
+void blockedColumnMask(const uint32_t* count, uint64_t* mask, const SensorGeometry & geometry){
+    // Counts never exceed the lines in a frame, so the signed comparison in the AVX2 variant is safe.
+    static void (*const function)(const uint32_t*, uint64_t*, uint32_t, uint32_t) =
+            detectionBackendSupported(DetectionBackend::AVX2) ? blockedColumnMaskAVX2 : blockedColumnMaskScalar;
+    function(count, mask, columnMaskWords(geometry), BLOCKED_COLUMN_COUNT(geometry.imageHeight));
+}
+
+// Index of the first column from column up to columns with bit equal to set, or columns when there isn't one.
+// Only the words holding those columns are read.
+static uint32_t findColumn(const uint64_t* mask, uint32_t column, bool set, uint32_t columns){
+    while(column < columns){
+        uint32_t word = column / 64;
+        uint64_t bits = set ? mask[word] : ~mask[word];
+        bits &= ~(uint64_t) 0 << (column % 64);
+        if(bits != 0) return std::min(word*64 + __builtin_ctzll(bits), columns);
+        column = (word + 1) * 64;
+    }
+    return columns;
+}
+
+uint32_t segmentColumns(const uint32_t* count, const uint64_t* mask, ColumnRun* runs, uint32_t maxRuns,
+                        const SensorGeometry & geometry){
+    const uint32_t columns = geometry.pixelsPerLine;
+    uint32_t runCount = 0;
+    uint32_t column = findColumn(mask, 0, true, columns);
+    while(column < columns && runCount < maxRuns){
+        uint32_t end = findColumn(mask, column, false, columns);
+
+        // Only the columns in the run are read from count.
+        uint64_t pixels = 0;
+        uint64_t weightedSum = 0;
+        for(uint32_t i = column; i < end; i++){
+            pixels += count[i];
+            weightedSum += (uint64_t) count[i] * i;
+        }
+
+        ColumnRun & run = runs[runCount++];
+        run.firstColumn = column;
+        run.lastColumn = end - 1;
+        run.centroid = (double) weightedSum / pixels;
+        run.width = (double) pixels / geometry.imageHeight;
+
+        column = findColumn(mask, end, true, columns);
+    }
+    return runCount;
+}
+
+bool columnsSet(const uint64_t* mask, uint32_t firstColumn, uint32_t lastColumn){
+    return findColumn(mask, firstColumn, true, lastColumn + 1) <= lastColumn;
+}
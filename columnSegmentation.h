@@ -0,0 +1,61 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_COLUMNSEGMENTATION_H
+#define UNTITLED_COLUMNSEGMENTATION_H
+
+#include <cstdint>
+#include "CameraConfiguration.h"
+
+// A column is blocked when more than half of its pixels are below the threshold.
+#define BLOCKED_COLUMN_COUNT(imageHeight) ((imageHeight)/2)
+
+// Runs kept for each frame. Enough for the arrows of every lane on the screen plus a few stuck pixels.
+#define MAX_COLUMN_RUNS 8
+
+// Words in the column mask of a frame of geometry. One bit per column, 64 columns to a word.
+inline uint32_t columnMaskWords(const SensorGeometry & geometry){ return geometry.pixelsPerLine / 64; }
+
+// Contiguous blocked columns. Each arrow in front of the screen blocks one run.
+struct ColumnRun
+{
+    // First and last blocked columns.
+    uint32_t firstColumn;
+    uint32_t lastColumn;
+    // Average column weighted by the number of pixels below the threshold in each column.
+    double centroid;
+    // Pixels below the threshold in the run divided by the lines in a frame. A fully blocked column counts as 1.
+    double width;
+};
+
+// Set bit i of mask, which holds columnMaskWords(geometry) words, when column i of count, from a frame of geometry,
+// is blocked. Uses AVX2 when the processor supports it.
+void blockedColumnMask(const uint32_t* count, uint64_t* mask, const SensorGeometry & geometry = SensorGeometry());
+
+// Split the blocked columns in mask into runs from left to right using count for the centroids and widths.
+// Writes up to maxRuns runs and returns the number written. Runs after the first maxRuns are dropped.
+uint32_t segmentColumns(const uint32_t* count, const uint64_t* mask, ColumnRun* runs, uint32_t maxRuns,
+                        const SensorGeometry & geometry = SensorGeometry());
+
+// True when any column from firstColumn to lastColumn is set in mask.
+bool columnsSet(const uint64_t* mask, uint32_t firstColumn, uint32_t lastColumn);
+
+#endif //UNTITLED_COLUMNSEGMENTATION_H
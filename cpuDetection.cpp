@@ -0,0 +1,295 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "cpuDetection.h"
+#include "camerasettings.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// The SIMD variants load 64 pixels of a line at a time.
+static_assert(PIXELS_PER_LINE % 64 == 0, "PIXELS_PER_LINE must be a multiple of 64 for the SIMD backends.");
+
+// The SIMD variants count in 8 bit lanes, so the lanes are widened into 32 bit counts every 255 lines.
+#define MAX_LINES_PER_BLOCK 255
+
+// Each variant is built twice: with the width fixed at PIXELS_PER_LINE so the line loops are unrolled for it,
+// and with FixedWidth RUNTIME_WIDTH for any other width. Other widths are counted in strips of up to
+// PIXELS_PER_LINE columns, with lines stride pixels apart, so the variants' buffers stay on the stack.
+// The number of lines only bounds the outer loop.
+#define RUNTIME_WIDTH 0
+
+// The backend used by aboveThresholdCalcCPU.
+static DetectionBackend detectionBackend = DetectionBackend::Scalar;
+static void (*aboveThresholdFunction)(const uint32_t*, const uint8_t*, uint32_t*, const SensorGeometry &) = aboveThresholdCalcScalar;
+
+template<uint32_t FixedWidth>
+static inline uint32_t lineWidth(uint32_t width){
+    return FixedWidth != RUNTIME_WIDTH ? FixedWidth : width;
+}
+
+// The baseline threshold is stored as 32 bits per pixel, but pixels are 8 bits.
+// Thresholds above 255 can't be represented. Every pixel is below those and is handled by fixSaturatedColumns.
+static void packThresholdLine(const uint32_t* thresholdLine, uint8_t* threshold8, uint32_t width){
+    for(uint32_t i = 0; i < width; i++){
+        threshold8[i] = thresholdLine[i] > UINT8_MAX ? UINT8_MAX : thresholdLine[i];
+    }
+}
+
+static void fixSaturatedColumns(const uint32_t* thresholdLine, uint32_t* count, uint32_t width, uint32_t height){
+    for(uint32_t i = 0; i < width; i++){
+        if(thresholdLine[i] > UINT8_MAX) count[i] = height;
+    }
+}
+
+// Add the 8 bit counts of pixels at or above the threshold into the 32 bit counts and clear them.
+static void flushBlockCounts(uint8_t* blockCount, uint32_t* atOrAboveCount, uint32_t width){
+    for(uint32_t i = 0; i < width; i++){
+        atOrAboveCount[i] += blockCount[i];
+    }
+    memset(blockCount, 0, width);
+}
+
+// The SIMD variants count pixels at or above the threshold because it's a single max and compare for unsigned bytes.
+// Convert to the count below the threshold the same as the aboveThresholdCalc kernel.
+static void finishCounts(const uint32_t* thresholdLine, const uint32_t* atOrAboveCount, uint32_t* count,
+                         uint32_t width, uint32_t height){
+    for(uint32_t i = 0; i < width; i++){
+        count[i] = height - atOrAboveCount[i];
+    }
+    fixSaturatedColumns(thresholdLine, count, width, height);
+}
+
+template<uint32_t FixedWidth>
+static void aboveThresholdScalar(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count,
+                                 uint32_t stripWidth, uint32_t stride, uint32_t height){
+    // Reference implementation. Matches the aboveThresholdCalc kernel one pixel at a time.
+    const uint32_t width = lineWidth<FixedWidth>(stripWidth);
+    const size_t lineStride = lineWidth<FixedWidth>(stride);
+    memset(count, 0, width*sizeof(uint32_t));
+    for(uint32_t line = 0; line < height; line++){
+        const uint8_t * pixels = frame + line*lineStride;
+        for(uint32_t i = 0; i < width; i++){
+            if(thresholdLine[i] > (uint32_t) pixels[i]) count[i]++;
+        }
+    }
+}
+
+template<uint32_t FixedWidth>
+__attribute__((target("sse4.2")))
+static void aboveThresholdSSE42(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count,
+                                uint32_t stripWidth, uint32_t stride, uint32_t height){
+    const uint32_t width = lineWidth<FixedWidth>(stripWidth);
+    const size_t lineStride = lineWidth<FixedWidth>(stride);
+    alignas(64) uint8_t  threshold8[PIXELS_PER_LINE];
+    alignas(64) uint8_t  blockCount[PIXELS_PER_LINE] = {};
+    alignas(64) uint32_t atOrAboveCount[PIXELS_PER_LINE] = {};
+    packThresholdLine(thresholdLine, threshold8, width);
+
+    for(uint32_t line = 0; line < height; line += MAX_LINES_PER_BLOCK){
+        uint32_t lastLine = line + MAX_LINES_PER_BLOCK < height ? line + MAX_LINES_PER_BLOCK : height;
+        for(uint32_t l = line; l < lastLine; l++){
+            const uint8_t * pixels = frame + l*lineStride;
+            for(uint32_t i = 0; i < width; i += 16){
+                __m128i p = _mm_loadu_si128((const __m128i *) (pixels + i));
+                __m128i t = _mm_load_si128((const __m128i *) (threshold8 + i));
+                // 0xFF where the pixel is at or above the threshold. Subtracting -1 adds one to the count.
+                __m128i atOrAbove = _mm_cmpeq_epi8(_mm_max_epu8(p, t), p);
+                __m128i c = _mm_load_si128((const __m128i *) (blockCount + i));
+                _mm_store_si128((__m128i *) (blockCount + i), _mm_sub_epi8(c, atOrAbove));
+            }
+        }
+        flushBlockCounts(blockCount, atOrAboveCount, width);
+    }
+    finishCounts(thresholdLine, atOrAboveCount, count, width, height);
+}
+
+template<uint32_t FixedWidth>
+__attribute__((target("avx2")))
+static void aboveThresholdAVX2(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count,
+                               uint32_t stripWidth, uint32_t stride, uint32_t height){
+    const uint32_t width = lineWidth<FixedWidth>(stripWidth);
+    const size_t lineStride = lineWidth<FixedWidth>(stride);
+    alignas(64) uint8_t  threshold8[PIXELS_PER_LINE];
+    alignas(64) uint8_t  blockCount[PIXELS_PER_LINE] = {};
+    alignas(64) uint32_t atOrAboveCount[PIXELS_PER_LINE] = {};
+    packThresholdLine(thresholdLine, threshold8, width);
+
+    for(uint32_t line = 0; line < height; line += MAX_LINES_PER_BLOCK){
+        uint32_t lastLine = line + MAX_LINES_PER_BLOCK < height ? line + MAX_LINES_PER_BLOCK : height;
+        for(uint32_t l = line; l < lastLine; l++){
+            const uint8_t * pixels = frame + l*lineStride;
+            for(uint32_t i = 0; i < width; i += 32){
+                __m256i p = _mm256_loadu_si256((const __m256i *) (pixels + i));
+                __m256i t = _mm256_load_si256((const __m256i *) (threshold8 + i));
+                __m256i atOrAbove = _mm256_cmpeq_epi8(_mm256_max_epu8(p, t), p);
+                __m256i c = _mm256_load_si256((const __m256i *) (blockCount + i));
+                _mm256_store_si256((__m256i *) (blockCount + i), _mm256_sub_epi8(c, atOrAbove));
+            }
+        }
+        flushBlockCounts(blockCount, atOrAboveCount, width);
+    }
+    finishCounts(thresholdLine, atOrAboveCount, count, width, height);
+}
+
+template<uint32_t FixedWidth>
+__attribute__((target("avx512f,avx512bw")))
+static void aboveThresholdAVX512(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count,
+                                 uint32_t stripWidth, uint32_t stride, uint32_t height){
+    const uint32_t width = lineWidth<FixedWidth>(stripWidth);
+    const size_t lineStride = lineWidth<FixedWidth>(stride);
+    alignas(64) uint8_t  threshold8[PIXELS_PER_LINE];
+    alignas(64) uint8_t  blockCount[PIXELS_PER_LINE] = {};
+    alignas(64) uint32_t atOrAboveCount[PIXELS_PER_LINE] = {};
+    packThresholdLine(thresholdLine, threshold8, width);
+
+    const __m512i one = _mm512_set1_epi8(1);
+    for(uint32_t line = 0; line < height; line += MAX_LINES_PER_BLOCK){
+        uint32_t lastLine = line + MAX_LINES_PER_BLOCK < height ? line + MAX_LINES_PER_BLOCK : height;
+        for(uint32_t l = line; l < lastLine; l++){
+            const uint8_t * pixels = frame + l*lineStride;
+            for(uint32_t i = 0; i < width; i += 64){
+                __m512i p = _mm512_loadu_si512((const void *) (pixels + i));
+                __m512i t = _mm512_load_si512((const void *) (threshold8 + i));
+                __mmask64 atOrAbove = _mm512_cmpge_epu8_mask(p, t);
+                __m512i c = _mm512_load_si512((const void *) (blockCount + i));
+                _mm512_store_si512((void *) (blockCount + i), _mm512_mask_add_epi8(c, atOrAbove, c, one));
+            }
+        }
+        flushBlockCounts(blockCount, atOrAboveCount, width);
+    }
+    finishCounts(thresholdLine, atOrAboveCount, count, width, height);
+}
+
+// Use the build of kernel for the full width when geometry has it, and count other widths a strip at a time.
+// Widths are multiples of 64, so every strip is too.
+#define DISPATCH_WIDTH(kernel) \
+    if(geometry.pixelsPerLine == PIXELS_PER_LINE) { \
+        kernel<PIXELS_PER_LINE>(thresholdLine, frame, count, PIXELS_PER_LINE, PIXELS_PER_LINE, geometry.imageHeight); \
+    } \
+    else { \
+        for(uint32_t first = 0; first < geometry.pixelsPerLine; first += PIXELS_PER_LINE) { \
+            kernel<RUNTIME_WIDTH>(thresholdLine + first, frame + first, count + first, \
+                                  std::min<uint32_t>(PIXELS_PER_LINE, geometry.pixelsPerLine - first), \
+                                  geometry.pixelsPerLine, geometry.imageHeight); \
+        } \
+    }
+
+void aboveThresholdCalcScalar(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry){
+    DISPATCH_WIDTH(aboveThresholdScalar);
+}
+
+void aboveThresholdCalcSSE42(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry){
+    DISPATCH_WIDTH(aboveThresholdSSE42);
+}
+
+void aboveThresholdCalcAVX2(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry){
+    DISPATCH_WIDTH(aboveThresholdAVX2);
+}
+
+void aboveThresholdCalcAVX512(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry){
+    DISPATCH_WIDTH(aboveThresholdAVX512);
+}
+
+const char * detectionBackendName(DetectionBackend backend){
+    switch(backend){
+        case DetectionBackend::GPU:    return "gpu";
+        case DetectionBackend::Scalar: return "scalar";
+        case DetectionBackend::SSE42:  return "sse4.2";
+        case DetectionBackend::AVX2:   return "avx2";
+        case DetectionBackend::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+bool detectionBackendSupported(DetectionBackend backend){
+    __builtin_cpu_init();
+    switch(backend){
+        case DetectionBackend::GPU:
+#ifdef LSAD_USE_HIP
+            return true;
+#else
+            return false;
+#endif
+        case DetectionBackend::Scalar: return true;
+        case DetectionBackend::SSE42:  return __builtin_cpu_supports("sse4.2");
+        case DetectionBackend::AVX2:   return __builtin_cpu_supports("avx2");
+        case DetectionBackend::AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    }
+    return false;
+}
+
+DetectionBackend bestDetectionBackend(){
+    // Ordered fastest to slowest.
+    for(DetectionBackend backend : {DetectionBackend::AVX512, DetectionBackend::AVX2, DetectionBackend::SSE42}){
+        if(detectionBackendSupported(backend)) return backend;
+    }
+    return DetectionBackend::Scalar;
+}
+
+DetectionBackend selectDetectionBackend(){
+    DetectionBackend backend = bestDetectionBackend();
+
+    // Use the backend named in the environment if there is one.
+    const char * requested = getenv(DETECTION_BACKEND_ENV);
+    if(requested != NULL && requested[0] != '\0'){
+        bool found = false;
+        for(DetectionBackend b : {DetectionBackend::GPU, DetectionBackend::Scalar, DetectionBackend::SSE42,
+                                  DetectionBackend::AVX2, DetectionBackend::AVX512}){
+            if(strcmp(requested, detectionBackendName(b)) == 0){
+                backend = b;
+                found = true;
+            }
+        }
+        if(!found){
+            std::cerr << "Unknown detection backend \"" << requested << "\" in " << DETECTION_BACKEND_ENV << ". Aborting.\n";
+            std::abort();
+        }
+    }
+
+    setDetectionBackend(backend);
+    std::cout << "Using the " << detectionBackendName(backend) << " detection backend.\n";
+    return backend;
+}
+
+void setDetectionBackend(DetectionBackend backend){
+    if(!detectionBackendSupported(backend)){
+        std::cerr << "The " << detectionBackendName(backend) << " detection backend isn't supported on this machine. Aborting.\n";
+        std::abort();
+    }
+
+    detectionBackend = backend;
+    switch(backend){
+        case DetectionBackend::SSE42:  aboveThresholdFunction = aboveThresholdCalcSSE42;  break;
+        case DetectionBackend::AVX2:   aboveThresholdFunction = aboveThresholdCalcAVX2;   break;
+        case DetectionBackend::AVX512: aboveThresholdFunction = aboveThresholdCalcAVX512; break;
+        default:                       aboveThresholdFunction = aboveThresholdCalcScalar; break;
+    }
+}
+
+DetectionBackend currentDetectionBackend(){
+    return detectionBackend;
+}
+
+void aboveThresholdCalcCPU(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry){
+    aboveThresholdFunction(thresholdLine, frame, count, geometry);
+}
@@ -0,0 +1,75 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef UNTITLED_CPUDETECTION_H
+#define UNTITLED_CPUDETECTION_H
+
+#include <cstdint>
+#include "CameraConfiguration.h"
+
+// Environment variable used to choose the detection backend at startup.
+// Valid values are the names returned by detectionBackendName (gpu, scalar, sse4.2, avx2, avx512).
+// When it isn't set the fastest CPU backend supported by the processor is used.
+#define DETECTION_BACKEND_ENV "LSAD_DETECTION_BACKEND"
+
+// Backends able to count the pixels below the threshold in a grabbed frame.
+// GPU is the aboveThresholdCalc HIP kernel and is only available when built with LSAD_USE_HIP.
+enum class DetectionBackend
+{
+    GPU,
+    Scalar,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+// Name of a backend as used by DETECTION_BACKEND_ENV.
+const char * detectionBackendName(DetectionBackend backend);
+
+// Check CPUID (and the build) to see if a backend can be used on this machine.
+bool detectionBackendSupported(DetectionBackend backend);
+
+// The fastest CPU backend supported by the processor.
+DetectionBackend bestDetectionBackend();
+
+// Choose the backend from DETECTION_BACKEND_ENV or bestDetectionBackend, make it the current backend and return it.
+// Aborts if the requested backend is unknown or unsupported.
+DetectionBackend selectDetectionBackend();
+
+// Make a backend the current backend used by aboveThresholdCalcCPU.
+void setDetectionBackend(DetectionBackend backend);
+
+// The current backend.
+DetectionBackend currentDetectionBackend();
+
+// CPU equivalents of the aboveThresholdCalc kernel.
+// Counts the pixels in each column of a frame of geometry that are below thresholdLine. thresholdLine and count
+// hold geometry.pixelsPerLine values. The full PIXELS_PER_LINE width has its own faster build.
+// frame can be the Pylon grab buffer directly and needs no particular alignment.
+void aboveThresholdCalcScalar(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry = SensorGeometry());
+void aboveThresholdCalcSSE42 (const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry = SensorGeometry());
+void aboveThresholdCalcAVX2  (const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry = SensorGeometry());
+void aboveThresholdCalcAVX512(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry = SensorGeometry());
+
+// Runs the CPU variant for the current backend.
+// Must not be called when the current backend is GPU.
+void aboveThresholdCalcCPU(const uint32_t* thresholdLine, const uint8_t* frame, uint32_t* count, const SensorGeometry & geometry = SensorGeometry());
+
+#endif //UNTITLED_CPUDETECTION_H
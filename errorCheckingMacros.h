@@ -6,7 +6,11 @@
 #define UNTITLED_ERRORCHECKINGMACROS_H
 
 #include <sqlite3.h>
+#include <iostream>
+#include <string>
+#ifdef LSAD_USE_HIP
 #include "hip/hip_runtime.h"
+#endif
 
 // Macro and function for checking and reporting SQLite3 errors when the success value is SQLITE_OK.
 // Use C Preprocessor to convert the command to a string, get the filename and line number.
@@ -26,6 +30,7 @@ inline int sqlite3ErrorChecker(std::string com, int retVal, std::string filename
 
 #define SQLite3_CHECK(command,db) sqlite3ErrorChecker(#command, command, __FILE__, __LINE__,db)
 
+#ifdef LSAD_USE_HIP
 // Inline function and macro for checking and reporting hip errors using the same approach as checking for SQLite3 errors.
 inline void hipErrorChecker(std::string com, hipError_t status, std::string filename, int lineNum){
     // These are the only success values.
@@ -41,5 +46,6 @@ inline void hipErrorChecker(std::string com, hipError_t status, std::string file
 // Based on the HIP_CHECK macro from this presentation: INTRODUCTION TO AMD GPU PROGRAMMING WITH HIP
 // https://www.exascaleproject.org/wp-content/uploads/2017/05/ORNL_HIP_webinar_20190606_final.pdf
 #define HIP_CHECK(command) hipErrorChecker(#command, command, __FILE__, __LINE__)
+#endif //LSAD_USE_HIP
 
 #endif //UNTITLED_ERRORCHECKINGMACROS_H
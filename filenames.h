@@ -24,4 +24,7 @@
 // Database filenames.
 #define DB_FILENAME "LSAD.db"
 
+// Milliseconds to wait for another program's write to the database to finish before giving up.
+#define DB_BUSY_TIMEOUT_MS 1000
+
 #endif //UNTITLED_FILENAMES_H
@@ -21,9 +21,7 @@
 #ifndef UNTITLED_GLOBALS_H
 #define UNTITLED_GLOBALS_H
 
-#include "BaselineData.h"
-#include <condition_variable>
-#include <mutex>
+#include "DetectorContext.h"
 
 // Changes needed to more reliabled test for impacts.
 // Wait for one second until continuing to collect frames after drawing a point.
@@ -33,36 +31,7 @@
 // The path where DB files are stored.
 #define DB_PATH "/home/nathan/SQLiteDBs"
 
-// Global Variables for holding the average pixel where an object was detected
-// pixelCamera0 - average pixel where object was detected on L45
-// pixelCamera1 - average pixel where object was detected on L90
-// Set By SoftwareTriggerEventHandler::OnImageGrabbed.
-// Used in the main_training and main_testing_continous main loop.
-double pixelCamera0;
-double pixelCamera1;
-
-// Pointer to the current frame grabbed stored on
-// GPU memory for images grabbed from both cameras.
-// Set by SoftwareTriggerEventHandler::OnImageGrabbed.
-// Used in the GPU function vsub to compare against aboveThresholdLine
-uint8_t * grabResult_d[2];
-
-// Counts the number of pixels above the object detection threshold in a frame.
-// (_d = GPU memory) (_h = host memory)
-// Used SoftwareTriggerEventHandler::OnImageGrabbed.
-// Calculated by the GPU function vsub to compare against aboveThresholdLine
-uint32_t * aboveThresholdCount_d[2];
-uint32_t * aboveThresholdCount_h[2];
-
-// Holds the threshold for each pixel read from an SQLite file.
-// (_d = GPU memory) (_h = host memory)
-BaselineData * Baseline_h[2], *Baseline_d[2];
-
-// bool, mutex and condition_variable arrays
-// The camera event handlers run in seperate threads
-// the main function's thread needs to be blocked until camera event handlers finish.
-bool cameraEventComplete[2];
-std::mutex m[2];
-std::condition_variable cv[2];
+// The buffers, baselines, thresholds and detection results for each camera are kept in detectorContext().
+// See CameraContext in DetectorContext.h.
 
 #endif //UNTITLED_GLOBALS_H
@@ -0,0 +1,42 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "gpuDetection.h"
+
+#ifdef LSAD_USE_HIP
+#include "errorCheckingMacros.h"
+
+__global__ void aboveThresholdCalc(const uint32_t* thresholdLine, const uint8_t* b, uint32_t* c, uint32_t width){
+    uint32_t column = hipBlockIdx_y * hipBlockDim_x + hipThreadIdx_x;
+
+    if (column < width) {
+        if(thresholdLine[column] > (((uint32_t) b[(size_t) hipBlockIdx_x * width + column]))) atomicAdd(c+column,1);
+    }
+}
+
+void aboveThresholdCalcGPU(const uint32_t* thresholdLine, const uint8_t* b, uint32_t* c, const SensorGeometry & geometry){
+    uint32_t threads = geometry.pixelsPerLine < DETECTION_THREADS_PER_BLOCK ? geometry.pixelsPerLine : DETECTION_THREADS_PER_BLOCK;
+    uint32_t columnBlocks = (geometry.pixelsPerLine + threads - 1) / threads;
+    hipLaunchKernelGGL(aboveThresholdCalc, dim3(geometry.imageHeight, columnBlocks), dim3(threads), 0, 0,
+                       thresholdLine, b, c, geometry.pixelsPerLine);
+    HIP_CHECK(hipGetLastError());
+}
+#endif //LSAD_USE_HIP
@@ -0,0 +1,42 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef UNTITLED_GPUDETECTION_H
+#define UNTITLED_GPUDETECTION_H
+
+#include <cstdint>
+#ifdef LSAD_USE_HIP
+#include "hip/hip_runtime.h"
+#include "CameraConfiguration.h"
+
+// Threads in each block of aboveThresholdCalc. Lines wider than this are split over more blocks.
+#define DETECTION_THREADS_PER_BLOCK 1024
+
+// Compares the a frame grabbed to the threshold and calculates the number of pixels for each line below the threshold.
+// Each block x is a line of the frame and each block y covers DETECTION_THREADS_PER_BLOCK of its columns.
+// The CPU backends in cpuDetection.h calculate the same counts.
+__global__ void aboveThresholdCalc(const uint32_t* thresholdLine, const uint8_t* b, uint32_t* c, uint32_t width);
+
+// Run aboveThresholdCalc over a frame of geometry in GPU memory. c has to be zeroed first.
+void aboveThresholdCalcGPU(const uint32_t* thresholdLine, const uint8_t* b, uint32_t* c, const SensorGeometry & geometry);
+#endif //LSAD_USE_HIP
+
+#endif //UNTITLED_GPUDETECTION_H
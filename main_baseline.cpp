@@ -21,21 +21,27 @@
 // Basler Grab_ChunkImage.cpp sample was used as a starting point for the baseline collection program.
 
 #include "BaselineData.h"
+#include "StreamingBaseline.h"
 #include "camerasettings.h"
-#include "cameraSetup.h"
+#include "FrameSource.h"
 #include "filenames.h"
-
-void grabLoop(Camera_t & camera, uint8_t * frames_d);
+#include "globals.h"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+const uint8_t * retrieveFrame(FrameSource & camera, Frame & frame);
+void grabLoop(FrameSource & camera, StreamingBaseline & baseline);
+#ifdef LSAD_USE_HIP
+void grabLoopGPU(FrameSource & camera, uint8_t * frames_d);
+#endif
 
 // Namespace for using cout.
 using namespace std;
 
-// Namespace for using pylon objects.
-using namespace Pylon;
-
 // Number of images to be grabbed.
-// Camera.StopGrabbing() is called automatically by the RetrieveResult() method
-// when c_countOfImagesToGrab images have been retrieved.
+// Grabbing stops automatically when c_countOfImagesToGrab images have been retrieved.
 static const uint32_t c_countOfImagesToGrab = NUM_SAMPLES;
 
 int main(int argc, char* argv[])
@@ -50,68 +56,78 @@ int main(int argc, char* argv[])
     try
     {
         // Before using any pylon methods, the pylon runtime must be initialized.
-        PylonInitialize();
-
-        // Only look for cameras supported by Camera_t
-        CDeviceInfo info;
-        info.SetDeviceClass( Camera_t::DeviceClass());
+        frameSourcesInitialize();
 
-        // Get the transport layer factory.
-        CTlFactory& tlFactory = CTlFactory::GetInstance();
-
-        // Get all attached devices and exit application if no device is found.
-        // There should be two camera's attached with user defined names L45 and L90.
-        DeviceInfoList_t devices;
-        if( tlFactory.EnumerateDevices(devices) == 0){
-            throw RUNTIME_EXCEPTION("No camera present.");
-        }
+        // Open every camera set up to acquire until the set number of frames are collected.
+        // There should be a camera attached for each name in LSAD_CAMERA_NAMES, L45 and L90 by default.
+        std::vector<std::unique_ptr<FrameSource>> cameras = openFrameSources(AcquisitionMode::Continuous, SIZE_MAX);
 
         // Get the number of cameras to collect a baseline for.
-        const int NUM_CAMERAS = devices.size();
-
-        // Create a camera array for two cameras.
-        Camera_t cameras[NUM_CAMERAS];
-
-        // This smart pointer will receive the grab result data.
-        GrabResultPtr_t ptrGrabResult[NUM_CAMERAS];
-
-        // Create pointer for frames on the GPU.
-        uint8_t *frames_d[NUM_CAMERAS];
+        const int NUM_CAMERAS = cameras.size();
 
         // Create pointer for baseline data on the host.
         BaselineData * BD[NUM_CAMERAS];
 
-        // Calculate the baseline for both cameras sequentially.
+        // The GPU calculation needs every frame in GPU memory before it starts.
+        // By default frames are added to the baseline on a background thread as they're grabbed instead.
+        const char * backend = getenv(BASELINE_BACKEND_ENV);
+        bool useGPU = backend != NULL && strcmp(backend, "gpu") == 0;
+#ifndef LSAD_USE_HIP
+        if(useGPU) {
+            throw std::runtime_error("The gpu baseline backend needs a build with LSAD_USE_HIP.");
+        }
+#endif
+
+        // Calculate the baseline for each camera sequentially.
         for(uint8_t i = 0; i < NUM_CAMERAS; i++) {
-            // Set the camera up to acquire until the set number of frames are collected.
-            camSetupContinous(cameras[i],devices[i], tlFactory);
+            // Allocate memory for the BaselineData struct on the host.
+            initBaselineData_h(BD[i], CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
 
-            // Allocate memory on device for the frames.
-            HIP_CHECK(hipMalloc(&frames_d[i], DATA_BYTES));
+            // Frames can be any size detection can measure.
+            SensorGeometry geometry = cameras[i]->geometry();
+            checkSensorGeometry(cameras[i]->name(), geometry);
 
-            // Run the grab loop copying the grabbed frames into GPU memory.
             cout << "Starting to grab frames for camera: " << i << ".\n";
-            grabLoop(cameras[i],frames_d[i]);
-            cout << "Finished grabbing frames for camera: " << i << ".\n";
+#ifdef LSAD_USE_HIP
+            if(useGPU) {
+                if(geometry != SensorGeometry()) {
+                    throw std::runtime_error("The gpu baseline backend needs frames of PIXELS_PER_LINE x IMAGE_HEIGHT.");
+                }
 
-            // Allocate memory for the BaselineData struct on the host.
-            initBaselineData_h(BD[i], CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
+                // Allocate memory on device for the frames.
+                uint8_t *frames_d;
+                HIP_CHECK(hipMalloc(&frames_d, DATA_BYTES));
 
-            // Process the data on the GPU and copy back to the host.
-            baselineGPUCalculation(BD[i], frames_d[i]);
+                // Run the grab loop copying the grabbed frames into GPU memory.
+                grabLoopGPU(*cameras[i],frames_d);
+                cout << "Finished grabbing frames for camera: " << i << ".\n";
 
-            // deallocate GPU memory for the frames.
-            HIP_CHECK(hipFree(frames_d[i]));
+                // Process the data on the GPU and copy back to the host.
+                baselineGPUCalculation(BD[i], frames_d);
+
+                // deallocate GPU memory for the frames.
+                HIP_CHECK(hipFree(frames_d));
+            }
+            else
+#endif
+            {
+                // Run the grab loop handing each frame to the accumulator thread.
+                // The baseline is finished shortly after the last frame is grabbed.
+                StreamingBaseline baseline(geometry);
+                grabLoop(*cameras[i], baseline);
+                cout << "Finished grabbing frames for camera: " << i << ".\n";
+                baseline.finish(BD[i]);
+            }
 
             // Write the baseline data to the SQLite3 file.
-            writeBaselineToDB(BD[i], DB_FILENAME, cameras[i].GetDeviceInfo().GetUserDefinedName());
+            writeBaselineToDB(BD[i], DB_FILENAME, cameras[i]->name());
         }
     }
-    catch (const GenericException &e)
+    catch (const std::exception &e)
     {
         // Error handling.
         cerr << "An exception occurred." << endl
-             << e.GetDescription() << endl;
+             << e.what() << endl;
         exitCode = 1;
     }
 
@@ -121,53 +137,67 @@ int main(int argc, char* argv[])
     cin >> dummyVariable;
 
     // Releases all pylon resources.
-    PylonTerminate();
+    frameSourcesTerminate();
 
     return exitCode;
 }
 
-void grabLoop(Camera_t & camera, uint8_t * frames_d)
+const uint8_t * retrieveFrame(FrameSource & camera, Frame & frame)
 {
-    // This smart pointer will receive the grab result data.
-    GrabResultPtr_t ptrGrabResult;
+    // Wait for an image and then retrieve it. A timeout of 5000 ms is used.
+    if(!camera.retrieveFrame(frame, 5000)) return NULL;
+
+    // Since we have activated the CRC Checksum feature, we can check
+    // the integrity of the buffer first.
+    // Note: Enabling the CRC Checksum feature is not a prerequisite for using
+    // chunks. Chunks can also be handled when the CRC Checksum feature is deactivated.
+    if(frame.hasCRC && frame.crcPassed == false) {
+        throw std::runtime_error("Image was damaged!");
+    }
 
-    // Count the number of images grabbed for the memory offset.
-    uint32_t counter = 0;
+    return frame.buffer;
+}
+
+void grabLoop(FrameSource & camera, StreamingBaseline & baseline)
+{
+    // This will receive the grabbed frame.
+    Frame frame;
 
     // Start the grabbing of c_countOfImagesToGrab images.
     // The camera device is parameterized with a default configuration which
     // sets up free-running continuous acquisition.
-    camera.StartGrabbing(c_countOfImagesToGrab);
+    camera.startGrabbing(c_countOfImagesToGrab);
 
-    while(camera.IsGrabbing()){
-        // Wait for an image and then retrieve it. A timeout of 5000 ms is used.
-        // RetrieveResult calls the image event handler's OnImageGrabbed method.
-        camera.RetrieveResult(5000, ptrGrabResult, TimeoutHandling_ThrowException);
+    const uint8_t * pImageBuffer;
+    while((pImageBuffer = retrieveFrame(camera, frame)) != NULL){
+        // Queue the frame for the accumulator thread and release the grab buffer.
+        baseline.addFrame(pImageBuffer);
+        camera.releaseFrame();
+    }
 
-        // The result data is automatically filled with received chunk data.
-        // (Note:  This is not the case when using the low-level API)
-        const uint8_t *pImageBuffer = (uint8_t *) ptrGrabResult->GetBuffer();
+    camera.stopGrabbing();
+}
 
-        // Check to see if a buffer containing chunk data has been received.
-        if (PayloadType_ChunkData != ptrGrabResult->GetPayloadType())
-        {
-            throw RUNTIME_EXCEPTION( "Unexpected payload type received.");
-        }
+#ifdef LSAD_USE_HIP
+void grabLoopGPU(FrameSource & camera, uint8_t * frames_d)
+{
+    // This will receive the grabbed frame.
+    Frame frame;
 
-        // Since we have activated the CRC Checksum feature, we can check
-        // the integrity of the buffer first.
-        // Note: Enabling the CRC Checksum feature is not a prerequisite for using
-        // chunks. Chunks can also be handled when the CRC Checksum feature is deactivated.
-        if(ptrGrabResult->HasCRC()) {
-            if (ptrGrabResult->HasCRC() && ptrGrabResult->CheckCRC() == false) {
-                throw RUNTIME_EXCEPTION("Image was damaged!");
-            }
-        }
-        // Copy the frame to GPU memory.
+    // Count the number of images grabbed for the memory offset.
+    uint32_t counter = 0;
+
+    // Start the grabbing of c_countOfImagesToGrab images.
+    camera.startGrabbing(c_countOfImagesToGrab);
+
+    const uint8_t * pImageBuffer;
+    while((pImageBuffer = retrieveFrame(camera, frame)) != NULL){
+        // Copy the frame to GPU memory straight from the registered grab buffer.
         HIP_CHECK(hipMemcpy(frames_d+PIXELS_PER_LINE*IMAGE_HEIGHT*counter, pImageBuffer, PIXELS_PER_LINE*IMAGE_HEIGHT, hipMemcpyHostToDevice));
+        camera.releaseFrame();
         counter++;
     }
 
-    // Turn off chunk mode for the camera.
-    camera.ChunkModeActive.SetValue(false);
-}
\ No newline at end of file
+    camera.stopGrabbing();
+}
+#endif
@@ -0,0 +1,616 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// Benchmarks for each stage of detection on synthetic data.
+// Reports throughput and p50/p99 latency for every benchmark and can write the results as JSON,
+// so runs on different builds can be compared.
+//
+// Usage: lsad_bench [--quick] [--filter text] [--json file]
+//   --quick   run fewer iterations.
+//   --filter  only run benchmarks with text in their name.
+//   --json    write the results to file, or to stdout when file is "-".
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include "AdaptiveBaseline.h"
+#include "BaselineAccumulator.h"
+#include "BaselineData.h"
+#include "DatabaseService.h"
+#include "DetectorContext.h"
+#include "GrabBufferPool.h"
+#include "StartupSnapshot.h"
+#include "ShotJournal.h"
+#include "PositionLookupTable.h"
+#include "ScreenPositionEstimator.h"
+#include "SensorFusion.h"
+#include "SQLitefunctions.h"
+#include "StreamingBaseline.h"
+#include "SyntheticFrameSource.h"
+#include "camerasettings.h"
+#include "columnSegmentation.h"
+#include "cpuDetection.h"
+#include "gpuDetection.h"
+
+using std::cout, std::cerr, std::endl;
+
+// Distinct frames cycled through by the frame benchmarks.
+// 64 frames are 16 MB, larger than the caches, so frames come from memory like frames written by the network card.
+#define BENCH_FRAME_POOL 64
+
+// Estimates timed together as one iteration. A single estimate is too short to time on its own.
+#define BENCH_ESTIMATE_BATCH 1024
+
+// Sensors fused by the estimate.fusion benchmark.
+#define BENCH_FUSION_SENSORS 3
+
+// Training datapoints written per writeDataPointsToDB call.
+#define BENCH_DATAPOINTS 100
+
+// Baselines in the database when one is looked up, about a year of nightly baselines.
+#define BENCH_BASELINE_HISTORY 365
+
+#define FRAME_BYTES (PIXELS_PER_LINE*IMAGE_HEIGHT)
+
+// A camera cropped narrower than PIXELS_PER_LINE, measured by the kernels built for any width.
+#define BENCH_CROPPED_PIXELS_PER_LINE (PIXELS_PER_LINE - 64)
+
+// Camera names the benchmarks store baselines under.
+static const std::string benchCameraNames[2] = {"L45", "L90"};
+
+// Results are stored here so the compiler can't remove the work being timed.
+static volatile uint64_t benchSink;
+
+struct BenchResult
+{
+    std::string name;
+    // What throughput counts, e.g. "frames".
+    std::string unit;
+    uint64_t iterations;
+    uint64_t itemsPerIteration;
+    double totalSeconds;
+    // Latency of one iteration.
+    double p50Microseconds;
+    double p99Microseconds;
+    double meanMicroseconds;
+    // Items per second.
+    double throughput;
+};
+
+struct BenchOptions
+{
+    bool quick = false;
+    std::string filter;
+    std::string jsonFile;
+};
+
+// Nearest rank percentile of sorted values.
+static double percentile(const std::vector<double> & sorted, double p){
+    size_t rank = (size_t) ceil(p * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Run body warmup times untimed and iterations times timed. Each call processes itemsPerIteration items.
+static BenchResult runBench(const std::string & name, const std::string & unit, uint64_t itemsPerIteration,
+                            uint64_t warmup, uint64_t iterations, const std::function<void(uint64_t)> & body){
+    for(uint64_t i = 0; i < warmup; i++) body(i);
+
+    std::vector<double> latencies(iterations);
+    auto start = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < iterations; i++){
+        auto t0 = std::chrono::steady_clock::now();
+        body(warmup + i);
+        auto t1 = std::chrono::steady_clock::now();
+        latencies[i] = std::chrono::duration<double, std::micro>(t1 - t0).count();
+    }
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BenchResult result;
+    result.name = name;
+    result.unit = unit;
+    result.iterations = iterations;
+    result.itemsPerIteration = itemsPerIteration;
+    result.totalSeconds = totalSeconds;
+    result.meanMicroseconds = 0;
+    for(double l : latencies) result.meanMicroseconds += l;
+    result.meanMicroseconds /= iterations;
+    std::sort(latencies.begin(), latencies.end());
+    result.p50Microseconds = percentile(latencies, 0.50);
+    result.p99Microseconds = percentile(latencies, 0.99);
+    result.throughput = iterations * itemsPerIteration / totalSeconds;
+    return result;
+}
+
+static void printResult(std::ostream & out, const BenchResult & r){
+    out << std::left << std::setw(28) << r.name << std::right << std::fixed
+         << std::setw(14) << std::setprecision(1) << r.throughput << " " << std::left << std::setw(12) << (r.unit + "/s") << std::right
+         << " p50 " << std::setw(10) << std::setprecision(2) << r.p50Microseconds << " us"
+         << "  p99 " << std::setw(10) << std::setprecision(2) << r.p99Microseconds << " us"
+         << "  (" << r.iterations << " x " << r.itemsPerIteration << ")" << endl;
+}
+
+static std::string jsonEscape(const std::string & s){
+    std::string escaped;
+    for(char c : s){
+        if(c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+static void writeJson(std::ostream & out, const std::vector<BenchResult> & results, const BenchOptions & options){
+#ifdef LSAD_USE_HIP
+    const char * hip = "true";
+#else
+    const char * hip = "false";
+#endif
+    out << "{\n";
+    out << "  \"version\": 1,\n";
+    out << "  \"compiler\": \"" << jsonEscape(__VERSION__) << "\",\n";
+    out << "  \"hip\": " << hip << ",\n";
+    out << "  \"best_cpu_backend\": \"" << detectionBackendName(bestDetectionBackend()) << "\",\n";
+    out << "  \"quick\": " << (options.quick ? "true" : "false") << ",\n";
+    out << "  \"pixels_per_line\": " << PIXELS_PER_LINE << ",\n";
+    out << "  \"image_height\": " << IMAGE_HEIGHT << ",\n";
+    out << "  \"benchmarks\": [\n";
+    out << std::setprecision(6) << std::fixed;
+    for(size_t i = 0; i < results.size(); i++){
+        const BenchResult & r = results[i];
+        out << "    {\"name\": \"" << jsonEscape(r.name) << "\", \"unit\": \"" << jsonEscape(r.unit) << "\""
+            << ", \"iterations\": " << r.iterations << ", \"items_per_iteration\": " << r.itemsPerIteration
+            << ", \"total_seconds\": " << r.totalSeconds << ", \"throughput_per_second\": " << r.throughput
+            << ", \"p50_us\": " << r.p50Microseconds << ", \"p99_us\": " << r.p99Microseconds
+            << ", \"mean_us\": " << r.meanMicroseconds << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// Frames from a synthetic camera with a fixed seed, so every run uses the same data.
+// They're kept in grab buffers, so detection reads them from the same kind of memory as frames from a camera.
+static std::vector<const uint8_t *> renderFramePool(GrabBufferPool & pool){
+    std::vector<const uint8_t *> frames;
+    SyntheticSettings settings;
+    settings.frameRate = 0;
+    SyntheticFrameSource source(benchCameraNames[0].c_str(), 0, AcquisitionMode::Continuous, settings);
+    source.startGrabbing(BENCH_FRAME_POOL);
+    Frame frame;
+    for(size_t i = 0; source.retrieveFrame(frame, 1000); i++){
+        // Put an arrow in every other frame so detection sees both cases.
+        if(i % 2 == 0) source.setArrow(100 + 13.5 * i, 6);
+        else source.clearArrow();
+        uint8_t * buffer = pool.acquire();
+        memcpy(buffer, frame.buffer, FRAME_BYTES);
+        frames.push_back(buffer);
+        source.releaseFrame();
+    }
+    return frames;
+}
+
+// Coefficients close to the ones fitted on the range, written the same way as regression_fitting.py.
+static void writeBenchCoefficients(const char * filename){
+    const double coefficients[2*NUM_COEFFICIENTS] = {
+        -152.3,  1.91,  0.42, -2.1e-4, 3.3e-4,  1.2e-4, 1.4e-7, -2.2e-7, 9.5e-8, -3.1e-8, -2.0e-11, 4.1e-11, -1.7e-11, 6.2e-12, 1.1e-12,
+         611.8, -0.37,  1.12,  1.8e-4, -4.4e-4, 2.6e-4, -9.3e-8, 1.5e-7, -1.2e-7, 4.4e-8, 1.6e-11, -3.0e-11, 2.2e-11, -9.8e-12, 2.5e-12
+    };
+
+    sqlite3 * db;
+    sqlite3_stmt * stmt;
+    SQLite3_CHECK(sqlite3_open(filename, &db),db);
+    SQLite3_CHECK(sqlite3_prepare_v2(db,CREATE_COEFFICIENTS_TABLE_STATEMENT,-1,&stmt,NULL),db);
+    SQLite3_CHECK(sqlite3_step(stmt),db);
+    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+    SQLite3_CHECK(sqlite3_prepare_v2(db,INSERT_COEFFICIENTS_STATEMENT,-1,&stmt,NULL),db);
+    for(int i = 0; i < 2*NUM_COEFFICIENTS; i++){
+        SQLite3_CHECK(sqlite3_bind_double(stmt,i+1,coefficients[i]),db);
+    }
+    SQLite3_CHECK(sqlite3_bind_text(stmt,2*NUM_COEFFICIENTS+1,"2020-01-01 00:00:00",-1,NULL),db);
+    SQLite3_CHECK(sqlite3_step(stmt),db);
+    SQLite3_CHECK(sqlite3_finalize(stmt),db);
+    SQLite3_CHECK(sqlite3_close(db),db);
+}
+
+static BenchOptions parseOptions(int argc, char* argv[]){
+    BenchOptions options;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--quick") == 0){
+            options.quick = true;
+        }
+        else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc){
+            options.filter = argv[++i];
+        }
+        else if(strcmp(argv[i], "--json") == 0 && i + 1 < argc){
+            options.jsonFile = argv[++i];
+        }
+        else{
+            cerr << "Usage: " << argv[0] << " [--quick] [--filter text] [--json file]" << endl;
+            exit(2);
+        }
+    }
+    return options;
+}
+
+int main(int argc, char* argv[]){
+    BenchOptions options = parseOptions(argc, argv);
+    // Scales the iteration counts.
+    const uint64_t scale = options.quick ? 1 : 10;
+
+    // Progress goes to stderr when the JSON goes to stdout.
+    std::ostream & log = options.jsonFile == "-" ? cerr : cout;
+    std::vector<BenchResult> results;
+    auto selected = [&](const std::string & name){
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    };
+    auto record = [&](const BenchResult & r){
+        results.push_back(r);
+        printResult(log, r);
+    };
+
+    log << "Rendering " << BENCH_FRAME_POOL << " synthetic frames." << endl;
+    GrabBufferPool pool(FRAME_BYTES, BENCH_FRAME_POOL);
+    std::vector<const uint8_t *> frames = renderFramePool(pool);
+    auto poolFrame = [&](uint64_t i){ return frames[i % BENCH_FRAME_POOL]; };
+
+    // Baseline for the detection benchmarks from the frame pool.
+    BaselineData * baseline;
+    initBaselineData_h(baseline, CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
+    {
+        BaselineAccumulator accumulator;
+        for(uint64_t i = 0; i < BENCH_FRAME_POOL; i++) accumulator.addFrame(poolFrame(i));
+        accumulator.finish(baseline);
+    }
+
+    // Detection: counting pixels below the threshold in one frame on each CPU backend.
+    alignas(64) uint32_t count[PIXELS_PER_LINE];
+    for(DetectionBackend backend : {DetectionBackend::Scalar, DetectionBackend::SSE42, DetectionBackend::AVX2, DetectionBackend::AVX512}){
+        std::string name = std::string("detect.") + detectionBackendName(backend);
+        if(!selected(name) || !detectionBackendSupported(backend)) continue;
+        setDetectionBackend(backend);
+        record(runBench(name, "frames", 1, 100, 200*scale, [&](uint64_t i){
+            aboveThresholdCalcCPU(baseline->thresholdLine.data(), poolFrame(i), count);
+        }));
+    }
+
+    // Detection of a cropped frame on the best CPU backend, which can't use the build for the full width.
+    if(selected("detect.cropped")){
+        setDetectionBackend(bestDetectionBackend());
+        SensorGeometry cropped;
+        cropped.pixelsPerLine = BENCH_CROPPED_PIXELS_PER_LINE;
+        record(runBench("detect.cropped", "frames", 1, 100, 200*scale, [&](uint64_t i){
+            aboveThresholdCalcCPU(baseline->thresholdLine.data(), poolFrame(i), count, cropped);
+        }));
+    }
+
+    // Segmentation: splitting the per column counts of one frame into runs of blocked columns.
+    if(selected("detect.segment")){
+        setDetectionBackend(bestDetectionBackend());
+        std::vector<uint32_t> counts(BENCH_FRAME_POOL * PIXELS_PER_LINE);
+        for(uint64_t i = 0; i < BENCH_FRAME_POOL; i++){
+            aboveThresholdCalcCPU(baseline->thresholdLine.data(), poolFrame(i), counts.data() + i*PIXELS_PER_LINE);
+            // Block a few columns so there are runs to measure.
+            for(uint32_t c = 0; c < 4; c++){
+                uint32_t column = (i * 97 + c * 251) % (PIXELS_PER_LINE - 8);
+                std::fill_n(counts.data() + i*PIXELS_PER_LINE + column, 6, IMAGE_HEIGHT);
+            }
+        }
+        uint64_t checksum = 0;
+        record(runBench("detect.segment", "frames", 1, 100, 200*scale, [&](uint64_t i){
+            const uint32_t * frameCounts = counts.data() + (i % BENCH_FRAME_POOL)*PIXELS_PER_LINE;
+            uint64_t mask[PIXELS_PER_LINE/64];
+            ColumnRun runs[MAX_COLUMN_RUNS];
+            blockedColumnMask(frameCounts, mask);
+            checksum += segmentColumns(frameCounts, mask, runs, MAX_COLUMN_RUNS);
+        }));
+        benchSink = checksum;
+    }
+
+#ifdef LSAD_USE_HIP
+    // Detection on the GPU including the copies made by detectObject.
+    if(selected("detect.gpu")){
+        uint8_t * frame_d;
+        uint32_t * count_d;
+        uint32_t * thresholdLine_d;
+        HIP_CHECK(hipMalloc(&frame_d, FRAME_BYTES));
+        HIP_CHECK(hipMalloc(&count_d, PIXELS_PER_LINE*sizeof(uint32_t)));
+        HIP_CHECK(hipMalloc(&thresholdLine_d, LINE_BYTES_UINT32));
+        HIP_CHECK(hipMemcpy(thresholdLine_d, baseline->thresholdLine.data(), LINE_BYTES_UINT32, hipMemcpyHostToDevice));
+        record(runBench("detect.gpu", "frames", 1, 100, 200*scale, [&](uint64_t i){
+            HIP_CHECK(hipMemset(count_d, 0, PIXELS_PER_LINE*sizeof(uint32_t)));
+            HIP_CHECK(hipMemcpy(frame_d, poolFrame(i), FRAME_BYTES, hipMemcpyHostToDevice));
+            aboveThresholdCalcGPU(thresholdLine_d, frame_d, count_d, SensorGeometry());
+            HIP_CHECK(hipMemcpy(count, count_d, PIXELS_PER_LINE*sizeof(uint32_t), hipMemcpyDeviceToHost));
+        }));
+        HIP_CHECK(hipFree(frame_d));
+        HIP_CHECK(hipFree(count_d));
+        HIP_CHECK(hipFree(thresholdLine_d));
+    }
+#endif
+
+    // Baseline: folding one frame into the accumulator, and a whole streaming baseline of frames with the queue copies.
+    if(selected("baseline.accumulator")){
+        BaselineAccumulator accumulator;
+        record(runBench("baseline.accumulator", "frames", 1, 100, 200*scale, [&](uint64_t i){
+            accumulator.addFrame(poolFrame(i));
+        }));
+    }
+    if(selected("baseline.streaming")){
+        const uint64_t frames = 1024;
+        record(runBench("baseline.streaming", "frames", frames, 1, 2*scale, [&](uint64_t){
+            StreamingBaseline streaming;
+            for(uint64_t i = 0; i < frames; i++) streaming.addFrame(poolFrame(i));
+            streaming.finish(baseline);
+        }));
+    }
+    if(selected("baseline.adaptive")){
+        // Folding an idle frame into the adaptive baseline after it's measured, including the updates and publishing.
+        setDetectionBackend(bestDetectionBackend());
+        publishDetectionThreshold(0, makeDetectionThreshold(baseline, "bench"));
+        AdaptiveBaseline adaptive;
+        adaptive.setTimeConstant(1000);
+        std::fill_n(count, PIXELS_PER_LINE, 0);
+        record(runBench("baseline.adaptive", "frames", 1, 100, 2000*scale, [&](uint64_t i){
+            adaptive.addFrame(detectorContext().camera(0), poolFrame(i), count, currentDetectionThreshold(0));
+        }));
+        publishDetectionThreshold(0, nullptr);
+    }
+#ifdef LSAD_USE_HIP
+    if(selected("baseline.gpu")){
+        // baselineGPUCalculation takes NUM_SAMPLES frames already on the GPU.
+        uint8_t * frames_d;
+        HIP_CHECK(hipMalloc(&frames_d, DATA_BYTES));
+        for(uint64_t i = 0; i < NUM_SAMPLES; i++){
+            HIP_CHECK(hipMemcpy(frames_d + i*FRAME_BYTES, poolFrame(i), FRAME_BYTES, hipMemcpyHostToDevice));
+        }
+        BaselineData * gpuBaseline;
+        initBaselineData_h(gpuBaseline, CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
+        record(runBench("baseline.gpu", "frames", NUM_SAMPLES, 1, scale, [&](uint64_t){
+            baselineGPUCalculation(gpuBaseline, frames_d);
+        }));
+        delete gpuBaseline;
+        HIP_CHECK(hipFree(frames_d));
+    }
+#endif
+
+    // The SQLite benchmarks write to a scratch database that's removed afterwards.
+    char scratchDir[] = "/tmp/lsad_bench.XXXXXX";
+    if(mkdtemp(scratchDir) == NULL){
+        cerr << "Could not create a scratch directory. Aborting.\n";
+        std::abort();
+    }
+    std::string dbFilename = std::string(scratchDir) + "/bench.db";
+    writeBenchCoefficients(dbFilename.c_str());
+
+    // Estimation: screen positions from pairs of camera pixels.
+    if(selected("estimate.position")){
+        ScreenPositionEstimator estimator;
+        estimator.loadCoefficients(dbFilename.c_str());
+        std::vector<double> s0(BENCH_ESTIMATE_BATCH), s1(BENCH_ESTIMATE_BATCH);
+        for(int i = 0; i < BENCH_ESTIMATE_BATCH; i++){
+            s0[i] = (i * 37) % PIXELS_PER_LINE;
+            s1[i] = (i * 91) % PIXELS_PER_LINE;
+        }
+        uint64_t checksum = 0;
+        record(runBench("estimate.position", "estimates", BENCH_ESTIMATE_BATCH, 100, 200*scale, [&](uint64_t){
+            for(int i = 0; i < BENCH_ESTIMATE_BATCH; i++){
+                std::tuple<uint32_t,uint32_t> xy = estimator.estimatePosition(s0[i], s1[i]);
+                checksum += std::get<0>(xy) + std::get<1>(xy);
+            }
+        }));
+        benchSink = checksum;
+    }
+    if(selected("estimate.batch")){
+        ScreenPositionEstimator estimator;
+        estimator.loadCoefficients(dbFilename.c_str());
+        std::vector<double> s0(BENCH_ESTIMATE_BATCH), s1(BENCH_ESTIMATE_BATCH), x(BENCH_ESTIMATE_BATCH), y(BENCH_ESTIMATE_BATCH);
+        for(int i = 0; i < BENCH_ESTIMATE_BATCH; i++){
+            s0[i] = (i * 37) % PIXELS_PER_LINE + 0.25;
+            s1[i] = (i * 91) % PIXELS_PER_LINE + 0.75;
+        }
+        double checksum = 0;
+        record(runBench("estimate.batch", "estimates", BENCH_ESTIMATE_BATCH, 100, 200*scale, [&](uint64_t){
+            estimator.estimateBatch(s0.data(), s1.data(), BENCH_ESTIMATE_BATCH, x.data(), y.data());
+            checksum += x[0] + y[BENCH_ESTIMATE_BATCH - 1];
+        }));
+        benchSink = checksum;
+    }
+
+    if(selected("estimate.lut")){
+        // Building a table with a point every 16 pixels, small enough to stay in cache, then estimates from it. loadCoefficients caches the table in the scratch directory.
+        ScreenPositionEstimator estimator;
+        estimator.useLookupTable(16);
+        estimator.loadCoefficients(dbFilename.c_str());
+        PositionLookupTable table;
+        record(runBench("estimate.lut_build", "tables", 1, 1, 2*scale, [&](uint64_t){
+            table.build(estimator, 16);
+        }));
+        std::vector<double> s0(BENCH_ESTIMATE_BATCH), s1(BENCH_ESTIMATE_BATCH);
+        for(int i = 0; i < BENCH_ESTIMATE_BATCH; i++){
+            s0[i] = (i * 37) % PIXELS_PER_LINE + 0.25;
+            s1[i] = (i * 91) % PIXELS_PER_LINE + 0.75;
+        }
+        uint64_t checksum = 0;
+        record(runBench("estimate.lut", "estimates", BENCH_ESTIMATE_BATCH, 100, 200*scale, [&](uint64_t){
+            for(int i = 0; i < BENCH_ESTIMATE_BATCH; i++){
+                std::tuple<uint32_t,uint32_t> xy = estimator.estimatePosition(s0[i], s1[i]);
+                checksum += std::get<0>(xy) + std::get<1>(xy);
+            }
+        }));
+        benchSink = checksum;
+    }
+
+    if(selected("estimate.fusion")){
+        // Three sensors along the top of the screen, each seeing 90 degrees across its pixels.
+        SensorFusionEstimator fusion;
+        const double centers[BENCH_FUSION_SENSORS][2] = {{-20, -20}, {400, -400}, {820, -20}};
+        const double directions[BENCH_FUSION_SENSORS] = {M_PI/4, M_PI/2, 3*M_PI/4};
+        for(int n = 0; n < BENCH_FUSION_SENSORS; n++){
+            SensorLine line;
+            line.centerX = centers[n][0];
+            line.centerY = centers[n][1];
+            line.angle[1] = (M_PI/2) / PIXELS_PER_LINE;
+            line.angle[0] = directions[n] - M_PI/4;
+            line.angleRms = 1e-3;
+            line.points = 1;
+            fusion.setSensorLine(n, line);
+        }
+        std::vector<double> pixels(BENCH_ESTIMATE_BATCH*BENCH_FUSION_SENSORS);
+        for(size_t i = 0; i < pixels.size(); i++) pixels[i] = (i * 37) % PIXELS_PER_LINE + 0.25;
+        double checksum = 0;
+        record(runBench("estimate.fusion", "estimates", BENCH_ESTIMATE_BATCH, 100, 200*scale, [&](uint64_t){
+            for(int i = 0; i < BENCH_ESTIMATE_BATCH; i++){
+                double x, y;
+                if(fusion.estimatePosition(&pixels[i*BENCH_FUSION_SENSORS], BENCH_FUSION_SENSORS, x, y)) checksum += x + y;
+            }
+        }));
+        benchSink = checksum;
+    }
+
+    if(selected("sqlite.load_coefficients")){
+        ScreenPositionEstimator estimator;
+        record(runBench("sqlite.load_coefficients", "loads", 1, 5, 20*scale, [&](uint64_t){
+            estimator.loadCoefficients(dbFilename.c_str());
+        }));
+    }
+
+    // SQLite: a baseline, and a training session's datapoints.
+    if(selected("sqlite.write_baseline")){
+        // Queuing the baseline and waiting for the writer thread to commit it.
+        DatabaseService & database = DatabaseService::forFile(dbFilename.c_str());
+        record(runBench("sqlite.write_baseline", "pixels", PIXELS_PER_LINE, 2, 5*scale, [&](uint64_t){
+            writeBaselineToDB(baseline, dbFilename.c_str(), benchCameraNames[0].c_str());
+            database.flush();
+        }));
+    }
+    if(selected("sqlite.write_datapoints")){
+        std::vector<DataPoint> dataPoints(BENCH_DATAPOINTS);
+        for(int i = 0; i < BENCH_DATAPOINTS; i++){
+            dataPoints[i] = {(uint32_t) (i * 19) % 1920, (uint32_t) (i * 7) % 1080, (float) ((i * 37) % PIXELS_PER_LINE), (float) ((i * 91) % PIXELS_PER_LINE)};
+        }
+        DatabaseService & database = DatabaseService::forFile(dbFilename.c_str());
+        record(runBench("sqlite.write_datapoints", "rows", BENCH_DATAPOINTS, 2, 5*scale, [&](uint64_t){
+            writeDataPointsToDB(dataPoints, dbFilename.c_str());
+            database.flush();
+        }));
+    }
+    if(selected("sqlite.enqueue")){
+        // What a program waits for when it writes a baseline. The writer thread commits it in the background.
+        DatabaseService & database = DatabaseService::forFile(dbFilename.c_str());
+        record(runBench("sqlite.enqueue", "pixels", PIXELS_PER_LINE, 2, 5*scale, [&](uint64_t){
+            writeBaselineToDB(baseline, dbFilename.c_str(), benchCameraNames[0].c_str());
+        }));
+        database.flush();
+    }
+
+    if(selected("sqlite.read_baseline")){
+        // Finding the newest baseline and loading it, as the hot reloader does, with a history of baselines stored.
+        // They're stored under different camera names since they're all created in the same second.
+        for(int i = 0; i < BENCH_BASELINE_HISTORY; i++){
+            writeBaselineToDB(baseline, dbFilename.c_str(), ("bench" + std::to_string(i)).c_str());
+        }
+        DatabaseService::forFile(dbFilename.c_str()).flush();
+        struct BaselineData * loaded;
+        initBaselineData_h(loaded, CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
+        std::string cameraName = "bench" + std::to_string(BENCH_BASELINE_HISTORY / 2);
+        record(runBench("sqlite.read_baseline", "baselines", 1, 5, 50*scale, [&](uint64_t){
+            readBaselineFromDB(loaded, dbFilename.c_str(), cameraName.c_str(),
+                               latestBaselineTime(dbFilename.c_str(), cameraName.c_str()));
+        }));
+        delete loaded;
+    }
+
+    if(selected("startup.latest")){
+        // LSAD_STARTUP=latest: checking the newest times and copying the baselines and coefficients from the snapshot,
+        // and reading them from the database and writing the snapshot when it's out of date.
+        writeBaselineToDB(baseline, dbFilename.c_str(), benchCameraNames[0].c_str());
+        writeBaselineToDB(baseline, dbFilename.c_str(), benchCameraNames[1].c_str());
+        struct BaselineData * loaded[2];
+        initBaselineData_h(loaded[0], CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
+        initBaselineData_h(loaded[1], CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
+        std::string times[2];
+        ScreenPositionEstimator estimator;
+        std::string snapshotFile = std::string(scratchDir) + "/" + STARTUP_SNAPSHOT_FILENAME;
+        std::streambuf * coutBuffer = cout.rdbuf(nullptr);
+        BenchResult fromDatabase = runBench("startup.latest_database", "starts", 1, 2, 20*scale, [&](uint64_t){
+            unlink(snapshotFile.c_str());
+            loadStartupCalibration(dbFilename.c_str(), benchCameraNames, loaded, times, &estimator);
+        });
+        BenchResult fromSnapshot = runBench("startup.latest", "starts", 1, 5, 50*scale, [&](uint64_t){
+            loadStartupCalibration(dbFilename.c_str(), benchCameraNames, loaded, times, &estimator);
+        });
+        cout.rdbuf(coutBuffer);
+        cout.clear();
+        record(fromSnapshot);
+        record(fromDatabase);
+        delete loaded[0];
+        delete loaded[1];
+    }
+
+    if(selected("journal.append")){
+        // Appending a shot on the detection thread. Full segments are moved to the database in the background.
+        // Nearly a file's worth of shots, faster than any real shot rate, so the compactor moves them after.
+        ShotJournal journal(std::string(scratchDir) + "/" + SHOT_JOURNAL_FILENAME, dbFilename.c_str());
+        ShotRecord shot = {};
+        setShotTime(shot.baselineTime[0], "2024-01-01 00:00:00");
+        setShotTime(shot.baselineTime[1], "2024-01-01 00:00:00");
+        setShotTime(shot.coefficientsTime, "2024-01-01 00:00:00");
+        shot.pairings = 1;
+        record(runBench("journal.append", "shots", 1, 1000, SHOT_SEGMENT_RECORDS*(SHOT_SEGMENT_COUNT - 1), [&](uint64_t i){
+            shot.timeRecordedUs = i;
+            shot.x = i % 1920;
+            journal.append(shot);
+        }));
+        if(journal.droppedShots() > 0) cerr << "journal.append dropped " << journal.droppedShots() << " shots." << endl;
+    }
+
+    // Remove the database and anything cached next to it once its connection is closed.
+    DatabaseService::close(dbFilename.c_str());
+    if(DIR * dir = opendir(scratchDir)){
+        while(struct dirent * entry = readdir(dir)){
+            if(entry->d_name[0] != '.') unlink((std::string(scratchDir) + "/" + entry->d_name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(scratchDir);
+    delete baseline;
+
+    if(options.jsonFile == "-"){
+        writeJson(cout, results, options);
+    }
+    else if(!options.jsonFile.empty()){
+        std::ofstream out(options.jsonFile);
+        if(!out){
+            cerr << "Could not write " << options.jsonFile << ".\n";
+            return 1;
+        }
+        writeJson(out, results, options);
+        log << "Results written to " << options.jsonFile << "." << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// Replaces regression_fitting.py. Fits the calibration coefficients to the most recent training data
+// and adds them to the coefficients table, and each camera's line to the sensorLines table.
+
+#include "calibrationFitting.h"
+#include "CameraConfiguration.h"
+#include "filenames.h"
+#include "globals.h"
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+using std::cout, std::cerr, std::endl;
+
+int main(int argc, char* argv[]){
+    // The database defaults to DB_FILENAME in DB_PATH. A different file can be given as the only argument.
+    const char * filename = DB_FILENAME;
+    if(argc > 2 || (argc == 2 && argv[1][0] == '-')){
+        cerr << "Usage: " << argv[0] << " [database]" << endl;
+        return 1;
+    }
+    if(argc == 2){
+        filename = argv[1];
+    }
+    else{
+        chdir(DB_PATH);
+    }
+
+    try{
+        auto start = std::chrono::steady_clock::now();
+        std::string trainingTime;
+        std::vector<struct DataPoint> dataPoints = readDataPointsFromDB(filename, trainingTime);
+        if(dataPoints.empty()){
+            throw std::runtime_error(std::string("There's no training data in ") + filename + ".");
+        }
+
+        CalibrationFit fit = fitCalibration(dataPoints);
+        std::string coefficientsTime = writeCalibrationToDB(fit, filename);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Report the timeCreated columns.
+        cout << "Coefficients have been generated for the training data collected: " << trainingTime << endl
+             << "Row in coefficients timeCreated column: " << coefficientsTime << endl
+             << "Points: " << fit.points << " RMS error x: " << fit.rmsErrorX << " y: " << fit.rmsErrorY
+             << " pixels. Took " << ms << " ms." << endl;
+
+        // The line each camera's pixel falls on, for LSAD_POSITION_MODEL=lines, for every camera training recorded.
+        // Training data from before trainingPixels only has the first two cameras named.
+        std::vector<CameraSamples> pixels = readTrainingPixelsFromDB(filename, trainingTime);
+        if(pixels.empty()) pixels = cameraSamples(dataPoints, cameraNames());
+        std::vector<std::string> errors;
+        std::vector<SensorLine> lines = fitSensorLines(pixels, errors);
+        for(const std::string & error : errors) cerr << error << endl;
+        if(errors.size() < lines.size()){
+            std::string linesTime = writeSensorLinesToDB(cameraSampleNames(pixels), lines, filename);
+            cout << "Row(s) in sensorLines timeCreated column: " << linesTime << endl;
+            for(size_t i = 0; i < lines.size(); i++){
+                if(lines[i].points == 0) continue;
+                cout << pixels[i].cameraName << " center: (" << lines[i].centerX << ',' << lines[i].centerY
+                     << ") RMS angle error: " << lines[i].angleRms << " radians." << endl;
+            }
+        }
+    }
+    catch (const std::exception &e){
+        cerr << "An exception occurred." << endl
+             << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
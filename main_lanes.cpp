@@ -0,0 +1,212 @@
+// Line Sensor Arrow Detection uses line sensors to measure the location an
+// arrow hits a projector screen.
+//
+// Copyright (C) 2020  Nathan W. Crozier
+//
+// This file is part of Line Sensor Arrow Detection
+//
+// Line Sensor Arrow Detection is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Line Camera Arrow Detection is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "Lane.h"
+#include "ShotJournal.h"
+#include "cameraEvent.h"
+#include "filenames.h"
+#include "setupCleanupFunctions.h"
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using std::cout, std::cin, std::endl, std::cerr;
+
+// How long the output loop sleeps when no lane has an event waiting.
+#define LANES_POLL_SLEEP_US 50
+
+// Commands entered on stdin, read on their own thread so the output loop never waits for input.
+static std::atomic<bool> quitRequested(false);
+static std::atomic<bool> reloadRequested(false);
+static std::atomic<bool> checkpointRequested(false);
+
+// Enter e to stop, r to reload every lane's newest baselines and sensor lines,
+// or b to write the baselines being used to the database. Keeps running when stdin is closed.
+static void readCommands(){
+    char command;
+    while(cin >> command){
+        if(command == 'e') quitRequested = true;
+        if(command == 'r') reloadRequested = true;
+        if(command == 'b') checkpointRequested = true;
+    }
+}
+
+// Add the position estimated from run0 of the lane's first camera and run1 of its second camera in event to journal.
+// pairings is how many positions were estimated from event.
+static void journalShot(ShotJournal & journal, Lane & lane, const StereoEvent & event, uint32_t run0, uint32_t run1,
+                        double x, double y, const std::string & linesTime, uint32_t pairings){
+    ShotRecord shot = {};
+    shot.timeRecordedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    uint32_t runs[2] = {run0, run1};
+    for(uint32_t i = 0; i < 2; i++){
+        const DetectionResult & result = event.result[i];
+        const ColumnRun & run = result.runs[runs[i]];
+        shot.timestamp[i] = result.timestamp;
+        shot.frameNumber[i] = result.frameNumber;
+        shot.firstColumn[i] = run.firstColumn;
+        shot.lastColumn[i] = run.lastColumn;
+        shot.centroid[i] = run.centroid;
+        shot.width[i] = run.width;
+        std::shared_ptr<const DetectionThreshold> threshold = currentDetectionThreshold(lane.detector().camera(i));
+        setShotTime(shot.baselineTime[i], threshold ? threshold->timeCreated : std::string());
+    }
+    shot.x = (uint32_t) x;
+    shot.y = (uint32_t) y;
+    setShotTime(shot.coefficientsTime, linesTime);
+    shot.lane = lane.number();
+    shot.pairings = pairings;
+    journal.append(shot);
+}
+
+// Estimate and report the position of every pairing of the objects in a matched event from lane.
+static void reportImpacts(Lane & lane, const StereoEvent & event, ShotJournal * journal){
+    const DetectionResult & result0 = event.result[0];
+    const DetectionResult & result1 = event.result[1];
+    if(!result0.detected || !result1.detected) return;
+
+    // The lines are held for the event, so a reload can't replace them part way through.
+    std::shared_ptr<const SensorFusionEstimator> fusion = lane.fusionEstimator();
+    struct Impact { uint32_t run0, run1; double x, y; };
+    Impact impacts[MAX_COLUMN_RUNS * MAX_COLUMN_RUNS];
+    uint32_t impactCount = 0;
+    for(uint32_t i = 0; i < result0.runCount; i++){
+        for(uint32_t j = 0; j < result1.runCount; j++){
+            double pixels[2] = {result0.runs[i].centroid, result1.runs[j].centroid};
+            double x, y;
+            // Pairings of different objects can cross behind the screen.
+            if(!fusion->estimatePosition(pixels, 2, x, y) || x < 0 || y < 0) continue;
+            impacts[impactCount++] = {i, j, x, y};
+        }
+    }
+
+    // Every position is recorded with how many there were, so the ones paired from different objects can be told apart.
+    for(uint32_t k = 0; k < impactCount; k++){
+        const Impact & impact = impacts[k];
+        if(journal){
+            journalShot(*journal, lane, event, impact.run0, impact.run1, impact.x, impact.y, fusion->linesTime(),
+                        impactCount);
+        }
+        cout << "Lane " << lane.number() << ": Impact at (x,y) (" << (uint32_t) impact.x << ','
+             << (uint32_t) impact.y << ")" << endl;
+    }
+}
+
+int main(int argc, char* argv[]){
+    chdir(DB_PATH);
+
+    // Every lane pairs its own two cameras, listed in LSAD_LANES.
+    std::vector<LaneSettings> laneSettings;
+    try{
+        laneSettings = lanesFromEnvironment();
+    }
+    catch(const std::exception & e){
+        cerr << e.what() << endl;
+        return 1;
+    }
+    if(laneSettings.empty()){
+        cerr << "Set " << LANES_ENV << " to the cameras of each lane, e.g. \"L45,L90;R45,R90\"." << endl;
+        return 1;
+    }
+
+    // Open every lane's cameras, or synthetic cameras when LSAD_FRAME_SOURCE=synthetic, while the lanes are set up.
+    std::future<std::vector<std::unique_ptr<FrameSource>>> openingCameras =
+            openFrameSourcesAsync(AcquisitionMode::Continuous, cameraNames().size());
+
+    // Every lane compares frames with the same backend.
+    selectDetectionBackend();
+
+    int exitCode = 0;
+    try{
+        // Each lane loads its own baselines and sensor lines and follows new ones written to the database.
+        std::vector<std::unique_ptr<Lane>> lanes;
+        for(uint32_t i = 0; i < laneSettings.size(); i++){
+            lanes.emplace_back(new Lane(i, laneSettings[i]));
+        }
+
+        // Shots from every lane go to one journal, written only by the loop below.
+        std::unique_ptr<ShotJournal> journal;
+        if(shotJournalFromEnvironment()){
+            journal.reset(new ShotJournal(shotJournalPath(DB_FILENAME), DB_FILENAME));
+        }
+
+        std::vector<std::unique_ptr<FrameSource>> cameras = openingCameras.get();
+        StereoSettings stereoSettings = stereoSettingsFromEnvironment();
+        for(std::unique_ptr<Lane> & lane : lanes) lane->attach(cameras, stereoSettings);
+        for(std::unique_ptr<Lane> & lane : lanes) lane->startGrabbing();
+
+        // The thread is left waiting for input when the program exits.
+        std::thread(readCommands).detach();
+
+        // One loop takes the events of every lane in turn, so no lane waits on another's slow event.
+        cout << "Detecting in " << lanes.size() << " lanes. Enter e to exit." << endl;
+        bool grabbing = true;
+        while(!quitRequested && grabbing){
+            if(reloadRequested.exchange(false)){
+                for(std::unique_ptr<Lane> & lane : lanes) lane->requestReload();
+            }
+            if(checkpointRequested.exchange(false)){
+                for(std::unique_ptr<Lane> & lane : lanes) checkpointBaselines(lane->detector(), DB_FILENAME);
+            }
+
+            bool idle = true;
+            for(std::unique_ptr<Lane> & lane : lanes){
+                grabbing = grabbing && lane->isGrabbing();
+                StereoEvent event;
+                if(!lane->poll(event)) continue;
+                idle = false;
+
+                if(event.type != StereoEventType::Matched){
+                    cerr << "Lane " << lane->number() << ": " << lane->camera(event.cameraNo).name() << " frame "
+                         << event.result[event.cameraNo].frameNumber
+                         << (event.type == StereoEventType::Late ? " arrived after its partner was given up on." : " has no matching frame.")
+                         << endl;
+                    continue;
+                }
+                reportImpacts(*lane, event, journal.get());
+            }
+            if(idle) std::this_thread::sleep_for(std::chrono::microseconds(LANES_POLL_SLEEP_US));
+        }
+
+        for(std::unique_ptr<Lane> & lane : lanes) lane->stopGrabbing();
+
+        // Keep what the adaptive baselines learned for the next run.
+        if(adaptiveBaselineFramesFromEnvironment() > 0){
+            for(std::unique_ptr<Lane> & lane : lanes) checkpointBaselines(lane->detector(), DB_FILENAME);
+        }
+
+        // The lanes release their thresholds before the cameras are closed.
+        lanes.clear();
+    }
+    catch (const std::exception &e){
+        cerr << "An exception occurred." << endl
+             << e.what() << endl;
+        exitCode = 1;
+    }
+
+    // Releases all pylon resources.
+    frameSourcesTerminate();
+
+    cout << "Exiting with code: " << exitCode << endl;
+    return exitCode;
+}
@@ -23,6 +23,12 @@
 
 #include "main_training.h"
 #include "ScreenPositionEstimator.h"
+#include "SensorFusion.h"
+#include "HotReloader.h"
+#include "ShotJournal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
 
 
@@ -30,28 +36,119 @@
 // The number of pixels bordering the estimated position on the screen in each direction.
 #define PIXEL_BORDER 1
 
-// Namespace for using pylon objects.
-using namespace Pylon;
 using std::cout, std::cin, std::endl, std::cerr;
 
+// Pairs of frames that can be triggered before the first has been processed.
+// Two lets the cameras grab frame N+1 while detectObject is working on frame N.
+#define FRAMES_IN_FLIGHT 2
+
+// Environment variable choosing how frames are grabbed.
+// "continuous" free runs the cameras at their fastest line rate and reports each impact. This is the default.
+// "trigger" triggers a pair of frames at a time and reports every frame an object is in.
+#define DETECTION_MODE_ENV "LSAD_DETECTION_MODE"
+
+// True unless DETECTION_MODE_ENV asks for software triggering.
+static bool freeRunningFromEnvironment(){
+    const char * value = getenv(DETECTION_MODE_ENV);
+    if(value == NULL || strcmp(value, "continuous") == 0) return true;
+    if(strcmp(value, "trigger") == 0) return false;
+    throw std::runtime_error(std::string("Unknown ") + DETECTION_MODE_ENV + " \"" + value + "\".");
+}
+
 // Number of images to be grabbed.
 static const uint32_t c_countOfImagesToGrab = 100000;
 
+// Estimate the point for every pairing of a camera 0 pixel with a camera 1 pixel from the sensor lines,
+// the same way ScreenPositionEstimator::estimatePositions does. Pairings without a position are put off the screen.
+static void estimateFusedPositions(const SensorFusionEstimator & fusion, const double * s0, uint32_t n0,
+                                   const double * s1, uint32_t n1, std::tuple<uint32_t,uint32_t> * positions){
+    for(uint32_t i = 0; i < n0; i++){
+        for(uint32_t j = 0; j < n1; j++){
+            double pixels[2] = {s0[i], s1[j]};
+            double x, y;
+            bool onScreen = fusion.estimatePosition(pixels, 2, x, y) && x >= 0 && y >= 0 && x < SCREEN_WIDTH && y < SCREEN_HEIGHT;
+            positions[i*n1 + j] = onScreen ? std::make_tuple((uint32_t) x, (uint32_t) y) : std::make_tuple(UINT32_MAX, UINT32_MAX);
+        }
+    }
+}
+
+// Add the position estimated from run0 of camera 0 and run1 of camera 1 in event to journal.
+// calibrationTime is when the coefficients or sensor lines used were created, and pairings is how many positions on
+// the screen were estimated from event.
+static void journalShot(ShotJournal & journal, const StereoEvent & event, uint32_t run0, uint32_t run1,
+                        uint32_t x, uint32_t y, const std::string & calibrationTime, uint32_t pairings){
+    ShotRecord shot = {};
+    shot.timeRecordedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    uint32_t runs[2] = {run0, run1};
+    for(uint32_t i = 0; i < 2; i++){
+        const DetectionResult & result = event.result[i];
+        const ColumnRun & run = result.runs[runs[i]];
+        shot.timestamp[i] = result.timestamp;
+        shot.frameNumber[i] = result.frameNumber;
+        shot.firstColumn[i] = run.firstColumn;
+        shot.lastColumn[i] = run.lastColumn;
+        shot.centroid[i] = run.centroid;
+        shot.width[i] = run.width;
+        // The version in use now. A reload between the frame and this event is rare enough not to matter.
+        std::shared_ptr<const DetectionThreshold> threshold = currentDetectionThreshold(i);
+        setShotTime(shot.baselineTime[i], threshold ? threshold->timeCreated : std::string());
+    }
+    shot.x = x;
+    shot.y = y;
+    setShotTime(shot.coefficientsTime, calibrationTime);
+    shot.pairings = pairings;
+    journal.append(shot);
+}
+
 int main(int argc, char* argv[]){
     chdir(DB_PATH);
 
-    // Allocate host memory.
-    hostSetup();
+    // Time each frame's stages from the trigger to the screen when built with LSAD_TRACING.
+    LSAD_TRACE_START();
+
+    // Free running cameras catch arrows that would pass between software triggers.
+    bool freeRunning = freeRunningFromEnvironment();
+
+    // Open the cameras, or synthetic cameras when LSAD_FRAME_SOURCE=synthetic, while everything else is set up.
+    // Before using any pylon methods, the pylon runtime must be initialized. This is done on the same thread.
+    std::future<std::vector<std::unique_ptr<FrameSource>>> openingCameras =
+            openFrameSourcesAsync(freeRunning ? AcquisitionMode::Continuous : AcquisitionMode::SoftwareTrigger, 2);
+
+    // Allocate host memory for the two cameras named first in LSAD_CAMERA_NAMES.
+    hostSetup(2);
+
+    // LSAD_POSITION_LUT_STRIDE answers each estimate from a lookup table.
+    uint32_t lookupStride = positionLookupStrideFromEnvironment();
+    std::shared_ptr<ScreenPositionEstimator> startupEstimator = std::make_shared<ScreenPositionEstimator>();
+    startupEstimator->useLookupTable(lookupStride);
 
-    // Initialize host memory with baseline pixel data from an SQLite file.
-    loadBaseline();
+    // LSAD_STARTUP=latest loads the newest baselines and coefficients without asking.
+    bool startWithLatest = startWithLatestFromEnvironment();
+    if(startWithLatest){
+        loadLatestCalibration(startupEstimator.get());
+    }
+    else{
+        // Initialize host memory with baseline pixel data from an SQLite file.
+        loadBaseline();
+    }
 
     // Allocate and initialize device memory.
     deviceSetup();
 
     // Load coefficients for the fitting equation from an SQLite file.
-    ScreenPositionEstimator pixelEstimator;
-    pixelEstimator.loadCoefficients(DB_FILENAME);
+    if(!startWithLatest){
+        startupEstimator->loadCoefficients(DB_FILENAME);
+    }
+
+    // LSAD_POSITION_MODEL=lines intersects each camera's line instead of evaluating the polynomials.
+    std::shared_ptr<const SensorFusionEstimator> startupFusion;
+    if(sensorLinesFromEnvironment()){
+        std::shared_ptr<SensorFusionEstimator> fusion = std::make_shared<SensorFusionEstimator>();
+        fusion->loadSensorLines(DB_FILENAME, cameraNames());
+        cout << "Estimating positions from the sensor lines created " << fusion->linesTime() << "." << endl;
+        startupFusion = fusion;
+    }
 
     // Setup SDL and create window.
     const char * title = "Testing Continous";
@@ -63,45 +160,31 @@ int main(int argc, char* argv[]){
     int exitCode = 0;
     try{
 
-        // Before using any pylon methods, the pylon runtime must be initialized.
-        PylonInitialize();
-
-        // Only look for cameras supported by Camera_t
-        CDeviceInfo info;
-        info.SetDeviceClass( Camera_t::DeviceClass());
-
-        // Get the transport layer factory.
-        CTlFactory& tlFactory = CTlFactory::GetInstance();
+        // Every shot is journaled and moved to the shots table in the background. LSAD_SHOT_JOURNAL=0 turns it off.
+        // What's left in the journal is moved when the try block ends.
+        std::unique_ptr<ShotJournal> journal;
+        if(shotJournalFromEnvironment()){
+            journal.reset(new ShotJournal(shotJournalPath(DB_FILENAME), DB_FILENAME));
+        }
 
-        // Get all attached devices and exit application if no device is found.
-        // There should be two camera's attached with user defined names L45 and L90.
-        DeviceInfoList_t devices;
-        if( tlFactory.EnumerateDevices(devices) == 0){
-            throw RUNTIME_EXCEPTION("No camera present.");
+        // There should be two camera's attached with the first two user defined names, L45 and L90 by default.
+        std::vector<std::unique_ptr<FrameSource>> cameras = openingCameras.get();
+        if(cameras.size() < 2){
+            throw std::runtime_error("Two cameras are needed.");
         }
 
-        // Create a camera array for two cameras.
-        Camera_t cameras[2];
+        // Measure each camera's frames at the size it sends them.
+        useCameraGeometry(cameras);
 
-        // This smart pointer will receive the grab result data.
-        GrabResultPtr_t ptrGrabResult[2];
+        // Pick up new baselines and coefficients written to the database without stopping detection.
+        // Started once the cameras' widths are set, since a reloaded baseline is checked against them.
+        // It's stopped before the thresholds are released when the try block ends.
+        HotReloader reloader(detectorContext(), DB_FILENAME, startupEstimator, startupFusion, lookupStride, reloadIntervalFromEnvironment());
 
-        // Setup the cameras for software triggering and set the grab strategy.
+        // Deliver frames to detectImpact or detectObject and start grabbing using the source's grab thread.
         for(int i = 0; i < 2; i++){
-            camSetupSoftwareTrigger(cameras[i],devices[i], tlFactory);
-            // Can both camera devices be queried whether it is ready to accept the next frame trigger?
-            if (cameras[i].CanWaitForFrameTriggerReady()) {
-
-                // Start the grabbing using the grab loop thread, by setting the grabLoopType parameter
-                // to GrabLoop_ProvidedByInstantCamera. The grab results are delivered to the image event handlers.
-                // The GrabStrategy_OneByOne default grab strategy is used.
-                cameras[i].StartGrabbing(GrabStrategy_OneByOne, GrabLoop_ProvidedByInstantCamera);
-            }
-            else{
-                // See the documentation of CInstantCamera::CanWaitForFrameTriggerReady() for more information.
-                cout << "\nThis sample can only be used with cameras that can be queried whether they are ready to accept the next frame trigger.\n";
-                throw RUNTIME_EXCEPTION("CanWaitForFrameTriggerReady() failed.");
-            }
+            cameras[i]->setFrameHandler(freeRunning ? detectImpact : detectObject);
+            cameras[i]->startGrabbing();
         }
 
         // Used to hold the return value from estimatePosition.
@@ -110,76 +193,169 @@ int main(int argc, char* argv[]){
         uint32_t x = 0;
         uint32_t y = 0;
 
-        while (cameras[0].IsGrabbing() && cameras[1].IsGrabbing()){
-            // The posible range for pixelCamera0 and pixelCamera1 is 0 - PIXELS_PER_LINE
-            // Set outside that range to mean an object is not detected.
-            pixelCamera0 = pixelCamera1 = PIXELS_PER_LINE + 1;
-
-            // Execute a software trigger sequentially on both cameras.
-            // A new thread for both cameras is created for grabbing and processing the image.
-            for(int i = 1; i >= 0; i--) {
-                if (cameras[i].WaitForFrameTriggerReady(500, TimeoutHandling_ThrowException)) {
-                    // Execute the software trigger. Wait up to 500 ms for the camera to be ready for trigger.
-                    cameraEventComplete[i] = false;
-                    cameras[i].ExecuteSoftwareTrigger();
-                }
+        // Match the results from the two cameras by chunk timestamp.
+        // Free running cameras aren't synchronized, so an impact can start up to a frame apart in the two cameras.
+        StereoSettings stereoSettings = stereoSettingsFromEnvironment();
+        if(freeRunning){
+            for(int i = 0; i < 2; i++){
+                double frameRate = cameras[i]->frameRate();
+                if(frameRate > 0) stereoSettings.windowUs = std::max(stereoSettings.windowUs, 1000000 / frameRate);
+            }
+        }
+        StereoCorrelator correlator(stereoSettings);
+        calibrateClockOffsets(cameras, correlator);
+
+        // Frames triggered on each camera that haven't come out of the correlator yet.
+        uint32_t framesInFlight[2] = {0, 0};
+        // Triggers executed on each camera. The nth trigger grabs frame number n.
+        [[maybe_unused]] uint64_t triggersIssued[2] = {0, 0};
+
+        while (cameras[0]->isGrabbing() && cameras[1]->isGrabbing()){
+            // Press r in the window to reload the newest baseline and coefficients,
+            // or b to write the baselines being used, adapted or not, to the database.
+            while(SDL_PollEvent(&e)){
+                if(e.type != SDL_KEYDOWN) continue;
+                if(e.key.keysym.sym == SDLK_r) reloader.requestReload();
+                if(e.key.keysym.sym == SDLK_b) checkpointBaselines(DB_FILENAME);
             }
 
-            // Wait until the event handlers for both cameras process the frame grabbed.
-            std::unique_lock<std::mutex> lk0(m[0]);
-            std::unique_lock<std::mutex> lk1(m[1]);
-            cv[0].wait(lk0, []{return cameraEventComplete[0];});
-            cv[1].wait(lk1, []{return cameraEventComplete[1];});
-
-            // Check to see if an object was detected calculate the point from an equation.
-            // pixelCamera0 and pixelCamera1 are set by the OnImageGrabbed event handler when a frame is grabbed.
-            if(pixelCamera0 < PIXELS_PER_LINE + 1 && pixelCamera1 < PIXELS_PER_LINE + 1){
-                // Get the extimated (x,y) from a polynomial equation.
-                xyTuple = pixelEstimator.estimatePosition(pixelCamera0,pixelCamera1);
-                x = std::get<0>(xyTuple);
-                y = std::get<1>(xyTuple);
-
-                // Draw a point in blue.
-                if(IMPACT_TESTING){
-                    for(int xi = x - PIXEL_BORDER; xi <= x + PIXEL_BORDER; xi++) {
-                        for(int yi = y - PIXEL_BORDER; yi <= y +  PIXEL_BORDER; yi++) {
-                            SDL_SetRenderDrawColor(gRenderer, 0, 0, 255, 255);
-                            SDL_RenderDrawPoint(gRenderer, xi, yi);
-                            SDL_RenderPresent(gRenderer);
+            StereoEvent event;
+            if(freeRunning){
+                // The cameras grab on their own. Wait for the next impact.
+                if(!waitForStereoEvent(correlator, event, 1000)) continue;
+            }
+            else{
+                // Trigger the next frame on both cameras while earlier frames are still being processed.
+                // Each camera's frame is processed by detectObject on the camera's grab thread.
+                bool canTrigger = framesInFlight[0] < FRAMES_IN_FLIGHT && framesInFlight[1] < FRAMES_IN_FLIGHT;
+                if(canTrigger){
+                    for(int i = 1; i >= 0; i--) {
+                        if (cameras[i]->waitForFrameTriggerReady(500)) {
+                            // Execute the software trigger. Wait up to 500 ms for the camera to be ready for trigger.
+                            cameras[i]->executeSoftwareTrigger();
+                            framesInFlight[i]++;
+                            LSAD_TRACE(TriggerIssued, i, ++triggersIssued[i]);
                         }
                     }
+                }
 
-                    sleep(1);
-                    std::cout << "Object detected. Point Drawn centered at (x,y) (" << x << ',' << y<< ")" << endl;
+                // Take the next event from the correlator. Only wait when no more frames can be triggered.
+                if(canTrigger){
+                    if(!pollStereoEvent(correlator, event)) continue;
+                }
+                else if(!waitForStereoEvent(correlator, event, 1000)){
+                    throw std::runtime_error("Timed out waiting for a frame from both cameras.");
+                }
+                for(uint32_t i = 0; i < 2; i++){
+                    bool hasResult = event.type == StereoEventType::Matched || event.cameraNo == i;
+                    if(hasResult && framesInFlight[i] > 0) framesInFlight[i]--;
+                }
+            }
+
+            if(event.type != StereoEventType::Matched){
+                cerr << cameras[event.cameraNo]->name() << " frame " << event.result[event.cameraNo].frameNumber
+                     << (event.type == StereoEventType::Late ? " arrived after its partner was given up on." : " has no matching frame.")
+                     << endl;
+                continue;
+            }
+            DetectionResult & result0 = event.result[0];
+            DetectionResult & result1 = event.result[1];
+            LSAD_TRACE_PAIR(PairMatched, result0.frameNumber, result1.frameNumber);
+
+            // Check to see if an object was detected calculate the points from an equation.
+            if(result0.detected && result1.detected){
+                // Get the extimated (x,y) for every pairing of the objects seen by each camera.
+                // With one object in each camera there's a single point.
+                double pixels0[MAX_COLUMN_RUNS], pixels1[MAX_COLUMN_RUNS];
+                for(uint32_t i = 0; i < result0.runCount; i++) pixels0[i] = result0.runs[i].centroid;
+                for(uint32_t i = 0; i < result1.runCount; i++) pixels1[i] = result1.runs[i].centroid;
+                std::tuple<uint32_t,uint32_t> positions[MAX_COLUMN_RUNS*MAX_COLUMN_RUNS];
+                uint32_t positionCount = result0.runCount * result1.runCount;
+                // The estimator is held for the event, so a reload can't replace it part way through.
+                std::shared_ptr<ScreenPositionEstimator> pixelEstimator = reloader.estimator();
+                std::shared_ptr<const SensorFusionEstimator> fusion = reloader.fusionEstimator();
+                if(fusion){
+                    estimateFusedPositions(*fusion, pixels0, result0.runCount, pixels1, result1.runCount, positions);
                 }
                 else{
-                    SDL_SetRenderDrawColor(gRenderer, 0, 0, 255, 255);
-                    SDL_RenderDrawPoint(gRenderer,x,y);
-                    SDL_RenderPresent(gRenderer);
-                    std::cerr << "Object detected. Point Drawn at (x,y) (" << x << ',' << y<< ")" << endl;
+                    pixelEstimator->estimatePositions(pixels0, result0.runCount, pixels1, result1.runCount, positions);
+                }
+                const std::string & calibrationTime = fusion ? fusion->linesTime() : pixelEstimator->coefficientsTime();
+                LSAD_TRACE_PAIR(PositionEstimated, result0.frameNumber, result1.frameNumber);
+                if(positionCount > 1){
+                    cerr << "Objects seen by L45: " << result0.runCount << " by L90: " << result1.runCount
+                         << ". Drawing every pairing on the screen." << endl;
+                }
 
+                // Pairings of different objects can land off the screen.
+                uint32_t pairings = 0;
+                for(uint32_t p = 0; p < positionCount; p++){
+                    if(std::get<0>(positions[p]) < SCREEN_WIDTH && std::get<1>(positions[p]) < SCREEN_HEIGHT) pairings++;
                 }
 
+                for(uint32_t p = 0; p < positionCount; p++){
+                    xyTuple = positions[p];
+                    x = std::get<0>(xyTuple);
+                    y = std::get<1>(xyTuple);
+
+                    if(x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT) continue;
+
+                    if(journal){
+                        journalShot(*journal, event, p / result1.runCount, p % result1.runCount, x, y, calibrationTime,
+                                    pairings);
+                    }
+
+                    // Draw a point in blue.
+                    if(IMPACT_TESTING){
+                        for(int xi = x - PIXEL_BORDER; xi <= x + PIXEL_BORDER; xi++) {
+                            for(int yi = y - PIXEL_BORDER; yi <= y +  PIXEL_BORDER; yi++) {
+                                SDL_SetRenderDrawColor(gRenderer, 0, 0, 255, 255);
+                                SDL_RenderDrawPoint(gRenderer, xi, yi);
+                                SDL_RenderPresent(gRenderer);
+                            }
+                        }
+                        LSAD_TRACE_PAIR(FramePresented, result0.frameNumber, result1.frameNumber);
+
+                        sleep(1);
+                        std::cout << "Object detected. Point Drawn centered at (x,y) (" << x << ',' << y<< ")" << endl;
+                    }
+                    else{
+                        SDL_SetRenderDrawColor(gRenderer, 0, 0, 255, 255);
+                        SDL_RenderDrawPoint(gRenderer,x,y);
+                        SDL_RenderPresent(gRenderer);
+                        LSAD_TRACE_PAIR(FramePresented, result0.frameNumber, result1.frameNumber);
+                        std::cerr << "Object detected. Point Drawn at (x,y) (" << x << ',' << y<< ")" << endl;
+
+                    }
+                }
             }
         }
     }
-    catch (const GenericException &e){
+    catch (const std::exception &e){
         // Error handling.
         cerr << "An exception occurred." << endl
-             << e.GetDescription() << endl;
+             << e.what() << endl;
         exitCode = 1;
 
         // Remove left over characters from input buffer.
         cin.ignore(cin.rdbuf()->in_avail());
     }
 
+    // Print where the time went.
+    LSAD_TRACE_STOP();
+
     // Comment the following three lines to disable waiting on exit.
     cout << endl << "Press Any key(s) and Enter to exit." << endl;
     std::string dummyVariable;
     cin >> dummyVariable;
 
+    // Keep what the adaptive baseline learned for the next run.
+    if(adaptiveBaselineFramesFromEnvironment() > 0){
+        checkpointBaselines(DB_FILENAME);
+    }
+
     // Releases all pylon resources.
-    PylonTerminate();
+    frameSourcesTerminate();
 
     //Free resources and close SDL
     sdlCleanup();
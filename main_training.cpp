@@ -23,18 +23,32 @@
 
 #include "main_training.h"
 
-// Namespace for using pylon objects.
-using namespace Pylon;
 using std::cout, std::cin, std::endl, std::cerr;
 
+// Environment variable. When set to 1 the calibration starts from the most recent training data,
+// so a few points touch up the last calibration instead of replacing it.
+#define TRAINING_TOUCH_UP_ENV "LSAD_TRAINING_TOUCH_UP"
+
 int main(int argc, char* argv[]){
     chdir(DB_PATH);
 
-    // Allocate host memory.
-    hostSetup();
+    // Open the cameras, or synthetic cameras when LSAD_FRAME_SOURCE=synthetic, while everything else is set up.
+    // Before using any pylon methods, the pylon runtime must be initialized. This is done on the same thread.
+    // Every camera named is opened. The first two give the coefficients and each one's pixels give its sensor line.
+    std::future<std::vector<std::unique_ptr<FrameSource>>> openingCameras =
+            openFrameSourcesAsync(AcquisitionMode::SoftwareTrigger, cameraNames().size());
+
+    // Allocate host memory for every camera named in LSAD_CAMERA_NAMES.
+    hostSetup(cameraNames().size());
 
-    // Initialize host memory with baseline pixel data from an SQLite file.
-    loadBaseline();
+    // LSAD_STARTUP=latest loads the newest baselines without asking.
+    if(startWithLatestFromEnvironment()){
+        loadLatestCalibration(nullptr);
+    }
+    else{
+        // Initialize host memory with baseline pixel data from an SQLite file.
+        loadBaseline();
+    }
 
     // Allocate and initialize device memory.
     deviceSetup();
@@ -60,51 +74,49 @@ int main(int argc, char* argv[]){
     // This variable holds the current datapoint and is added to the dataPoints vector.
     struct DataPoint currentPoint;
 
+    // Each camera's pixel for the points, for fitting its sensor line.
+    std::vector<CameraSamples> pixels;
+
+    // The calibration is updated as each point is collected and written once there are enough points.
+    OnlineCalibration calibration;
+    ScreenPositionEstimator estimator;
+    const char * touchUp = getenv(TRAINING_TOUCH_UP_ENV);
+    if(touchUp != NULL && strcmp(touchUp, "1") == 0){
+        // The old points are written again with the new ones, so the stored training data matches the calibration.
+        std::string previousTime;
+        dataPoints = readDataPointsFromDB(DB_FILENAME, previousTime);
+        pixels = readTrainingPixelsFromDB(DB_FILENAME, previousTime);
+        if(pixels.empty()) pixels = cameraSamples(dataPoints, cameraNames());
+        calibration.addPoints(dataPoints);
+        calibration.publish(estimator);
+        cout << "Touching up the calibration from " << dataPoints.size() << " points collected " << previousTime << "." << endl;
+    }
+
     int exitCode = 0;
     try{
-        // Before using any pylon methods, the pylon runtime must be initialized.
-        PylonInitialize();
-
         //Main loop flag
         bool quit = false;
 
-        // Only look for GigE cameras
-        CDeviceInfo info;
-        info.SetDeviceClass( Camera_t::DeviceClass());
-
-        // Get the transport layer factory.
-        CTlFactory& tlFactory = CTlFactory::GetInstance();
-
-        // Get all attached devices and exit application if no device is found.
-        // There should be two camera's attached with user defined names L45 and L90.
-        DeviceInfoList_t devices;
-        if( tlFactory.EnumerateDevices(devices) == 0){
-            throw RUNTIME_EXCEPTION("No camera present.");
+        // There should be two camera's attached with the first two user defined names, L45 and L90 by default.
+        std::vector<std::unique_ptr<FrameSource>> cameras = openingCameras.get();
+        if(cameras.size() < 2){
+            throw std::runtime_error("Two cameras are needed.");
         }
 
-        // Create a camera array for two cameras.
-        Camera_t cameras[2];
-
-        // Setup the cameras for software triggering and set the grab strategy.
-        for(int i = 0; i < 2; i++){
-            camSetupSoftwareTrigger(cameras[i],devices[i], tlFactory);
+        // Measure each camera's frames at the size it sends them.
+        useCameraGeometry(cameras);
 
-            // Can both camera devices be queried whether it is ready to accept the next frame trigger?
-            if (cameras[i].CanWaitForFrameTriggerReady()) {
-
-                // Start the grabbing using the grab loop thread, by setting the grabLoopType parameter
-                // to GrabLoop_ProvidedByInstantCamera. The grab results are delivered to the image event handlers.
-                // The GrabStrategy_OneByOne default grab strategy is used.
-                cameras[i].StartGrabbing(GrabStrategy_OneByOne, GrabLoop_ProvidedByInstantCamera);
-            }
-            else{
-                // See the documentation of CInstantCamera::CanWaitForFrameTriggerReady() for more information.
-                cout << "\nThis sample can only be used with cameras that can be queried whether"
-                     << " they are ready to accept the next frame trigger.\n";
-                throw RUNTIME_EXCEPTION("CanWaitForFrameTriggerReady() failed.");
-            }
+        // Deliver frames to detectObject and start grabbing using the source's grab thread.
+        for(size_t i = 0; i < cameras.size(); i++){
+            cameras[i]->setFrameHandler(detectObject);
+            cameras[i]->startGrabbing();
+            samplesFor(pixels, cameras[i]->name());
         }
 
+        // Match the results from the two cameras by chunk timestamp.
+        StereoCorrelator correlator(stereoSettingsFromEnvironment());
+        calibrateClockOffsets(cameras, correlator);
+
         // Wait for user input to trigger the camera or exit the program.
         // The grabbing is stopped, the device is closed and destroyed automatically
         // when the camera object goes out of scope.
@@ -138,41 +150,80 @@ int main(int argc, char* argv[]){
             // Read a key.
             cin >> key;
             cout << "Entered: " << key << endl;
-            // Execute the software trigger on both cameras if the key is t.
+            // Execute the software trigger on every camera if the key is t.
             if ( (key == 't' || key == 'T')){
-                // The posible range for pixelCamera0 and pixelCamera1 is 0 - 1024.
-                // This is the pixels on the camera blocked by an object.
-                pixelCamera0 = 1025;
-                pixelCamera1 = 1025;
-
-                // Execute a software trigger sequentially on both cameras.
-                // A new thread for both cameras is created for grabbing and processing the image.
-                for(int i = 0; i < 2; i++) {
-                    if (cameras[i].WaitForFrameTriggerReady(500, TimeoutHandling_ThrowException)) {
+                // Results left by the last trigger from cameras after the first two, when its point wasn't used.
+                DetectionResult stale;
+                for(uint32_t i = 2; i < cameras.size(); i++){
+                    while(detectorContext().camera(i).results.tryPop(stale)){}
+                }
+
+                // Execute a software trigger sequentially on every camera.
+                // Each camera's frame is processed by detectObject on the camera's grab thread.
+                for(size_t i = 0; i < cameras.size(); i++) {
+                    if (cameras[i]->waitForFrameTriggerReady(500)) {
                         // Execute the software trigger. Wait up to 500 ms for the camera to be ready for trigger.
-                        cameraEventComplete[i] = 0;
-                        cameras[i].ExecuteSoftwareTrigger();
+                        cameras[i]->executeSoftwareTrigger();
                     }
                 }
 
-                //cout << "Waiting for event handlers to unlock.\n";
-                // Event handlers run in a seperate thread.
-                // Wait until the event handlers for both cameras process the frame.
-                std::unique_lock<std::mutex> lk0(m[0]);
-                std::unique_lock<std::mutex> lk1(m[1]);
-                cv[0].wait(lk0, []{return cameraEventComplete[0];});
-                cv[1].wait(lk1, []{return cameraEventComplete[1];});
-
-                // Check to see if an object was detected and store the point in the vector.
-                // pixelCamera0 and pixelCamera1 are set by the OnImageGrabbed event handler when a frame is grabbed.
-                cout << "pixelCamera0: " << pixelCamera0 << " pixelCamera1: " << pixelCamera1 << endl;
-                if(pixelCamera0 < 1025 && pixelCamera1 < 1025) {
-                    currentPoint.L45 = pixelCamera0;
-                    currentPoint.L90 = pixelCamera1;
+                // Wait until the frames from both cameras are matched, or reported as unmatched.
+                StereoEvent event;
+                if(!waitForStereoEvent(correlator, event, 1000)){
+                    throw std::runtime_error("Timed out waiting for a frame from both cameras.");
+                }
+                if(event.type != StereoEventType::Matched){
+                    // The other camera's frame is reported as unmatched next.
+                    cout << cameras[event.cameraNo]->name() << " frame has no matching frame. Trying another (x,y) point.\n";
+                    StereoEvent partner;
+                    waitForStereoEvent(correlator, partner, 1000);
+                    continue;
+                }
+                DetectionResult & result0 = event.result[0];
+                DetectionResult & result1 = event.result[1];
+
+                // Check to see if one object was detected by each camera and store the point in the vector.
+                cout << "L45 objects: " << result0.runCount << " L90 objects: " << result1.runCount << endl;
+                if(result0.runCount > 1 || result1.runCount > 1) {
+                    cout << "More than one object was detected. Clear the screen and try another (x,y) point.\n";
+                }
+                else if(result0.detected && result1.detected) {
+                    cout << "L45 pixel: " << result0.runs[0].centroid << " L90 pixel: " << result1.runs[0].centroid << endl;
+                    currentPoint.L45 = result0.runs[0].centroid;
+                    currentPoint.L90 = result1.runs[0].centroid;
                     cout << "Adding point to dataPoints vector.\n";
                     dataPoints.push_back(currentPoint);
+                    double pointX = currentPoint.x, pointY = currentPoint.y;
+                    samplesFor(pixels, cameras[0]->name()).samples.push_back({result0.runs[0].centroid, pointX, pointY});
+                    samplesFor(pixels, cameras[1]->name()).samples.push_back({result1.runs[0].centroid, pointX, pointY});
+
+                    // The other cameras' frames aren't matched by the correlator. Their pixels are only used for their lines.
+                    for(uint32_t i = 2; i < cameras.size(); i++){
+                        DetectionResult result;
+                        if(!waitForDetectionResult(detectorContext(), i, result, 1000) || result.runCount != 1){
+                            cout << cameras[i]->name() << " didn't see one object. The point isn't used for its line.\n";
+                            continue;
+                        }
+                        cout << cameras[i]->name() << " pixel: " << result.runs[0].centroid << endl;
+                        samplesFor(pixels, cameras[i]->name()).samples.push_back({result.runs[0].centroid, pointX, pointY});
+                    }
                     cout << "Number of points collected so far: " << dataPoints.size() << endl;
 
+                    // Show how far off the calibration was before this point, then fold the point in.
+                    if(calibration.ready()){
+                        std::tuple<uint32_t,uint32_t> estimate = estimator.estimatePosition(currentPoint.L45, currentPoint.L90);
+                        cout << "The calibration estimated (" << std::get<0>(estimate) << ',' << std::get<1>(estimate) << ")." << endl;
+                    }
+                    calibration.addPoint(currentPoint);
+
+                    // The next point is checked against the updated coefficients. They're written with the points at the end.
+                    CalibrationFit fit;
+                    if(calibration.currentFit(fit)){
+                        calibration.publish(estimator);
+                        cout << "Coefficients updated. RMS error x: " << fit.rmsErrorX << " y: " << fit.rmsErrorY
+                             << " pixels." << endl;
+                    }
+
                     // Increment the calibration point index,
                     n++;
                 }
@@ -187,14 +238,33 @@ int main(int argc, char* argv[]){
         // Write the points to an SQLite file.
         cout << "Number of points collected: " << dataPoints.size() << endl;
         if(dataPoints.size() > 0){
-            cout << "Writing the dataPoints vector to an SQLite file.";
-            writeDataPointsToDB(dataPoints, DB_FILENAME);
+            // The points and the coefficients fitted to them are committed together.
+            cout << "Writing the dataPoints vector to an SQLite file." << endl;
+            CalibrationFit fit;
+            bool fitted = calibration.currentFit(fit);
+            std::string trainingTime = writeTrainingToDB(dataPoints, pixels, fitted ? &fit : nullptr, DB_FILENAME);
+            if(fitted){
+                cout << "Coefficients written with timeCreated " << trainingTime << ". RMS error x: "
+                     << fit.rmsErrorX << " y: " << fit.rmsErrorY << " pixels." << endl;
+            }
+            else{
+                cout << "At least " << NUM_COEFFICIENTS << " points across the screen are needed to calculate the coefficients." << endl;
+            }
+
+            // Each camera's line for LSAD_POSITION_MODEL=lines, fitted to every point at once.
+            std::vector<std::string> errors;
+            std::vector<SensorLine> lines = fitSensorLines(pixels, errors);
+            for(const std::string & error : errors) cout << error << endl;
+            if(errors.size() < lines.size()){
+                std::string linesTime = writeSensorLinesToDB(cameraSampleNames(pixels), lines, DB_FILENAME);
+                cout << "Sensor lines written with timeCreated " << linesTime << "." << endl;
+            }
         }
     }
-    catch (const GenericException &e){
+    catch (const std::exception &e){
         // Error handling.
         cerr << "An exception occurred." << endl
-             << e.GetDescription() << endl;
+             << e.what() << endl;
         exitCode = 1;
 
         // Remove left over characters from input buffer.
@@ -207,7 +277,7 @@ int main(int argc, char* argv[]){
     cin >> dummyVariable;
 
     // Free all resources used.
-    PylonTerminate();
+    frameSourcesTerminate();
     sdlCleanup();
     hostCleanup();
     deviceCleanup();
@@ -25,8 +25,14 @@
 #include <vector>
 #include <tuple>
 
+// getenv and strcmp for the environment settings.
+#include <cstdlib>
+#include <cstring>
+
 // Include files for the HIP runtime
+#ifdef LSAD_USE_HIP
 #include "hip/hip_runtime.h"
+#endif
 
 // Used for checking HIP errors.
 #include "errorCheckingMacros.h"
@@ -34,21 +40,31 @@
 // SDL2 functions.
 #include "SDLfunctions.h"
 
-// SQLite commands
+// SQLite commands and the DataPoint struct.
 #include "SQLitefunctions.h"
 
+// Fits the calibration coefficients to the points as they're collected.
+#include "calibrationFitting.h"
+#include "OnlineCalibration.h"
+
 // Include file for the BaselineData struct
 #include "BaselineData.h"
 
 // Header files and settings for the cameras.
 #include "camerasettings.h"
 
-// Header file for setting up cameras.
-#include "cameraSetup.h"
+// Header file for cameras and other frame sources.
+#include "FrameSource.h"
 
 // Header file for camera event functions.
 #include "cameraEvent.h"
 
+// Pairs the detection results from both cameras by timestamp.
+#include "StereoCorrelator.h"
+
+// Stage timestamps when built with LSAD_TRACING.
+#include "LatencyTrace.h"
+
 // Global variables
 #include "globals.h"
 
@@ -61,13 +77,7 @@
 // Initializing and freeing memory functions.
 #include "setupCleanupFunctions.h"
 
-// Used for storing calibration datapoints.
-struct DataPoint
-{
-    uint32_t x;
-    uint32_t y;
-    float L45;
-    float L90;
-};
+// Loads the newest baselines and coefficients without asking.
+#include "StartupSnapshot.h"
 
 #endif //UNTITLED_MAIN_TRAINING_H
@@ -18,65 +18,173 @@
 // You should have received a copy of the GNU General Public License
 // along with Line Camera Arrow Detection.  If not, see <https://www.gnu.org/licenses/>.
 
-#include "main_training.h"
+#include "setupCleanupFunctions.h"
+#include "BaselineData.h"
+#include "FrameSource.h"
+#include "StartupSnapshot.h"
+#include "cameraEvent.h"
+#include "errorCheckingMacros.h"
+#include "filenames.h"
+#include <iostream>
+#include <stdexcept>
 
 using std::endl, std::cerr, std::cout;
-void hostSetup(){
-    // Initialize the baseline struct for both cameras on the host.
-    initBaselineData_h(Baseline_h[0], CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
-    initBaselineData_h(Baseline_h[1], CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
-
-    // This is the array for counting the number of times each pixel was above the threshold in the grab result.
-    aboveThresholdCount_h[0] = (uint32_t*)malloc(PIXELS_PER_LINE*sizeof(uint32_t));
-    if(aboveThresholdCount_h[0] == NULL) {
-        cerr << "Could not allocate memory for aboveThresholdCount[0]." << endl;
-        abort();
-    }
-    aboveThresholdCount_h[1] = (uint32_t*)malloc(PIXELS_PER_LINE*sizeof(uint32_t));
-    if(aboveThresholdCount_h[1] == NULL) {
-        cerr << "Could not allocate memory for aboveThresholdCount[1]." << endl;
-        std::abort();
+void hostSetup(size_t maxCameras){
+    // Choose how frames are compared to the threshold.
+    selectDetectionBackend();
+
+    // Keep the detection state for the cameras this program uses.
+    DetectorContext & context = detectorContext();
+    context.configure(maxCameras);
+    hostSetup(context);
+}
+
+void hostSetup(DetectorContext & context){
+    // LSAD_ADAPTIVE_BASELINE_FRAMES follows slow changes in the light from the frames being measured.
+    useAdaptiveBaseline(context, adaptiveBaselineFramesFromEnvironment());
+
+    // Initialize the baseline struct for each camera on the host.
+    for(uint32_t i = 0; i < context.cameraCount(); i++){
+        initBaselineData_h(context.camera(i).baseline_h, CAMERA_GAIN, CAMERA_EXPOSURE_TIME);
     }
 }
 
 void hostCleanup(){
-    // Deallocate the baseline struct and aboveThresholdCount for both cameras on the host.
-    free(Baseline_h[0]);
-    free(Baseline_h[1]);
-    free(aboveThresholdCount_h[0]);
-    free(aboveThresholdCount_h[1]);
+    hostCleanup(detectorContext());
+}
+
+void hostCleanup(DetectorContext & context){
+    for(uint32_t i = 0; i < context.cameraCount(); i++){
+        // Release the threshold detection used and deallocate the baseline struct.
+        CameraContext & camera = context.camera(i);
+        publishDetectionThreshold(camera, nullptr);
+        delete camera.baseline_h;
+        camera.baseline_h = nullptr;
+    }
 }
 
 void loadBaseline(){
-    // Load the baseline into memory from the SQLite file.
-    readBaselineFromDB(Baseline_h[0], DB_FILENAME, "L45");
-    readBaselineFromDB(Baseline_h[1], DB_FILENAME, "L90");
+    loadBaseline(detectorContext());
 }
 
-void deviceSetup(){
-    // Initialize the baseline struct for both cameras on the GPU.
-    initBaselineData_d(Baseline_d[0]);
-    initBaselineData_d(Baseline_d[1]);
+void loadBaseline(DetectorContext & context){
+    // Load the baseline into memory from the SQLite file and measure frames against its threshold.
+    for(uint32_t i = 0; i < context.cameraCount(); i++){
+        CameraContext & camera = context.camera(i);
+        std::string timeCreated = readBaselineFromDB(camera.baseline_h, DB_FILENAME, camera.name.c_str());
+        publishDetectionThreshold(camera, makeDetectionThreshold(camera.baseline_h, timeCreated));
+    }
+}
 
-    // This is an array for counting the number of times each pixel was above the threshold in the grab result.
-    HIP_CHECK(hipMalloc(&aboveThresholdCount_d[0], PIXELS_PER_LINE*sizeof(uint32_t)));
-    HIP_CHECK(hipMalloc(&aboveThresholdCount_d[1], PIXELS_PER_LINE*sizeof(uint32_t)));
+// Load the newest baseline for camera and measure frames against its threshold.
+static void loadLatestBaseline(CameraContext & camera){
+    std::string timeCreated = latestBaselineTime(DB_FILENAME, camera.name.c_str());
+    if(timeCreated.empty()) throw std::runtime_error(camera.name + " doesn't have a baseline.");
+    readBaselineFromDB(camera.baseline_h, DB_FILENAME, camera.name.c_str(), timeCreated);
+    publishDetectionThreshold(camera, makeDetectionThreshold(camera.baseline_h, timeCreated));
+}
+
+void loadLatestBaseline(DetectorContext & context){
+    for(uint32_t i = 0; i < context.cameraCount(); i++) loadLatestBaseline(context.camera(i));
+}
+
+void loadLatestCalibration(ScreenPositionEstimator * estimator){
+    // The snapshot holds the two cameras training and testing pair.
+    DetectorContext & context = detectorContext();
+    if(context.cameraCount() < 2){
+        cerr << "Two cameras must be named in " << CAMERA_NAMES_ENV << ". Aborting." << endl;
+        std::abort();
+    }
+    std::string cameraNames[2] = {context.camera(0).name, context.camera(1).name};
+    BaselineData * baselines[2] = {context.camera(0).baseline_h, context.camera(1).baseline_h};
+
+    // Load from the startup snapshot when it's still the newest, or the SQLite file otherwise.
+    std::string timeCreated[2];
+    loadStartupCalibration(DB_FILENAME, cameraNames, baselines, timeCreated, estimator);
+    publishDetectionThreshold(0, makeDetectionThreshold(baselines[0], timeCreated[0]));
+    publishDetectionThreshold(1, makeDetectionThreshold(baselines[1], timeCreated[1]));
+
+    // Any other cameras, which training records for their sensor lines, aren't in the snapshot.
+    for(uint32_t i = 2; i < context.cameraCount(); i++) loadLatestBaseline(context.camera(i));
+}
 
-    // Copy the struct loaded from the SQLite file in host memory.
-    copyBaselineData_HostToDevice(Baseline_d[0],Baseline_h[0]);
-    copyBaselineData_HostToDevice(Baseline_d[1],Baseline_h[1]);
+#ifdef LSAD_USE_HIP
+// Allocate GPU memory for camera's frames.
+static void allocateDeviceBuffers(CameraContext & camera){
+    // This is an array for counting the number of times each pixel was above the threshold in the grab result.
+    HIP_CHECK(hipMalloc(&camera.aboveThresholdCount_d, camera.geometry.pixelsPerLine*sizeof(uint32_t)));
 
     // Initialize memory for the grab result.
-    HIP_CHECK(hipMalloc(&grabResult_d[0], PIXELS_PER_LINE*IMAGE_HEIGHT*sizeof(uint8_t)));
-    HIP_CHECK(hipMalloc(&grabResult_d[1], PIXELS_PER_LINE*IMAGE_HEIGHT*sizeof(uint8_t)));
+    HIP_CHECK(hipMalloc(&camera.grabResult_d, camera.geometry.frameBytes()));
+}
+
+static void freeDeviceBuffers(CameraContext & camera){
+    HIP_CHECK(hipFree(camera.aboveThresholdCount_d));
+    HIP_CHECK(hipFree(camera.grabResult_d));
+    camera.aboveThresholdCount_d = nullptr;
+    camera.grabResult_d = nullptr;
+}
+#endif
+
+void deviceSetup(){
+    deviceSetup(detectorContext());
+}
+
+void deviceSetup([[maybe_unused]] DetectorContext & context){
+#ifdef LSAD_USE_HIP
+    // Device memory is only used by the GPU detection backend.
+    if(currentDetectionBackend() != DetectionBackend::GPU) return;
+
+    for(uint32_t i = 0; i < context.cameraCount(); i++) allocateDeviceBuffers(context.camera(i));
+#endif
 }
 
 void deviceCleanup(){
+    deviceCleanup(detectorContext());
+}
+
+void deviceCleanup([[maybe_unused]] DetectorContext & context){
+#ifdef LSAD_USE_HIP
+    if(currentDetectionBackend() != DetectionBackend::GPU) return;
+
     // Deallocate all memory used on the GPU.
-    HIP_CHECK(hipFree(Baseline_d[0]));
-    HIP_CHECK(hipFree(Baseline_d[1]));
-    HIP_CHECK(hipFree(aboveThresholdCount_d[0]));
-    HIP_CHECK(hipFree(aboveThresholdCount_d[1]));
-    HIP_CHECK(hipFree(grabResult_d[0]));
-    HIP_CHECK(hipFree(grabResult_d[1]));
-}
\ No newline at end of file
+    for(uint32_t i = 0; i < context.cameraCount(); i++) freeDeviceBuffers(context.camera(i));
+#endif
+}
+
+void useCameraGeometry(const std::vector<std::unique_ptr<FrameSource>> & cameras){
+    useCameraGeometry(detectorContext(), cameras);
+}
+
+void useCameraGeometry(DetectorContext & context, const std::vector<std::unique_ptr<FrameSource>> & cameras){
+    for(const std::unique_ptr<FrameSource> & source : cameras){
+        // Frames from cameras that aren't named are rejected when they arrive.
+        CameraContext * found = context.findCamera(source->name());
+        if(found == nullptr) continue;
+        CameraContext & camera = *found;
+        SensorGeometry geometry = source->geometry();
+        checkSensorGeometry(source->name(), geometry);
+
+        // The baseline has to have a threshold for every column. It can be wider, like the baselines collected
+        // before cameras could be cropped, which were always PIXELS_PER_LINE wide.
+        std::shared_ptr<const DetectionThreshold> threshold = currentDetectionThreshold(camera);
+        if(threshold && threshold->baseline.pixelsPerLine() < geometry.pixelsPerLine){
+            throw std::runtime_error(std::string(source->name()) + " sends lines of "
+                                     + std::to_string(geometry.pixelsPerLine) + " pixels, but its baseline only has "
+                                     + std::to_string(threshold->baseline.pixelsPerLine())
+                                     + ". Collect a new baseline with the baseline program.");
+        }
+        if(geometry == camera.geometry) continue;
+
+        cout << source->name() << ": Frames are " << geometry.pixelsPerLine << " x " << geometry.imageHeight
+             << " pixels." << endl;
+        camera.setGeometry(geometry);
+#ifdef LSAD_USE_HIP
+        // The buffers on the GPU were allocated for the default size.
+        if(currentDetectionBackend() == DetectionBackend::GPU){
+            freeDeviceBuffers(camera);
+            allocateDeviceBuffers(camera);
+        }
+#endif
+    }
+}
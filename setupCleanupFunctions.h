@@ -22,20 +22,49 @@
 #ifndef UNTITLED_SETUPCLEANUPFUNCTIONS_H
 #define UNTITLED_SETUPCLEANUPFUNCTIONS_H
 
-// Allocate host memory.
-void hostSetup();
+#include <cstddef>
+#include <memory>
+#include <vector>
 
-// Initialize host memory.
+class DetectorContext;
+class FrameSource;
+class ScreenPositionEstimator;
+
+// Choose the detection backend and allocate host memory for the first maxCameras cameras in LSAD_CAMERA_NAMES.
+void hostSetup(size_t maxCameras);
+
+// Allocate host memory for the cameras in context. The detection backend must already be chosen.
+void hostSetup(DetectorContext & context);
+
+// Initialize host memory and publish the threshold frames are measured against.
+// The threshold is copied to the GPU when the GPU detection backend is used.
 void loadBaseline();
+void loadBaseline(DetectorContext & context);
 
-// Allocate and initialize GPU memory.
+// Load the newest baseline for each camera in context without asking. Throws if a camera doesn't have one.
+void loadLatestBaseline(DetectorContext & context);
+
+// Load the newest baselines, and the newest coefficients into estimator when it isn't null, without asking.
+// Used instead of loadBaseline when LSAD_STARTUP=latest.
+void loadLatestCalibration(ScreenPositionEstimator * estimator);
+
+// Allocate and initialize GPU memory when the GPU detection backend is used.
 void deviceSetup();
+void deviceSetup(DetectorContext & context);
+
+// Measure frames from each of cameras at the size it sends them. Must be called after deviceSetup and before
+// grabbing starts. Throws if a camera sends frames that can't be measured.
+// Cameras are matched by name, so sources for cameras that aren't in the context are skipped.
+void useCameraGeometry(const std::vector<std::unique_ptr<FrameSource>> & cameras);
+void useCameraGeometry(DetectorContext & context, const std::vector<std::unique_ptr<FrameSource>> & cameras);
 
 // Deallocate host memory.
 void hostCleanup();
+void hostCleanup(DetectorContext & context);
 
 // Deallocate device memory.
 void deviceCleanup();
+void deviceCleanup(DetectorContext & context);
 
 
 #endif //UNTITLED_SETUPCLEANUPFUNCTIONS_H